@@ -0,0 +1,604 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "benchmark.h"
+#include "blockdata.h"
+#include "builder.h"
+#include "completionengine.h"
+#include "configmanager.h"
+#include "file.h"
+#include "filestructure.h"
+#include "pdfsynchronizer.h"
+#include "spellchecker.h"
+#include "synctexindex.h"
+#include "syntaxhighlighter.h"
+#include "widgetfile.h"
+#include "widgetpdfdocument.h"
+#include "widgettextedit.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QRegExp>
+#include <QTextBlock>
+#include <QTextCursor>
+
+#define BENCHMARK_RUNS 5
+
+static QString readFile(const QString & filename)
+{
+    QFile file(filename);
+    if(!file.open(QFile::ReadOnly))
+    {
+        qDebug()<<"[benchmark] cannot open"<<filename;
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+bool Benchmark::run(const QStringList &arguments)
+{
+    int idx = arguments.indexOf("--benchmark");
+    if(idx == -1 || idx + 1 >= arguments.count())
+    {
+        return false;
+    }
+    QString name = arguments.at(idx + 1);
+    QStringList files = arguments.mid(idx + 2);
+
+    if(name == "highlighter")
+    {
+        highlighter(files);
+    }
+    else if(name == "blockdata")
+    {
+        blockData(files);
+    }
+    else if(name == "completion")
+    {
+        completion();
+    }
+    else if(name == "filestructure")
+    {
+        fileStructure(files);
+    }
+    else if(name == "symbols")
+    {
+        symbols(files);
+    }
+    else if(name == "buildoutput")
+    {
+        buildOutput(files);
+    }
+    else if(name == "synctex")
+    {
+        synctex(files);
+    }
+    else if(name == "pdfscroll")
+    {
+        pdfScroll(files);
+    }
+    else if(name == "spellchecker")
+    {
+        spellChecker(files);
+    }
+    else if(name == "themeformats")
+    {
+        themeFormats(files);
+    }
+    else
+    {
+        qDebug()<<"[benchmark] unknown benchmark"<<name;
+    }
+    return true;
+}
+
+void Benchmark::highlighter(const QStringList &files)
+{
+    WidgetFile widgetFile;
+    // measure the lexer only, the spell checker has its own benchmark
+    widgetFile.setDictionary(ConfigManager::NoDictionnary);
+
+    foreach(const QString & filename, files)
+    {
+        QString text = readFile(filename);
+        if(text.isEmpty())
+        {
+            continue;
+        }
+        widgetFile.widgetTextEdit()->setText(text);
+
+        QElapsedTimer timer;
+        timer.start();
+        for(int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            widgetFile.syntaxHighlighter()->rehighlight();
+        }
+        qint64 elapsed = qMax(qint64(1), timer.elapsed());
+        double charsPerSecond = 1000.0 * BENCHMARK_RUNS * text.length() / elapsed;
+        qDebug()<<"[benchmark] highlighter"<<filename<<":"<<text.length()<<"chars,"
+                <<(elapsed / BENCHMARK_RUNS)<<"ms per pass,"<<qRound64(charsPerSecond)<<"chars/s";
+    }
+}
+
+void Benchmark::blockData(const QStringList &files)
+{
+    // per allocation bookkeeping of the allocator
+    const int mallocOverhead = 16;
+    const int vectorHeader = 16 + mallocOverhead;
+
+    WidgetFile widgetFile;
+    widgetFile.setDictionary(ConfigManager::NoDictionnary);
+
+    foreach(const QString & filename, files)
+    {
+        QString text = readFile(filename);
+        if(text.isEmpty())
+        {
+            continue;
+        }
+        widgetFile.widgetTextEdit()->setText(text);
+
+        qint64 packedSize = 0;
+        qint64 formerSize = 0;
+        for(QTextBlock block = widgetFile.widgetTextEdit()->document()->begin(); block.isValid(); block = block.next())
+        {
+            BlockData * data = BlockData::data(block);
+            if(!data)
+            {
+                continue;
+            }
+            packedSize += data->memoryUsage() + mallocOverhead;
+
+            formerSize += sizeof(BlockData) + mallocOverhead;
+            formerSize += vectorHeader + data->length() * sizeof(CharacterData);
+            formerSize += vectorHeader + data->parentheses().count() * (sizeof(ParenthesisInfo *) + sizeof(ParenthesisInfo) + mallocOverhead);
+            formerSize += vectorHeader + data->latexblocks().count() * (sizeof(LatexBlockInfo *) + sizeof(LatexBlockInfo) + mallocOverhead);
+            // two BlockState, each one with two detached stacks
+            formerSize += 2 * (sizeof(BlockState) + 2 * vectorHeader
+                               + (data->blockEndingState->parenthesisLevel.count() + data->blockEndingState->crocherLevel.count()) * sizeof(int));
+        }
+        qDebug()<<"[benchmark] blockdata"<<filename<<":"<<text.length()<<"chars,"
+                <<widgetFile.widgetTextEdit()->document()->blockCount()<<"blocks,"
+                <<"former layout"<<(formerSize / 1024)<<"KB,"
+                <<"packed layout"<<(packedSize / 1024)<<"KB,"
+                <<BlockState::internedCount()<<"interned states";
+    }
+    // the interned states are freed with the blocks, only the initial one should remain
+    widgetFile.widgetTextEdit()->setText("");
+    qDebug()<<"[benchmark] blockdata : empty document,"<<BlockState::internedCount()<<"interned states";
+}
+
+void Benchmark::spellChecker(const QStringList &files)
+{
+    QString dictionary = ConfigManager::Instance.currentDictionary();
+    if(dictionary == ConfigManager::NoDictionnary)
+    {
+        qDebug()<<"[benchmark] spellchecker : no dictionary selected";
+        return;
+    }
+
+    foreach(const QString & filename, files)
+    {
+        QStringList words = readFile(filename).split(QRegExp("[^\\w]+"), QString::SkipEmptyParts);
+        if(words.isEmpty())
+        {
+            continue;
+        }
+        // a new instance so that the cache is empty
+        SpellChecker spellChecker(dictionary);
+
+        QElapsedTimer timer;
+        timer.start();
+        foreach(const QString & word, words)
+        {
+            spellChecker.spell(word);
+        }
+        qint64 coldElapsed = qMax(qint64(1), timer.elapsed());
+        int coldMisses = spellChecker.cacheMisses();
+
+        timer.restart();
+        for(int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            foreach(const QString & word, words)
+            {
+                spellChecker.spell(word);
+            }
+        }
+        qint64 warmElapsed = qMax(qint64(1), timer.elapsed());
+
+        qDebug()<<"[benchmark] spellchecker"<<filename<<":"<<words.count()<<"words,"
+                <<coldMisses<<"distinct,"
+                <<"cold"<<qRound64(1000.0 * words.count() / coldElapsed)<<"words/s,"
+                <<"warm"<<qRound64(1000.0 * BENCHMARK_RUNS * words.count() / warmElapsed)<<"words/s";
+    }
+}
+
+void Benchmark::fileStructure(const QStringList &files)
+{
+    const int keystrokes = 200;
+    WidgetFile widgetFile;
+    widgetFile.setDictionary(ConfigManager::NoDictionnary);
+    WidgetTextEdit * textEdit = widgetFile.widgetTextEdit();
+
+    foreach(const QString & filename, files)
+    {
+        QString text = readFile(filename);
+        if(text.isEmpty())
+        {
+            continue;
+        }
+        textEdit->setText(text);
+        FileStructure structure(textEdit);
+
+        QElapsedTimer timer;
+        timer.start();
+        for(int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            structure.updateStructure();
+        }
+        double fullPass = timer.nsecsElapsed() / 1000000.0 / BENCHMARK_RUNS;
+
+        // type new lines in the middle of the document, the highlighter is not part of the measure
+        QTextCursor cursor(textEdit->document()->findBlockByNumber(textEdit->document()->blockCount() / 2));
+        qint64 elapsed = 0;
+        for(int i = 0; i < keystrokes; ++i)
+        {
+            int position = cursor.position();
+            cursor.insertText("\n");
+            timer.restart();
+            structure.onContentsChange(position, 0, 1);
+            structure.indentation(textEdit->document()->blockCount() / 2);
+            elapsed += timer.nsecsElapsed();
+        }
+        qDebug()<<"[benchmark] filestructure"<<filename<<":"<<textEdit->document()->blockCount()<<"blocks,"
+                <<structure.info()->count()<<"sections,"
+                <<"full pass"<<fullPass<<"ms,"
+                <<"per keystroke"<<(elapsed / 1000.0 / keystrokes)<<"us";
+    }
+}
+
+void Benchmark::completion()
+{
+    const int lookups = 1000;
+    QElapsedTimer timer;
+    timer.start();
+    const CompletionIndex & index = CompletionEngine::wordIndex();
+    qDebug()<<"[benchmark] completion :"<<index.count()<<"words indexed in"<<timer.elapsed()<<"ms";
+    if(!index.count())
+    {
+        return;
+    }
+
+    for(int length = 1; length <= 5; ++length)
+    {
+        // prefixes of words spread over the whole list
+        QStringList prefixes;
+        for(int i = 0; i < lookups; ++i)
+        {
+            prefixes.append(index.words().at(qint64(i) * index.count() / lookups).left(length));
+        }
+        qint64 matches = 0;
+        timer.restart();
+        foreach(const QString & prefix, prefixes)
+        {
+            matches += index.find(prefix).count();
+        }
+        double prefixLatency = timer.nsecsElapsed() / 1000.0 / lookups;
+        timer.restart();
+        foreach(const QString & prefix, prefixes)
+        {
+            index.findFuzzy(prefix);
+        }
+        double fuzzyLatency = timer.nsecsElapsed() / 1000.0 / lookups;
+        qDebug()<<"[benchmark] completion prefix length"<<length<<":"
+                <<(matches / lookups)<<"matches on average,"
+                <<"prefix"<<prefixLatency<<"us,"
+                <<"fuzzy"<<fuzzyLatency<<"us";
+    }
+}
+
+void Benchmark::symbols(const QStringList &files)
+{
+    const int edits = 200;
+    WidgetFile widgetFile;
+    widgetFile.setDictionary(ConfigManager::NoDictionnary);
+    WidgetTextEdit * textEdit = widgetFile.widgetTextEdit();
+
+    // the harvested symbols must be the words inserted by the completion
+    textEdit->setText("\\label{foo}\n\\bibitem{key}\n\\newcommand{\\bar}{bar}\n\\renewcommand{\\baz}{baz}");
+    textEdit->completionEngine()->addCustomWordFromSource();
+    QStringList expected;
+    expected << "\\ref{foo}" << "\\cite{key}" << "\\bar" << "\\baz";
+    foreach(const QString & word, expected)
+    {
+        if(!textEdit->completionEngine()->customWords().contains(word))
+        {
+            qDebug()<<"[benchmark] symbols : missing"<<word<<"in"<<textEdit->completionEngine()->customWords();
+        }
+    }
+
+    foreach(const QString & filename, files)
+    {
+        QString text = readFile(filename);
+        if(text.isEmpty())
+        {
+            continue;
+        }
+        textEdit->setText(text);
+
+        // cost of the former approach: three regular expressions over the whole document,
+        // the bibtex file parsed again, then the sort of the words
+        QElapsedTimer timer;
+        timer.start();
+        QStringList words;
+        QString source = textEdit->toPlainText();
+        QStringList patterns;
+        QStringList prefixes;
+        patterns << "\\\\(re){0,1}newcommand\\{([^\\}]*)\\}" << "\\\\label\\{([^\\}]*)\\}" << "\\\\bibitem\\{([^\\}]*)\\}";
+        prefixes << "" << "\\ref{" << "\\cite{";
+        for(int pattern = 0; pattern < patterns.count(); ++pattern)
+        {
+            QRegExp regExp(patterns.at(pattern));
+            int index = source.indexOf(regExp);
+            while(index != -1)
+            {
+                words.append(prefixes.at(pattern).isEmpty() ? regExp.capturedTexts().last() : prefixes.at(pattern)+regExp.capturedTexts().last()+"}");
+                index = source.indexOf(regExp, index + 1);
+            }
+        }
+        QStringList bibtexFiles = textEdit->getCurrentFile()->bibtexFiles();
+        if(!bibtexFiles.isEmpty())
+        {
+            QFile bibFile(bibtexFiles.first());
+            if(bibFile.open(QFile::Text | QFile::ReadOnly))
+            {
+                foreach(const BibItem & bibItem, CompletionEngine::parseBibtexSource(bibFile.readAll()))
+                {
+                    words.append("\\cite{"+bibItem.key+"}?<strong>"+bibItem.title+"</strong><div style=\"color:\\#444444;font-style: italic\">"+bibItem.author+"</div>");
+                }
+            }
+        }
+        words.removeDuplicates();
+        words.sort();
+        double fullScan = timer.nsecsElapsed() / 1000000.0;
+
+        // type in the middle of the document and refresh the completion words after each edit,
+        // the edit is timed too since the symbols of the block are collected while it is highlighted
+        QTextCursor cursor(textEdit->document()->findBlockByNumber(textEdit->document()->blockCount() / 2));
+        qint64 refresh = 0;
+        for(int i = 0; i < edits; ++i)
+        {
+            timer.restart();
+            cursor.insertText(i % 2 ? "\\label{benchmark}" : "a");
+            textEdit->completionEngine()->addCustomWordFromSource();
+            refresh += timer.nsecsElapsed();
+        }
+        qDebug()<<"[benchmark] symbols"<<filename<<":"<<text.length()<<"chars,"
+                <<textEdit->completionEngine()->customWords().count()<<"custom words,"
+                <<"former refresh"<<fullScan<<"ms,"
+                <<"edit and refresh"<<(refresh / 1000.0 / edits)<<"us";
+    }
+}
+
+void Benchmark::buildOutput(const QStringList &files)
+{
+    const int chunkSize = 4096;
+    foreach(const QString & filename, files)
+    {
+        QFile file(filename);
+        if(!file.open(QFile::ReadOnly))
+        {
+            qDebug()<<"[benchmark] cannot open"<<filename;
+            continue;
+        }
+        QByteArray log = file.readAll();
+
+        // the log is given to the builder in chunks, as if it was read from pdflatex
+        QElapsedTimer timer;
+        timer.start();
+        for(int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            Builder builder(0);
+            for(int position = 0; position < log.size(); position += chunkSize)
+            {
+                builder.appendProcessOutput(QProcess::StandardOutput, log.mid(position, chunkSize));
+            }
+        }
+        qint64 elapsed = qMax(qint64(1), timer.elapsed());
+        qDebug()<<"[benchmark] buildoutput"<<filename<<":"<<(log.size() / 1024)<<"KB,"
+                <<(elapsed / BENCHMARK_RUNS)<<"ms per log,"
+                <<(1000.0 * BENCHMARK_RUNS * log.size() / elapsed / (1024 * 1024))<<"MB/s";
+    }
+}
+
+void Benchmark::pdfScroll(const QStringList &files)
+{
+    foreach(const QString & filename, files)
+    {
+        WidgetPdfDocument widget;
+        widget.resize(900, 1100);
+        if(!widget.loadDocument(filename))
+        {
+            qDebug()<<"[benchmark] cannot load"<<filename;
+            continue;
+        }
+        widget.updateScrollBar();
+        QImage frame(widget.size(), QImage::Format_ARGB32_Premultiplied);
+
+        int frames = 0;
+        qint64 paintTime = 0;
+        qint64 maxPaintTime = 0;
+        qint64 firstPixelTime = 0;
+        qint64 maxFirstPixelTime = 0;
+        QElapsedTimer timer;
+        for(int offset = 0; offset < widget.documentHeight(); offset += widget.height() / 3)
+        {
+            widget.onScroll(offset);
+
+            timer.start();
+            widget.render(&frame);
+            qint64 elapsed = timer.nsecsElapsed();
+            paintTime += elapsed;
+            maxPaintTime = qMax(maxPaintTime, elapsed);
+
+            // wait for the renderer, the pages received are painted as a real widget would be
+            while(!widget.isViewportRendered() && timer.elapsed() < 10000)
+            {
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+            }
+            widget.render(&frame);
+            elapsed = timer.nsecsElapsed();
+            firstPixelTime += elapsed;
+            maxFirstPixelTime = qMax(maxFirstPixelTime, elapsed);
+            ++frames;
+        }
+        frames = qMax(1, frames);
+        qDebug()<<"[benchmark] pdfscroll"<<filename<<":"<<frames<<"frames,"
+                <<"paint"<<(paintTime / 1000.0 / frames)<<"us (max"<<(maxPaintTime / 1000.0)<<"us),"
+                <<"time to first pixel"<<(firstPixelTime / 1000000.0 / frames)<<"ms (max"<<(maxFirstPixelTime / 1000000.0)<<"ms),"
+                <<"cache"<<widget.pageCache().status();
+    }
+}
+
+void Benchmark::synctex(const QStringList &files)
+{
+    foreach(const QString & filename, files)
+    {
+        Poppler::Document * document = Poppler::Document::load(filename);
+        synctex_scanner_t scanner = synctex_scanner_new_with_output_file(filename.toUtf8().data(), NULL, 1);
+        if(!document || scanner == NULL)
+        {
+            qDebug()<<"[benchmark] cannot load"<<filename<<"and its synctex file";
+            delete document;
+            if(scanner != NULL)
+            {
+                synctex_scanner_free(scanner);
+            }
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        SynctexIndex index;
+        index.build(scanner, document->numPages());
+        qint64 buildTime = timer.elapsed();
+
+        // as if the cursor went through each line of each input
+        QList<QPair<QString, int> > queries;
+        for(synctex_node_t input = synctex_scanner_input(scanner); input != NULL; input = synctex_node_sibling(input))
+        {
+            QString source = QDir::cleanPath(QString::fromUtf8(synctex_scanner_get_name(scanner, synctex_node_tag(input))));
+            int lineCount = readFile(source).count('\n') + 1;
+            for(int line = 1; line <= lineCount; ++line)
+            {
+                queries << qMakePair(source, line);
+            }
+        }
+        if(queries.isEmpty())
+        {
+            qDebug()<<"[benchmark] no input in the synctex file of"<<filename;
+        }
+        else
+        {
+            int page;
+            QRectF rect;
+            QList<int> scannerPages;
+            timer.start();
+            for(int idx = 0; idx < queries.count(); ++idx)
+            {
+                scannerPages << (PdfSynchronizer::query(scanner, queries.at(idx).first, queries.at(idx).second, &page, &rect) ? page : -1);
+            }
+            qint64 scannerTime = qMax(qint64(1), timer.elapsed());
+
+            SynctexIndex::Box box;
+            int differences = 0;
+            timer.start();
+            for(int idx = 0; idx < queries.count(); ++idx)
+            {
+                page = index.find(queries.at(idx).first, queries.at(idx).second, &box) ? box.page : -1;
+                differences += page != scannerPages.at(idx);
+            }
+            qint64 indexTime = qMax(qint64(1), timer.elapsed());
+
+            qDebug()<<"[benchmark] synctex"<<filename<<":"<<queries.count()<<"queries,"
+                    <<"scanner"<<(1000 * queries.count() / scannerTime)<<"queries/s,"
+                    <<"index"<<(1000 * queries.count() / indexTime)<<"queries/s (built in"<<buildTime<<"ms),"
+                    <<differences<<"different pages";
+        }
+        synctex_scanner_free(scanner);
+        delete document;
+    }
+}
+
+void Benchmark::themeFormats(const QStringList &files)
+{
+    const int lookups = 1000000;
+    QStringList keys;
+    keys << "normal" << "command" << "command-in-math-mode" << "option" << "comment" << "math" << "other";
+    QList<int> ids;
+    foreach(const QString & key, keys)
+    {
+        ids << ConfigManager::Instance.formatId(key);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int checksum = 0;
+    for(int i = 0; i < lookups; ++i)
+    {
+        checksum += ConfigManager::Instance.getTextCharFormats(keys.at(i % keys.count())).foreground().color().red();
+    }
+    qint64 byKey = qMax(qint64(1), timer.elapsed());
+
+    timer.restart();
+    for(int i = 0; i < lookups; ++i)
+    {
+        checksum += ConfigManager::Instance.textCharFormat(ids.at(i % ids.count())).foreground().color().red();
+    }
+    qint64 byId = qMax(qint64(1), timer.elapsed());
+    qDebug()<<"[benchmark] themeformats :"<<qRound64(1000.0 * lookups / byKey)<<"lookups/s by key,"
+            <<qRound64(1000.0 * lookups / byId)<<"lookups/s by id"<<"(checksum"<<checksum<<")";
+
+    WidgetFile widgetFile;
+    widgetFile.setDictionary(ConfigManager::NoDictionnary);
+    foreach(const QString & filename, files)
+    {
+        QString text = readFile(filename);
+        if(text.isEmpty())
+        {
+            continue;
+        }
+        widgetFile.widgetTextEdit()->setText(text);
+
+        timer.restart();
+        for(int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            widgetFile.syntaxHighlighter()->rehighlight();
+        }
+        qint64 elapsed = timer.elapsed();
+        qDebug()<<"[benchmark] themeformats"<<filename<<":"<<widgetFile.widgetTextEdit()->document()->blockCount()<<"blocks,"
+                <<(elapsed / BENCHMARK_RUNS)<<"ms per full rehighlight";
+    }
+}
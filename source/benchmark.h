@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QStringList>
+
+/**
+ * Micro benchmarks, only reachable when texiteasy is built with DEBUG_BENCHMARK.
+ *
+ * Usage: texiteasy --benchmark <name> [<file> ...]
+ * The results are written with qDebug().
+ */
+namespace Benchmark {
+
+    /**
+     * @brief run the benchmark requested on the command line.
+     * @return true if a benchmark has been run (the application should then exit).
+     */
+    bool run(const QStringList & arguments);
+
+    /**
+     * @brief highlighter rehighlight each file and report the number of characters per second.
+     */
+    void highlighter(const QStringList & files);
+
+    /**
+     * @brief blockData highlight each file and report the memory used by the BlockData of the document,
+     * compared with an estimation of the former layout (one CharacterData per character,
+     * heap allocated infos and two BlockState copies per block), then check that the interned
+     * states are freed once the document is emptied.
+     */
+    void blockData(const QStringList & files);
+
+    /**
+     * @brief spellChecker check every word of each file with the current dictionary,
+     * first with an empty cache then with a warm one, and report the number of words per second.
+     */
+    void spellChecker(const QStringList & files);
+
+    /**
+     * @brief fileStructure report the duration of a full FileStructure::updateStructure
+     * and the cost of keeping it up to date while new lines are typed.
+     */
+    void fileStructure(const QStringList & files);
+
+    /**
+     * @brief completion report the latency of the completion lookups (prefix and fuzzy) for prefixes of 1 to 5 characters.
+     */
+    void completion();
+
+    /**
+     * @brief symbols report the time spent to type a character and refresh the completion symbols (labels,
+     * custom commands, bibitems), compared with the former refresh: a scan of the whole document,
+     * the bibtex file parsed again and the words sorted. First check that labels and bibitems
+     * are harvested as complete \\ref{...} and \\cite{...} words.
+     */
+    void symbols(const QStringList & files);
+
+    /**
+     * @brief buildOutput give each log file to a Builder in chunks of 4 KB and report the throughput in MB/s.
+     */
+    void buildOutput(const QStringList & files);
+
+    /**
+     * @brief pdfScroll scroll through each pdf one third of a viewport at a time and report the time spent
+     * in paintEvent and the time until the visible pages are rendered at the current zoom (time to first pixel), then the state of the page cache.
+     */
+    void pdfScroll(const QStringList & files);
+
+    /**
+     * @brief synctex run a forward search for each line of each input of the pdfs, with PdfSynchronizer::query
+     * and with a SynctexIndex, and report the queries per second and the time spent building the index.
+     */
+    void synctex(const QStringList & files);
+
+    /**
+     * @brief themeFormats report the cost of a theme format lookup by key and by format id,
+     * then the duration of a full rehighlight of each file.
+     */
+    void themeFormats(const QStringList & files);
+}
+
+#endif // BENCHMARK_H
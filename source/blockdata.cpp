@@ -21,47 +21,85 @@
 
 #include "blockdata.h"
 #include <QDebug>
+#include <QMultiHash>
+#include <algorithm>
 #define max(a,b) (((a)>(b))?(a):(b))
 
-BlockData::BlockData(int length)
+BlockData::BlockData(int length) :
+    blockStartingState(BlockState::initial()),
+    blockEndingState(BlockState::initial()),
+    _symbols(0)
 {
     // WARNING : if length = 1, delete[] while cause a segmentation fault
     _length = max(2,length);
-    characterData.resize(_length);
+    characterData.reset(_length);
 
 }
 BlockData::~BlockData()
 {
-    //if(characterData)
+    if(_symbols)
     {
-        //qDebug()<<"length "<<_length;
-        //delete[] characterData;
-        //characterData = 0;
+        _symbols->table->remove(_symbols->words);
+        delete _symbols;
     }
 }
 
-QVector<ParenthesisInfo *> BlockData::parentheses() {
-    return _parentheses;
+void BlockData::setSymbols(SymbolTable *table, const QStringList &words)
+{
+    if(!_symbols)
+    {
+        if(words.isEmpty())
+        {
+            return;
+        }
+        _symbols = new BlockSymbols();
+    }
+    else if(_symbols->words == words && _symbols->table.data() == table)
+    {
+        return;
+    }
+    else
+    {
+        _symbols->table->remove(_symbols->words);
+    }
+    if(words.isEmpty())
+    {
+        delete _symbols;
+        _symbols = 0;
+        return;
+    }
+    _symbols->words = words;
+    _symbols->table = table;
+    table->add(words);
 }
-QVector<LatexBlockInfo *> BlockData::latexblocks() {
-    return _latexblocks;
+
+void BlockData::reset(int length)
+{
+    _length = max(2,length);
+    characterData.reset(_length);
+    _parentheses.resize(0);
+    _latexblocks.resize(0);
+    _dollars.resize(0);
+    arguments.resize(0);
+    blockStartingState = BlockState::initial();
+    blockEndingState = BlockState::initial();
 }
 
-void BlockData::insertPar( ParenthesisInfo *info ) {
-    int i = 0;
+void BlockData::insertPar( const ParenthesisInfo &info ) {
+    int i = _parentheses.size();
     while (
-        i < _parentheses.size() &&
-        info->position > _parentheses.at(i)->position )
-        ++i;
+        i > 0 &&
+        info.position <= _parentheses.at(i - 1).position )
+        --i;
     _parentheses.insert( i, info );
 }
 
-void BlockData::insertLat( LatexBlockInfo *info ) {
-    int i = 0;
+void BlockData::insertLat( const LatexBlockInfo &info ) {
+    int i = _latexblocks.size();
     while (
-        i < _latexblocks.size() &&
-        info->position > _latexblocks.at(i)->position )
-        ++i;
+        i > 0 &&
+        info.position <= _latexblocks.at(i - 1).position )
+        --i;
     _latexblocks.insert( i, info );
 }
 
@@ -79,12 +117,115 @@ bool BlockData::isAClosingDollar(int position)
     return even;
 }
 
-BlockState::BlockState(int state, int previousState, int stateAfterOption)
+int BlockData::memoryUsage() const
+{
+    int size = sizeof(BlockData) - sizeof(CharacterStates) + characterData.memoryUsage();
+    size += _parentheses.capacity() * sizeof(ParenthesisInfo);
+    size += _latexblocks.capacity() * sizeof(LatexBlockInfo);
+    foreach(const LatexBlockInfo & info, _latexblocks)
+    {
+        size += info.name.capacity() * sizeof(QChar);
+    }
+    size += _dollars.capacity() * sizeof(int);
+    size += arguments.capacity() * sizeof(QPair<QString,QPair<int,int> >);
+    if(_symbols)
+    {
+        size += sizeof(BlockSymbols);
+        foreach(const QString & word, _symbols->words)
+        {
+            size += sizeof(QString) + word.capacity() * sizeof(QChar);
+        }
+    }
+    return size;
+}
+
+
+void CharacterStates::reset(int length)
+{
+    _length = length;
+    _runs.resize(1);
+    _runs[0] = quint32(length) << 4;
+    _misspelled.clear();
+}
+
+void CharacterStates::assign(const quint8 *states, int length)
+{
+    int runCount = 0;
+    for(int position = 0; position < length; ++position)
+    {
+        if(position == 0 || states[position] != states[position - 1])
+        {
+            ++runCount;
+        }
+    }
+    _length = length;
+    _runs.resize(runCount);
+    _misspelled.clear();
+
+    int run = -1;
+    for(int position = 0; position < length; ++position)
+    {
+        if(position == 0 || states[position] != states[position - 1])
+        {
+            ++run;
+        }
+        _runs[run] = (quint32(position + 1) << 4) | (states[position] & 0xF);
+    }
+}
+
+void CharacterStates::setMisspelled(int position, int length)
+{
+    if(_misspelled.size() != _length)
+    {
+        _misspelled.resize(_length);
+    }
+    for(int idx = position; idx < position + length && idx < _length; ++idx)
+    {
+        _misspelled.setBit(idx);
+    }
+}
+
+int CharacterStates::state(int position) const
+{
+    if(position < 0 || position >= _length)
+    {
+        return 0;
+    }
+    // the first run whose end is after position
+    QVector<quint32>::const_iterator run = std::upper_bound(_runs.constBegin(), _runs.constEnd(), (quint32(position) << 4) | 0xF);
+    if(run == _runs.constEnd())
+    {
+        return 0;
+    }
+    return *run & 0xF;
+}
+
+int CharacterStates::memoryUsage() const
+{
+    return sizeof(CharacterStates) + _runs.capacity() * sizeof(quint32) + _misspelled.size() / 8;
+}
+
+
+BlockState::BlockState(int state, int previousState, int stateAfterOption) :
+    stateAfterArguments(0),
+    _interned(false)
 {
     this->state = state;
     this->previousState = previousState;
     this->stateAfterOption = stateAfterOption;
 }
+BlockState::BlockState(const BlockState &other) :
+    QSharedData(other),
+    state(other.state),
+    previousState(other.previousState),
+    stateAfterOption(other.stateAfterOption),
+    stateAfterArguments(other.stateAfterArguments),
+    parenthesisLevel(other.parenthesisLevel),
+    crocherLevel(other.crocherLevel),
+    environment(other.environment),
+    _interned(false)
+{
+}
 bool BlockState::equals(const BlockState & other) const
 {
     if(state != other.state)
@@ -131,3 +272,67 @@ bool BlockState::equals(const BlockState & other) const
     }
     return true;
 }
+
+uint BlockState::hash() const
+{
+    uint h = qHash(environment);
+    h = 31 * h + state;
+    h = 31 * h + previousState;
+    h = 31 * h + stateAfterOption;
+    h = 31 * h + stateAfterArguments;
+    foreach(int level, parenthesisLevel)
+    {
+        h = 31 * h + level;
+    }
+    h = 31 * h + 7;
+    foreach(int level, crocherLevel)
+    {
+        h = 31 * h + level;
+    }
+    return h;
+}
+
+static QMultiHash<uint, BlockState *> & internedStates()
+{
+    static QMultiHash<uint, BlockState *> states;
+    return states;
+}
+
+BlockState::~BlockState()
+{
+    if(_interned)
+    {
+        internedStates().remove(hash(), this);
+    }
+}
+
+BlockStatePointer BlockState::intern(const BlockState &state)
+{
+    QMultiHash<uint, BlockState *> & states = internedStates();
+    uint h = state.hash();
+    QMultiHash<uint, BlockState *>::const_iterator it = states.constFind(h);
+    while(it != states.constEnd() && it.key() == h)
+    {
+        if(it.value()->equals(state))
+        {
+            return BlockStatePointer(it.value());
+        }
+        ++it;
+    }
+    BlockState * internedState = new BlockState(state);
+    internedState->_interned = true;
+    states.insert(h, internedState);
+    return BlockStatePointer(internedState);
+}
+
+BlockStatePointer BlockState::initial()
+{
+    // kept referenced so that the initial state is never freed
+    static BlockStatePointer initialState = intern(BlockState());
+    return initialState;
+}
+
+int BlockState::internedCount()
+{
+    return internedStates().count();
+}
@@ -26,6 +26,10 @@
 #include <QStack>
 #include <QTextBlockUserData>
 #include <QPointer>
+#include <QBitArray>
+#include <QVector>
+#include <QExplicitlySharedDataPointer>
+#include "symboltable.h"
 
 struct ParenthesisInfo {
 
@@ -61,21 +65,43 @@ struct LatexBlockInfo {
                                LEVEL_PARAGRAPH      = 6
                               } SectionLevel;
 
+    LatexBlockInfo() : type(NONE), sectionLevel(LEVEL_ROOT), position(0), blockNumber(0) {}
 
     Type type;
     int sectionLevel; /**< releveant only if has type SECTION */
     int position;
     int blockNumber;
     QString name;
+
+    /**
+     * @brief hasSameStructure return true if both infos describe the same element of the outline.
+     * The block number and the position are ignored since the items are moved when text is inserted
+     * before them, the name is ignored since it is updated in place (see TextStruct::invalidateNames).
+     */
+    bool hasSameStructure(const LatexBlockInfo & other) const
+    {
+        return type == other.type && sectionLevel == other.sectionLevel;
+    }
 };
 
 class BlockData;
-class BlockState
+class BlockState;
+typedef QExplicitlySharedDataPointer<const BlockState> BlockStatePointer;
+
+/**
+ * @brief The BlockState class is the state of the highlighter at the beginning or at the end of a block.
+ * States are interned (see BlockState::intern) so that identical states share the same storage
+ * and can be compared by address. An interned state is freed with the last block that refers to it.
+ */
+class BlockState : public QSharedData
 {
 public:
-    BlockState() : stateAfterArguments(0) { state = 0; stateAfterOption = 0; parenthesisLevel.push(0); crocherLevel.push(0); }
+    BlockState() : state(0), previousState(0), stateAfterOption(0), stateAfterArguments(0), _interned(false) { parenthesisLevel.push(0); crocherLevel.push(0); }
     BlockState(int state, int previousState, int stateAfterOption);
+    BlockState(const BlockState & other);
+    ~BlockState();
     bool equals(const BlockState & other) const;
+    uint hash() const;
     int state;
     int previousState;
     int stateAfterOption;
@@ -84,16 +110,65 @@ public:
     QStack<int> crocherLevel;
     QString environment;
 
+    /**
+     * @brief intern return the shared instance equal to state. The instance is removed from the pool
+     * and deleted when the last pointer to it is released.
+     */
+    static BlockStatePointer intern(const BlockState & state);
+    static BlockStatePointer initial();
+    /**
+     * @brief internedCount return the number of interned states still referenced by a block
+     */
+    static int internedCount();
+private:
+    BlockState & operator=(const BlockState &);
+    bool _interned;
 };
 
 class CharacterData
 {
 public:
     CharacterData() : misspelled(false), state(0) {}
+    CharacterData(bool misspelled, int state) : misspelled(misspelled), state(state) {}
     bool misspelled;
     int state;
 };
 
+/**
+ * @brief The CharacterStates class stores the state of each character of a block
+ * as runs of identical states, and the misspelled characters in a bit array
+ * (only allocated if the block contains a misspelled word).
+ */
+class CharacterStates
+{
+public:
+    CharacterStates() : _length(0) {}
+    /**
+     * @brief assign encode the states of the length first characters
+     */
+    void assign(const quint8 * states, int length);
+    void reset(int length);
+    void setMisspelled(int position, int length);
+
+    int size() const { return _length; }
+    int count() const { return _length; }
+    int state(int position) const;
+    bool isMisspelled(int position) const { return position < _misspelled.size() && _misspelled.testBit(position); }
+    CharacterData at(int position) const { return CharacterData(isMisspelled(position), state(position)); }
+    CharacterData operator[](int position) const { return at(position); }
+    CharacterData last() const { return at(_length - 1); }
+    int memoryUsage() const;
+
+private:
+    /**
+     * @brief _runs each run is encoded as (end << 4) | state where end is the position
+     * following the last character of the run.
+     */
+    QVector<quint32> _runs;
+    QBitArray _misspelled;
+    int _length;
+};
+
 class BlockData : public QTextBlockUserData
 {
 
@@ -101,21 +176,45 @@ public:
     BlockData(int length = 1);
     ~BlockData();
     static BlockData *data(const QTextBlock &block) { return static_cast<BlockData *>(block.userData()); }
-
-    QVector<CharacterData> characterData;
-    QVector<ParenthesisInfo *> parentheses();
-    QVector<LatexBlockInfo *> latexblocks();
+    /**
+     * @brief reset clear the data before a new highlight of the block, keeping the allocated memory
+     */
+    void reset(int length);
+
+    CharacterStates characterData;
+    const QVector<ParenthesisInfo> & parentheses() const { return _parentheses; }
+    const QVector<LatexBlockInfo> & latexblocks() const { return _latexblocks; }
     QVector<QPair<QString,QPair<int,int> > > arguments;
-    void insertPar( ParenthesisInfo *info );
-    void insertLat( LatexBlockInfo *info );
+    void insertPar( const ParenthesisInfo &info );
+    void insertLat( const LatexBlockInfo &info );
     void insertDollar(int pos ) { this->_dollars.append(pos); }
     bool isAClosingDollar(int position);
     int length() { return _length; }
-    BlockState blockStartingState;
-    BlockState blockEndingState;
+    /**
+     * @brief memoryUsage return an estimation of the memory used by this block data, in bytes
+     */
+    int memoryUsage() const;
+    BlockStatePointer blockStartingState;
+    BlockStatePointer blockEndingState;
+
+    /**
+     * @brief setSymbols replace the symbols defined in this block, updating the counts of table.
+     * The symbols are removed from the table when the block is deleted.
+     */
+    void setSymbols(SymbolTable * table, const QStringList & words);
+    QStringList symbols() const { return _symbols ? _symbols->words : QStringList(); }
 private:
-    QVector<ParenthesisInfo *> _parentheses;
-    QVector<LatexBlockInfo *> _latexblocks;
+    /**
+     * @brief The BlockSymbols struct is only allocated for the few blocks that define symbols.
+     */
+    struct BlockSymbols
+    {
+        QStringList words;
+        QExplicitlySharedDataPointer<SymbolTable> table;
+    };
+    BlockSymbols * _symbols;
+    QVector<ParenthesisInfo> _parentheses;
+    QVector<LatexBlockInfo> _latexblocks;
     QVector<int> _dollars;
     int _length;
 };
@@ -26,6 +26,10 @@
 #include <QtGlobal>
 #include <QSettings>
 #include <QTextCodec>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
 #include "configmanager.h"
 
 QString Builder::Error = QObject::tr("Erreur");
@@ -34,7 +38,13 @@ QString Builder::Warning = QObject::tr("Warning");
 Builder::Builder(File * file) :
     file(file),
     process(new QProcess(this)),
-    _hiddingProcess(new QProcess(this))
+    _hiddingProcess(new QProcess(this)),
+    _outputDecoder(0),
+    _errorDecoder(0),
+    _incrementalBuild(false),
+    _passes(0),
+    _skippedPasses(0),
+    _pendingStep(OtherStep)
 {
     connect(this->process,SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(onFinished(int,QProcess::ExitStatus)));
     connect(this->process,SIGNAL(error(QProcess::ProcessError)), this, SLOT(onError(QProcess::ProcessError)));
@@ -42,6 +52,7 @@ Builder::Builder(File * file) :
     connect(this->process,SIGNAL(readyReadStandardError()), this, SLOT(onStandartOutputReady()));
     Builder::setupPathEnvironment(this->process);
     connect(&ConfigManager::Instance, SIGNAL(changed()), this, SLOT(setupPathEnvironment()));
+    connect(&_outputFilter, SIGNAL(entryAdded(LatexLogEntry)), this, SIGNAL(logEntryAdded(LatexLogEntry)));
 }
 
 Builder::~Builder()
@@ -50,6 +61,8 @@ Builder::~Builder()
     qDebug()<<"delete Builder";
 #endif
     process->deleteLater();
+    delete _outputDecoder;
+    delete _errorDecoder;
 }
 
 void Builder::setFile(File *file)
@@ -146,11 +159,256 @@ void Builder::builTex(QString command)
     command = command.arg(_basename);
 
     _commands = command.split(';');
-    command = QString(_commands.front()).trimmed();
-    _commands.pop_front();
-    qDebug()<<"start building : "<<command;
-    _lastOutput.append(command+"\n\n");
-    process->start(command);
+    _incrementalBuild = ConfigManager::Instance.isIncrementalBuild();
+    _passes = 0;
+    _skippedPasses = 0;
+    _latexInputs.clear();
+    _pendingStep = OtherStep;
+    _outputFilter.setSource(this->file->rootFilename());
+    _outputFilter.begin();
+    startNextCommand();
+}
+
+Builder::Step Builder::step(const QString &command)
+{
+    QString program = command.section(' ', 0, 0, QString::SectionSkipEmpty);
+    program.remove('"');
+    program = QFileInfo(program).completeBaseName().toLower();
+    if(program.contains(QRegExp("^(pdf|xe|lua){0,1}(la){0,1}tex$")))
+    {
+        return LatexStep;
+    }
+    if(program.contains(QRegExp("^(bibtex8{0,1}|biber)$")))
+    {
+        return BibliographyStep;
+    }
+    if(program.contains(QRegExp("^(makeindex|texindy)$")))
+    {
+        return IndexStep;
+    }
+    return OtherStep;
+}
+
+void Builder::startNextCommand()
+{
+    while(!_commands.isEmpty())
+    {
+        QString command = QString(_commands.front()).trimmed();
+        _commands.pop_front();
+        if(command.isEmpty())
+        {
+            continue;
+        }
+        QString separator = _passes + _skippedPasses ? "\n----------------------------------\n" : "";
+        QString reason;
+        if(_incrementalBuild && !this->isCommandNeeded(command, &reason))
+        {
+            ++_skippedPasses;
+            qDebug()<<"skip : "<<command<<" : "<<reason;
+            appendOutput(separator+trUtf8("Skipped %1 : %2").arg(command).arg(reason)+"\n");
+            continue;
+        }
+        ++_passes;
+        qDebug()<<"building with : "<<command<<" : "<<reason;
+        resetOutputDecoders();
+        if(reason.isEmpty())
+        {
+            appendOutput(separator+command+"\n\n");
+        }
+        else
+        {
+            appendOutput(separator+command+"    ("+reason+")\n\n");
+        }
+        process->start(command);
+        return;
+    }
+    this->finishBuild();
+}
+
+bool Builder::isCommandNeeded(const QString &command, QString *reason)
+{
+    _pendingStep = Builder::step(command);
+    _pendingHash.clear();
+    switch(_pendingStep)
+    {
+    case LatexStep:
+    {
+        QByteArray inputs = this->latexInputsHash();
+        if(_latexInputs.isEmpty())
+        {
+            // the sources have been saved to be built
+            *reason = trUtf8("first pass");
+        }
+        else
+        if(inputs == _latexInputs)
+        {
+            *reason = trUtf8("the auxiliary files did not change during the last pass");
+            return false;
+        }
+        else
+        {
+            *reason = trUtf8("the auxiliary files changed");
+        }
+        _latexInputs = inputs;
+        return true;
+    }
+    case BibliographyStep:
+        _pendingHash = this->citationsHash();
+        if(!QFileInfo(this->auxFilePath("bbl")).exists())
+        {
+            *reason = trUtf8("no bibliography yet");
+            return true;
+        }
+        if(_pendingHash == _bibliographyCitations)
+        {
+            *reason = trUtf8("the citations did not change");
+            return false;
+        }
+        *reason = trUtf8("the citations changed");
+        return true;
+    case IndexStep:
+        _pendingHash = Builder::hashFile(this->auxFilePath("idx"));
+        if(!QFileInfo(this->auxFilePath("ind")).exists())
+        {
+            *reason = trUtf8("no index yet");
+            return true;
+        }
+        if(_pendingHash == _indexEntries)
+        {
+            *reason = trUtf8("the index entries did not change");
+            return false;
+        }
+        *reason = trUtf8("the index entries changed");
+        return true;
+    default:
+        return true;
+    }
+}
+
+void Builder::finishBuild()
+{
+    if(_incrementalBuild)
+    {
+        appendOutput("\n----------------------------------\n"+trUtf8("%1 pass(es) run, %2 skipped").arg(_passes).arg(_skippedPasses)+"\n");
+    }
+    _outputFilter.end();
+    emit statusChanged(QString::fromUtf8("Terminé avec succés"));
+    emit success();
+    emit pdfChanged();
+    if(ConfigManager::Instance.hideAuxFiles())
+    {
+        this->hideAuxFiles();
+    }
+}
+
+QString Builder::auxFilePath(const QString &extension) const
+{
+    QString path = this->file->getRootPath();
+#ifdef OS_WINDOWS
+    if(ConfigManager::Instance.hideAuxFiles())
+    {
+        path += "/.texiteasy";
+    }
+#endif
+    return path + "/" + _basename + "." + extension;
+}
+
+QByteArray Builder::hashFile(const QString &filename)
+{
+    QFile file(filename);
+    if(!file.open(QFile::ReadOnly))
+    {
+        return QByteArray();
+    }
+    return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Md5);
+}
+
+/**
+ * @brief auxFiles return the aux file of the document and those of the files it includes
+ */
+static QStringList auxFiles(const QString & mainAuxFile)
+{
+    QStringList files;
+    files << mainAuxFile;
+    QFile aux(mainAuxFile);
+    if(!aux.open(QFile::ReadOnly | QFile::Text))
+    {
+        return files;
+    }
+    QString dir = QFileInfo(mainAuxFile).path();
+    QRegExp input("\\\\@input\\{([^}]+)\\}");
+    QString content = QString::fromLatin1(aux.readAll());
+    int pos = 0;
+    while((pos = input.indexIn(content, pos)) != -1)
+    {
+        files << dir + "/" + input.cap(1);
+        pos += input.matchedLength();
+    }
+    return files;
+}
+
+QByteArray Builder::latexInputsHash() const
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    foreach(const QString & extension, QStringList() << "toc" << "lof" << "lot" << "out" << "bbl" << "ind" << "gls" << "nav" << "snm")
+    {
+        hash.addData(extension.toLatin1());
+        hash.addData(Builder::hashFile(this->auxFilePath(extension)));
+    }
+    foreach(const QString & filename, auxFiles(this->auxFilePath("aux")))
+    {
+        hash.addData(filename.toUtf8());
+        hash.addData(Builder::hashFile(filename));
+    }
+    return hash.result();
+}
+
+QByteArray Builder::citationsHash() const
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QStringList bibFiles;
+    foreach(const QString & filename, auxFiles(this->auxFilePath("aux")))
+    {
+        QFile aux(filename);
+        if(!aux.open(QFile::ReadOnly | QFile::Text))
+        {
+            continue;
+        }
+        while(!aux.atEnd())
+        {
+            QByteArray line = aux.readLine();
+            if(line.startsWith("\\citation") || line.startsWith("\\bibstyle") || line.startsWith("\\abx@aux"))
+            {
+                hash.addData(line);
+            }
+            else
+            if(line.startsWith("\\bibdata"))
+            {
+                hash.addData(line);
+                QString data = QString::fromLatin1(line).section('{', 1).section('}', 0, 0);
+                foreach(const QString & bibFile, data.split(',', QString::SkipEmptyParts))
+                {
+                    bibFiles << bibFile.trimmed() + ".bib";
+                }
+            }
+        }
+    }
+    // biblatex keeps its citations in the bcf file
+    hash.addData(Builder::hashFile(this->auxFilePath("bcf")));
+
+    QDir root(this->file->getRootPath());
+    foreach(const QFileInfo & info, root.entryInfoList(QStringList() << "*.bib", QDir::Files))
+    {
+        bibFiles << info.fileName();
+    }
+    foreach(const QString & bibFile, bibFiles)
+    {
+        QFileInfo info(root, bibFile);
+        hash.addData(bibFile.toUtf8());
+        hash.addData(info.lastModified().toString(Qt::ISODate).toLatin1());
+        hash.addData(QByteArray::number(info.size()));
+    }
+    return hash.result();
 }
 
 void Builder::clean()
@@ -183,10 +441,17 @@ void Builder::bibtex()
         return;
     }
     _basename = this->file->rootBasename();
+    _commands.clear();
+    _incrementalBuild = false;
+    _pendingStep = BibliographyStep;
+    _pendingHash = this->citationsHash();
 
     process->setWorkingDirectory(this->file->getRootPath());
     QString command = ConfigManager::Instance.bibtexCommand().arg(_basename);//.arg(".texiteasy");//this->file->getPath()).arg();//this->file->getAuxPath());
     qDebug()<<command;
+    resetOutputDecoders();
+    _outputFilter.setSource(this->file->rootFilename());
+    _outputFilter.begin();
     process->start(command);
 }
 
@@ -209,41 +474,75 @@ void Builder::onFinished(int /*exitCode*/, QProcess::ExitStatus exitStatus)
     this->file->refreshLineNumber();
     if(!checkOutput())
     {
+        // a failed run must be done again by the next build
+        if(_pendingStep == BibliographyStep)
+        {
+            _bibliographyCitations.clear();
+        }
+        else
+        if(_pendingStep == IndexStep)
+        {
+            _indexEntries.clear();
+        }
+        _outputFilter.end();
         emit error();
         emit statusChanged(QString::fromUtf8("Terminé avec des erreurs"));
         return;
     }
-    if(!_commands.isEmpty())
+    if(_pendingStep == BibliographyStep && !_pendingHash.isEmpty())
     {
-        QString command = QString(_commands.front()).trimmed();
-        _commands.pop_front();
-        qDebug()<<"continue building with : "<<command;
-        _lastOutput.append("\n----------------------------------\n"+command+"\n\n");
-        process->start(command);
-        return;
+        _bibliographyCitations = _pendingHash;
     }
-    emit statusChanged(QString::fromUtf8("Terminé avec succés"));
-    emit success();
-    emit pdfChanged();
-    if(ConfigManager::Instance.hideAuxFiles())
+    else
+    if(_pendingStep == IndexStep && !_pendingHash.isEmpty())
     {
-        this->hideAuxFiles();
+        _indexEntries = _pendingHash;
     }
+    _pendingStep = OtherStep;
+    this->startNextCommand();
 }
 void Builder::onStandartOutputReady()
 {
-    while(this->process->bytesAvailable())
-    {
-        _lastOutput.append(process->read(1));
-    }
-/*
-    //Old way to do it, but sometimes a character is missing
-    QTextCodec* codec = QTextCodec::codecForUtfText("ISO 8859-1");
-    QString output = codec->toUnicode(this->process->readAllStandardOutput());
-    qDebug()<<output;
-    _lastOutput.append(output);
-*/
-    emit outputUpdated(_lastOutput);
+    // read everything available at once, the decoders keep the incomplete characters for the next chunk
+    appendProcessOutput(QProcess::StandardOutput, process->readAllStandardOutput());
+    appendProcessOutput(QProcess::StandardError, process->readAllStandardError());
+}
+
+void Builder::appendProcessOutput(QProcess::ProcessChannel channel, const QByteArray &data)
+{
+    if(data.isEmpty())
+    {
+        return;
+    }
+    QTextDecoder ** decoder = channel == QProcess::StandardOutput ? &_outputDecoder : &_errorDecoder;
+    if(!*decoder)
+    {
+        *decoder = QTextCodec::codecForName("UTF-8")->makeDecoder();
+    }
+    QString text = (*decoder)->toUnicode(data);
+    if((*decoder)->hasFailure())
+    {
+        // not UTF-8 (TeX usually writes its log in the 8 bit encoding of the input)
+        delete *decoder;
+        *decoder = QTextCodec::codecForName("ISO 8859-1")->makeDecoder();
+        text = (*decoder)->toUnicode(data);
+    }
+    appendOutput(text);
+}
+
+void Builder::appendOutput(const QString &text)
+{
+    _lastOutput.append(text);
+    _outputFilter.append(text);
+    emit outputAppended(text);
+}
+
+void Builder::resetOutputDecoders()
+{
+    delete _outputDecoder;
+    delete _errorDecoder;
+    _outputDecoder = 0;
+    _errorDecoder = 0;
 }
 void Builder::hideAuxFiles()
 {
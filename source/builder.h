@@ -25,8 +25,10 @@
 #include <QList>
 #include <QProcess>
 #include <QStringList>
+#include "latexoutputfilter.h"
 
 class File;
+class QTextDecoder;
 
 
 
@@ -47,9 +49,19 @@ public:
 
     const QList<Builder::Output> & simpleOutput() const { return _simpleOutPut; }
     const QString & output() const { return _lastOutput; }
+    /**
+     * @brief logEntries return the errors, warnings and bad boxes found in the output of the current build
+     */
+    const QList<LatexLogEntry> & logEntries() const { return _outputFilter.m_infoList; }
     static QString Error;
     static QString Warning;
     static bool setupPathEnvironment(QProcess *process);
+    /**
+     * @brief appendProcessOutput decode a chunk read from the process and append it to the output.
+     * The decoding is incremental (a character may be split between two chunks): UTF-8 is used
+     * until an invalid sequence is found, then the rest of the run is decoded as Latin-1.
+     */
+    void appendProcessOutput(QProcess::ProcessChannel channel, const QByteArray & data);
 
 public slots:
     void builTex(QString command);
@@ -62,22 +74,93 @@ public slots:
 
 signals:
     void statusChanged(QString);
+    /**
+     * @brief outputUpdated is emitted when the whole output is replaced
+     */
     void outputUpdated(QString);
+    /**
+     * @brief outputAppended is emitted with the text appended to the output since the last emission
+     */
+    void outputAppended(QString);
     void pdfChanged();
+    /**
+     * @brief logEntryAdded is emitted while the build runs, as soon as an error, a warning or a bad box is parsed
+     */
+    void logEntryAdded(const LatexLogEntry & entry);
     void error();
     void success();
     void started();
 
 private:
+    /**
+     * @brief The Step enum is the kind of program run by a command of the build
+     */
+    enum Step { LatexStep, BibliographyStep, IndexStep, OtherStep };
+    static Step step(const QString & command);
+    /**
+     * @brief startNextCommand start the first command still needed, the others are skipped with their reason,
+     * and finish the build if there is none.
+     */
+    void startNextCommand();
+    /**
+     * @brief isCommandNeeded return false if the inputs of the command are those it has already processed
+     * @param reason is set to the reason of running or skipping the command
+     */
+    bool isCommandNeeded(const QString & command, QString * reason);
+    void finishBuild();
+    /**
+     * @brief auxFilePath return the path of the generated file basename.extension
+     */
+    QString auxFilePath(const QString & extension) const;
+    /**
+     * @brief hashFile return the md5 of the file, an empty array if it does not exist
+     */
+    static QByteArray hashFile(const QString & filename);
+    /**
+     * @brief latexInputsHash hash the generated files read by LaTeX (aux, toc, bbl, ind...)
+     */
+    QByteArray latexInputsHash() const;
+    /**
+     * @brief citationsHash hash the citations and bibliography data of the aux files and the dates of the bib files
+     */
+    QByteArray citationsHash() const;
     void hideAuxFiles();
     bool checkOutput();
+    void appendOutput(const QString & text);
+    void resetOutputDecoders();
     File * file;
     QString _basename;
     QProcess * process;
     QProcess * _hiddingProcess;
     QString _lastOutput;
+    QTextDecoder * _outputDecoder;
+    QTextDecoder * _errorDecoder;
     QStringList _commands;
     QList<Builder::Output> _simpleOutPut;
+    /**
+     * @brief _outputFilter parses the output of the build while it is appended
+     */
+    LatexOutputFilter _outputFilter;
+    bool _incrementalBuild;
+    int _passes;
+    int _skippedPasses;
+    /**
+     * @brief _latexInputs is the hash of the generated files when the last LaTeX pass started
+     */
+    QByteArray _latexInputs;
+    /**
+     * @brief _bibliographyCitations is the hash of the citations processed by the last successful bibtex run
+     */
+    QByteArray _bibliographyCitations;
+    /**
+     * @brief _indexEntries is the hash of the idx file processed by the last successful makeindex run
+     */
+    QByteArray _indexEntries;
+    /**
+     * @brief _pendingStep is the kind of the command running, its hash is recorded when it succeeds
+     */
+    Step _pendingStep;
+    QByteArray _pendingHash;
 };
 
 #endif // BUILDER_H
@@ -32,6 +32,10 @@
 #include "widgettooltip.h"
 #include "filestructure.h"
 #include "configmanager.h"
+#include "syntaxhighlighter.h"
+#include "widgetfile.h"
+#include "file.h"
+#include <QFileInfo>
 
 bool completionStringLessThan(const QString &s1, const QString &s2)
 {
@@ -56,24 +60,34 @@ bool completionStringLessThan(const QString &s1, const QString &s2)
     return s1.at(i) < s2.at(i);
 }
 
+CompletionIndex CompletionEngine::_wordIndex;
+QStringList CompletionEngine::_indexedFiles;
+
+/**
+ * @brief markerIndex return the position of the # that separates a command from its completion flags, -1 if none.
+ */
+static int markerIndex(const QString & word)
+{
+    int index = word.indexOf('#', 1);
+    while(index != -1 && word.at(index - 1) == '\\')
+    {
+        index = word.indexOf('#', index + 1);
+    }
+    return index;
+}
+
 CompletionEngine::CompletionEngine(WidgetTextEdit *parent) :
     QListWidget(parent),
     _commandBegin(QString("")),
     _widgetTextEdit(parent),
-    _widgetTooltip(0)
+    _widgetTooltip(0),
+    _symbolRevision(-1)
 {
     this->setVisible(false);
 
-    foreach(const QString &filename, ConfigManager::Instance.completionFiles())
-    {
-        this->loadFile(filename);
-    }
+    loadCompletionFiles();
 
     connect(this, SIGNAL(currentRowChanged(int)), this, SLOT(cellSelected(int)));
-    _words.removeDuplicates();
-    qSort(_words.begin(), _words.end(), completionStringLessThan);
-    //_words.sort();
-    //qDebug()<<"Completion engine Initialized : "<<_words.count()<<" words";
 }
 CompletionEngine::~CompletionEngine()
 {
@@ -81,7 +95,26 @@ CompletionEngine::~CompletionEngine()
     qDebug()<<"delete CompletionEngine";
 #endif
 }
-void CompletionEngine::loadFile(QString filename)
+void CompletionEngine::loadCompletionFiles()
+{
+    QStringList files = ConfigManager::Instance.completionFiles();
+    if(files == _indexedFiles)
+    {
+        return;
+    }
+    QStringList words;
+    foreach(const QString &filename, files)
+    {
+        loadFile(filename, &words);
+    }
+    words.removeDuplicates();
+    qSort(words.begin(), words.end(), completionStringLessThan);
+    _wordIndex.setWords(words);
+    _indexedFiles = files;
+    //qDebug()<<"Completion engine Initialized : "<<words.count()<<" words";
+}
+
+void CompletionEngine::loadFile(QString filename, QStringList * words)
 {
     QFile userTagsfile(filename);
 
@@ -92,7 +125,7 @@ void CompletionEngine::loadFile(QString filename)
     while (!in.atEnd())
     {
         line = in.readLine();
-        if (!line.isEmpty()) _words.append(line.remove("\n"));
+        if (!line.isEmpty()) words->append(line.remove("\n"));
     }
 }
 
@@ -104,14 +137,23 @@ void CompletionEngine::proposeCommand(int left, int top, int lineHeight, QString
         this->parentWidget()->setFocus();
         return;
     }
-    QRegExp commandRegexCaseInsensitive = QRegExp("^\\"+QString(commandBegin).replace('{',"\\{"), Qt::CaseInsensitive);
-    QRegExp commandRegex = QRegExp("^\\"+QString(commandBegin).replace('{',"\\{"));
     this->addCustomWordFromSource(); //dont know where to put it but it seems to be a fast function so it's ok!
+    if(_customWordIndex.words() != _customWords)
+    {
+        _customWordIndex.setWords(_customWords);
+    }
 
-    QStringList found =  this->_customWords.filter(commandRegex);
-    found.append(this->_customWords.filter(commandRegexCaseInsensitive));
-    found.append(this->_words.filter(commandRegex));
-    found.append(this->_words.filter(commandRegexCaseInsensitive));
+    // case sensitive matches first, then the case insensitive ones (or the best fuzzy matches first)
+    bool fuzzy = ConfigManager::Instance.isCompletionFuzzy();
+    QStringList found;
+    foreach(int index, fuzzy ? _customWordIndex.findFuzzy(commandBegin) : _customWordIndex.find(commandBegin))
+    {
+        found.append(_customWordIndex.words().at(index));
+    }
+    foreach(int index, fuzzy ? _wordIndex.findFuzzy(commandBegin) : _wordIndex.find(commandBegin))
+    {
+        found.append(_wordIndex.words().at(index));
+    }
 
     found.removeDuplicates();
 
@@ -127,16 +169,16 @@ void CompletionEngine::proposeCommand(int left, int top, int lineHeight, QString
     this->setVisible(true);
     int idx = 0;
     int dieseIndex, tooltipIndex;
-    if(commandBegin.indexOf(QRegExp("^\\\\end")) != -1)
+    if(commandBegin.startsWith("\\end"))
     {
         found.insert(0, "\\end{"+_widgetTextEdit->textStruct()->currentEnvironment()+"}");
     }
     foreach(const QString &word, found)
     {
-        if((dieseIndex = word.indexOf(QRegExp("[^\\\\]#"))) != -1)
+        if((dieseIndex = markerIndex(word)) != -1)
         {
-            QString command = word.left(dieseIndex + 1);
-            if(word.at(dieseIndex + 2) == 'm')
+            QString command = word.left(dieseIndex);
+            if(dieseIndex + 1 < word.length() && word.at(dieseIndex + 1) == 'm')
             {
                 QListWidgetItem * item = new QListWidgetItem(command);
                 item->setToolTip(trUtf8("In <strong>math</strong> environment"));
@@ -316,59 +358,50 @@ void CompletionEngine::keyPressEvent(QKeyEvent *event)
 
 void CompletionEngine::addCustomWordFromSource()
 {
-    _customWords.clear();
-    QString source = dynamic_cast<WidgetTextEdit*>(this->parent())->toPlainText();
-    QRegExp patternCommand("\\\\(re){0,1}newcommand\\{([^\\}]*)\\}");
-    int index = source.indexOf(patternCommand);
-    while(index != -1)
-    {
-        _customWords.append(patternCommand.capturedTexts().last());
-        index = source.indexOf(patternCommand, index + 1);
-    }
-
-
-    QRegExp patternLabel("\\\\label\\{([^\\}]*)\\}");
-    index = source.indexOf(patternLabel);
-    while(index != -1)
-    {
-        _customWords.append("\\ref{"+patternLabel.capturedTexts().last()+"}");
-        index = source.indexOf(patternLabel, index + 1);
-    }
-
-    QRegExp patternBibitem("\\\\bibitem\\{([^\\}]*)\\}");
-    index = source.indexOf(patternBibitem);
-    while(index != -1)
+    // the labels, custom commands and bibitems are collected block by block by the highlighter
+    const SymbolTable * symbolTable = _widgetTextEdit->widgetFile()->syntaxHighlighter()->symbolTable();
+    bool bibtexChanged = parseBibtexFile();
+    if(!bibtexChanged && symbolTable->revision() == _symbolRevision)
     {
-        _customWords.append("\\cite{"+patternBibitem.capturedTexts().last()+"}");
-        index = source.indexOf(patternBibitem, index + 1);
+        return;
     }
-    parseBibtexFile();
+    _symbolRevision = symbolTable->revision();
+    _customWords = symbolTable->words() + _bibtexWords;
     _customWords.removeDuplicates();
     _customWords.sort();
 }
 
-void CompletionEngine::parseBibtexFile()
+bool CompletionEngine::parseBibtexFile()
 {
     QStringList bibtexFiles = this->_widgetTextEdit->getCurrentFile()->bibtexFiles();
-    if(bibtexFiles.isEmpty())
+    QString filename = bibtexFiles.isEmpty() ? QString() : bibtexFiles.first();
+    QDateTime lastModified = filename.isEmpty() ? QDateTime() : QFileInfo(filename).lastModified();
+    // the file is parsed again only if it has been modified
+    if(filename == _bibtexFilename && lastModified == _bibtexLastModified)
     {
-        return;
+        return false;
+    }
+    _bibtexFilename = filename;
+    _bibtexLastModified = lastModified;
+    _bibtexWords.clear();
+    if(filename.isEmpty())
+    {
+        return true;
     }
-    QString filename = bibtexFiles.first();
     QFile bibFile(filename);
 
     if(!bibFile.open(QFile::Text | QFile::ReadOnly))
     {
         qDebug()<<"failed to open bibtex file : "<<filename<<" "<<bibFile.errorString();
-        return;
+        return true;
     }
 
     QList<BibItem> bibItemList = this->parseBibtexSource(bibFile.readAll());
     foreach(BibItem bibItem, bibItemList)
     {
-        _customWords.append("\\cite{"+bibItem.key+"}?<strong>"+bibItem.title+"</strong><div style=\"color:\\#444444;font-style: italic\">"+bibItem.author+"</div>");
+        _bibtexWords.append("\\cite{"+bibItem.key+"}?<strong>"+bibItem.title+"</strong><div style=\"color:\\#444444;font-style: italic\">"+bibItem.author+"</div>");
     }
-
+    return true;
 }
 QList<BibItem> CompletionEngine::parseBibtexSource(QString source)
 {
@@ -24,6 +24,8 @@
 #include <QListWidget>
 #include <QStringList>
 #include <QString>
+#include <QDateTime>
+#include "completionindex.h"
 
 class WidgetTextEdit;
 class WidgetTooltip;
@@ -46,9 +48,25 @@ public:
     void proposeCommand(int left, int top, int lineHeight, QString commandBegin);
     QString acceptedWord();
 
+    /**
+     * @brief addCustomWordFromSource update the custom words from the symbol table of the highlighter
+     * and the bibtex file (only if something changed).
+     */
     void addCustomWordFromSource();
-    void parseBibtexFile();
+    /**
+     * @brief parseBibtexFile parse the first bibtex file if it changed since the last call.
+     * @return true if the bibtex words changed
+     */
+    bool parseBibtexFile();
+    /**
+     * @brief parseBibtexSource return the key, the title and the author of each item of a bibtex source
+     */
+    static QList<BibItem> parseBibtexSource(QString source);
     const QStringList customWords() const { return _customWords; }
+    /**
+     * @brief wordIndex return the index of the words of the completion files
+     */
+    static const CompletionIndex & wordIndex() { loadCompletionFiles(); return _wordIndex; }
 public slots:
  //   void setFocus(void);
     void cellSelected(int);
@@ -58,14 +76,24 @@ protected:
     void keyPressEvent(QKeyEvent *event);
 
 private:
-    void loadFile(QString filename);
-    QList<BibItem> parseBibtexSource(QString source);
+    /**
+     * @brief loadCompletionFiles build the index of the words of ConfigManager::completionFiles(),
+     * shared by all the editors (it is built again only if the list of files changed).
+     */
+    static void loadCompletionFiles();
+    static void loadFile(QString filename, QStringList * words);
 
     QString _commandBegin;
     QStringList _customWords;
     WidgetTextEdit * _widgetTextEdit;
     WidgetTooltip * _widgetTooltip;
-    QStringList _words;
+    CompletionIndex _customWordIndex;
+    int _symbolRevision;
+    QString _bibtexFilename;
+    QDateTime _bibtexLastModified;
+    QStringList _bibtexWords;
+    static CompletionIndex _wordIndex;
+    static QStringList _indexedFiles;
 
 };
 
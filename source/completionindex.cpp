@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "completionindex.h"
+
+#include <QPair>
+#include <algorithm>
+
+CompletionIndex::CompletionIndex()
+{
+}
+
+void CompletionIndex::setWords(const QStringList &words)
+{
+    _words = words;
+    _entries.resize(_words.count());
+    for(int i = 0; i < _words.count(); ++i)
+    {
+        _entries[i].key = _words.at(i).toCaseFolded();
+        _entries[i].word = i;
+    }
+    std::sort(_entries.begin(), _entries.end());
+}
+
+void CompletionIndex::range(const QString &foldedPrefix, int *begin, int *end) const
+{
+    Entry entry;
+    entry.key = foldedPrefix;
+    QVector<Entry>::const_iterator it = std::lower_bound(_entries.constBegin(), _entries.constEnd(), entry);
+    *begin = it - _entries.constBegin();
+    while(it != _entries.constEnd() && it->key.startsWith(foldedPrefix))
+    {
+        ++it;
+    }
+    *end = it - _entries.constBegin();
+}
+
+QList<int> CompletionIndex::find(const QString &prefix) const
+{
+    int begin, end;
+    range(prefix.toCaseFolded(), &begin, &end);
+
+    QList<int> caseSensitive;
+    QList<int> caseInsensitive;
+    for(int i = begin; i < end; ++i)
+    {
+        int word = _entries.at(i).word;
+        if(_words.at(word).startsWith(prefix))
+        {
+            caseSensitive.append(word);
+        }
+        else
+        {
+            caseInsensitive.append(word);
+        }
+    }
+    std::sort(caseSensitive.begin(), caseSensitive.end());
+    std::sort(caseInsensitive.begin(), caseInsensitive.end());
+    return caseSensitive + caseInsensitive;
+}
+
+bool CompletionIndex::fuzzyMatch(const QString &key, const QString &foldedPattern, int * score)
+{
+    *score = 0;
+    int keyIndex = 0;
+    int consecutive = 0;
+    foreach(const QChar & c, foldedPattern)
+    {
+        int found = key.indexOf(c, keyIndex);
+        if(found == -1)
+        {
+            return false;
+        }
+        consecutive = found == keyIndex ? consecutive + 1 : 0;
+        *score += 10 * consecutive - (found - keyIndex);
+        keyIndex = found + 1;
+    }
+    // shorter words first when the matches are equivalent
+    *score -= key.length() / 4;
+    return true;
+}
+
+QList<int> CompletionIndex::findFuzzy(const QString &pattern) const
+{
+    QString foldedPattern = pattern.toCaseFolded();
+    int begin, end;
+    range(foldedPattern.left(2), &begin, &end);
+
+    QList<QPair<int, int> > matches;
+    for(int i = begin; i < end; ++i)
+    {
+        int score;
+        if(fuzzyMatch(_entries.at(i).key, foldedPattern, &score))
+        {
+            // negative score so that the best matches come first, ties are broken by the order of words()
+            matches.append(qMakePair(-score, _entries.at(i).word));
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    QList<int> result;
+    for(int i = 0; i < matches.count(); ++i)
+    {
+        result.append(matches.at(i).second);
+    }
+    return result;
+}
@@ -0,0 +1,76 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef COMPLETIONINDEX_H
+#define COMPLETIONINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief The CompletionIndex class is a sorted array of the completion words, case folded,
+ * in which the words beginning with a prefix are found by binary search.
+ */
+class CompletionIndex
+{
+public:
+    CompletionIndex();
+
+    /**
+     * @brief setWords build the index. The order of words is kept in the results
+     * (they should already be sorted for display).
+     */
+    void setWords(const QStringList & words);
+    const QStringList & words() const { return _words; }
+    int count() const { return _words.count(); }
+
+    /**
+     * @brief find return the indexes (in words()) of the words beginning with prefix: the case sensitive
+     * matches come first, then the case insensitive ones, each group in the order of words().
+     * O(log n + k log k) where k is the number of matches.
+     */
+    QList<int> find(const QString & prefix) const;
+    /**
+     * @brief findFuzzy return the indexes of the words that contain the characters of pattern in the same order,
+     * the best matches first (consecutive characters and early positions are preferred).
+     * Only the words beginning with the first two characters of pattern are considered.
+     */
+    QList<int> findFuzzy(const QString & pattern) const;
+
+private:
+    struct Entry
+    {
+        QString key;  /**< case folded word */
+        int word;     /**< index in _words */
+        bool operator<(const Entry & other) const { return key < other.key; }
+    };
+    /**
+     * @brief range set [begin, end[ to the entries whose key begins with foldedPrefix
+     */
+    void range(const QString & foldedPrefix, int * begin, int * end) const;
+    static bool fuzzyMatch(const QString & key, const QString & foldedPattern, int * score);
+
+    QStringList _words;
+    QVector<Entry> _entries;
+};
+
+#endif // COMPLETIONINDEX_H
@@ -110,10 +110,31 @@ const QStringList ConfigManager::DefaultCompletionFiles = QString(
 const QStringList ConfigManager::CodecsAvailable =
         QString("UTF-8\n\nApple Roman\nBig5\nBig5-HKSCS\nCP949\nEUC-JP\nEUC-KR\nGB18030-0\nIBM 850\nIBM 866\nIBM 874\nISO 2022-JP\nISO 8859-*/ISO 8859-1\n-/ISO 8859-2\n-/ISO 8859-3\n-/ISO 8859-4\n-/ISO 8859-5\n-/ISO 8859-6\n-/ISO 8859-7\n-/ISO 8859-8\n-/ISO 8859-9\n-/ISO 8859-10\n-/ISO 8859-13\n-/ISO 8859-14\n-/ISO 8859-15\n-/ISO 8859-16\nIscii-*/Iscii-Bng\n-/Iscii-Dev\n-/Iscii-Gjr\n-/Iscii-Knd\n-/Iscii-Mlm\n-/Iscii-Ori\n-/Iscii-Pnj\n-/Iscii-Tlg\n-/Iscii-Tml\nJIS X 0201\nJIS X 0208\nKOI8-R\nKOI8-U\nShift-JIS\nTIS-620\nTSCII\nUTF-8\nUTF-16\nUTF-16BE\nUTF-16LE\nUTF-32\nUTF-32BE\nUTF-32LE\nWindows-*/Windows-1250\n-/Windows-1251\n-/Windows-1252\n-/Windows-1253\n-/Windows-1254\n-/Windows-1255\n-/Windows-1256\n-/Windows-1257\n-/Windows-1258\n").split('\n');
 
+SettingsSnapshot::SettingsSnapshot() :
+    tabWidth(4),
+    spaceIndentation(true),
+    tabString(4, ' '),
+    pointSize(0),
+    dollarAuto(true),
+    lineWrapped(true),
+    doubleClickToGoToError(false),
+    completionFuzzy(false),
+    blockChangeMarkerEnable(true),
+    pdfSynchronized(true),
+    pdfPrefetchPages(2)
+{
+}
+
 ConfigManager::ConfigManager() :
     mainWindow(0),
-    textCharFormats(new QMap<QString,QTextCharFormat>())
+    textCharFormats(new QMap<QString,QTextCharFormat>()),
+    _themeRevision(0),
+    _settingsLoaded(false)
 {
+    this->formatId("normal");
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(1000);
+    connect(&_flushTimer, SIGNAL(timeout()), this, SLOT(flushSettings()));
 
     QCoreApplication::setOrganizationName("TexitEasy");
     QCoreApplication::setOrganizationDomain("texiteasy.com");
@@ -202,6 +223,7 @@ void ConfigManager::init(QString in_applicationPath)
         charFormat.setFont(font);
         charFormat.setBackground(QColor(250,250,250));
         textCharFormats->insert("normal",charFormat);
+        this->compileTheme();
     }
     settings.endGroup();
 
@@ -222,6 +244,10 @@ void ConfigManager::init(QString in_applicationPath)
         checkLatexExecutable(); //on windows, may show a dialog, so translations must be applyed
     }
 
+    // from now on the settings are read from memory and written behind
+    this->loadSettings();
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(flushSettings()));
+
 
 
     //Log::debug(QString("dictionnaryPath : %1").arg(this->dictionaryPath());
@@ -243,6 +269,81 @@ ConfigManager::~ConfigManager()
     delete this->textCharFormats;
 }
 
+QVariant ConfigManager::setting(const QString &key, const QVariant &defaultValue) const
+{
+    if(!_settingsLoaded)
+    {
+        QSettings settings;
+        return settings.value(key, defaultValue);
+    }
+    return _settings.value(key, defaultValue);
+}
+
+void ConfigManager::setSetting(const QString &key, const QVariant &value)
+{
+    if(!_settingsLoaded)
+    {
+        QSettings settings;
+        settings.setValue(key, value);
+    }
+    else
+    {
+        _settings.insert(key, value);
+        _pendingSettings.insert(key, value);
+        this->updateSnapshot();
+        // the changes made until the timeout are written together
+        if(!_flushTimer.isActive())
+        {
+            _flushTimer.start();
+        }
+    }
+    emit settingChanged(key);
+}
+
+void ConfigManager::flushSettings()
+{
+    _flushTimer.stop();
+    if(_pendingSettings.isEmpty())
+    {
+        return;
+    }
+    QSettings settings;
+    QHash<QString, QVariant>::const_iterator it;
+    for(it = _pendingSettings.constBegin(); it != _pendingSettings.constEnd(); ++it)
+    {
+        settings.setValue(it.key(), it.value());
+    }
+    _pendingSettings.clear();
+    settings.sync();
+}
+
+void ConfigManager::loadSettings()
+{
+    QSettings settings;
+    _settings.clear();
+    foreach(const QString & key, settings.allKeys())
+    {
+        _settings.insert(key, settings.value(key));
+    }
+    _settingsLoaded = true;
+    this->updateSnapshot();
+}
+
+void ConfigManager::updateSnapshot()
+{
+    _snapshot.tabWidth = this->setting("tabWidth", 4).toInt();
+    _snapshot.spaceIndentation = this->setting("spaceIndentation", true).toBool();
+    _snapshot.tabString = _snapshot.spaceIndentation ? QString().fill(' ', _snapshot.tabWidth) : QString("\t");
+    _snapshot.pointSize = this->setting("theme/pointSize").toInt();
+    _snapshot.dollarAuto = this->setting("dollarAuto", true).toBool();
+    _snapshot.lineWrapped = this->setting("lineWrapped", true).toBool();
+    _snapshot.doubleClickToGoToError = this->setting("doubleClickToGoToError", false).toBool();
+    _snapshot.completionFuzzy = this->setting("completionFuzzy", false).toBool();
+    _snapshot.blockChangeMarkerEnable = this->setting("blockChangeMarkerEnable", true).toBool();
+    _snapshot.pdfSynchronized = this->setting("pdfSynchronized", true).toBool();
+    _snapshot.pdfPrefetchPages = this->setting("pdfPrefetchPages", 2).toInt();
+}
+
 QString ConfigManager::textCharFormatToString(QTextCharFormat charFormat, QTextCharFormat defaultFormat)
 {
     QString config;
@@ -379,15 +480,11 @@ void ConfigManager::changePointSizeBy(int delta)
 }
 void ConfigManager::setReplaceDefaultFont(bool replace)
 {
-    QSettings settings;
-    settings.beginGroup("theme");
-    settings.setValue("replaceDefaultFont",replace);
+    this->setSetting("theme/replaceDefaultFont",replace);
 }
 void ConfigManager::replaceDefaultFont()
 {
-    QSettings settings;
-    settings.beginGroup("theme");
-    QString family = settings.value("fontFamily").toString();
+    QString family = this->setting("theme/fontFamily").toString();
     foreach(const QString &key, this->textCharFormats->keys())
     {
         QTextCharFormat format(this->textCharFormats->value(key));
@@ -396,21 +493,18 @@ void ConfigManager::replaceDefaultFont()
         format.setFont(font);
         this->textCharFormats->insert(key,format);
     }
+    this->compileTheme();
 }
 
 void ConfigManager::setFontFamily(QString family)
 {
-    QSettings settings;
-    settings.beginGroup("theme");
-    settings.setValue("fontFamily",family);
+    this->setSetting("theme/fontFamily",family);
     this->replaceDefaultFont();
 }
 
 void ConfigManager::setPointSize(int size)
 {
-    QSettings settings;
-    settings.beginGroup("theme");
-    settings.setValue("pointSize",size);
+    this->setSetting("theme/pointSize",size);
     foreach(const QString &key, this->textCharFormats->keys())
     {
         QTextCharFormat format(this->textCharFormats->value(key));
@@ -419,6 +513,39 @@ void ConfigManager::setPointSize(int size)
         format.setFont(font);
         this->textCharFormats->insert(key,format);
     }
+    this->compileTheme();
+}
+
+int ConfigManager::formatId(const QString &key)
+{
+    QHash<QString, int>::const_iterator it = _formatIds.constFind(key);
+    if(it != _formatIds.constEnd())
+    {
+        return it.value();
+    }
+    int id = _formatKeys.size();
+    _formatIds.insert(key, id);
+    _formatKeys.append(key);
+    _themeFormats.append(ThemeFormat());
+    this->compileThemeFormat(id);
+    return id;
+}
+
+void ConfigManager::compileTheme()
+{
+    for(int id = 0; id < _formatKeys.size(); ++id)
+    {
+        this->compileThemeFormat(id);
+    }
+    ++_themeRevision;
+}
+
+void ConfigManager::compileThemeFormat(int id)
+{
+    ThemeFormat & themeFormat = _themeFormats[id];
+    themeFormat.format = this->getTextCharFormats(_formatKeys.at(id));
+    themeFormat.foreground = QPen(themeFormat.format.foreground().color());
+    themeFormat.background = QBrush(themeFormat.format.background().color());
 }
 
 
@@ -430,9 +557,7 @@ void ConfigManager::save()
     {
         dir.mkpath(dataPath);
     }
-    QSettings settings;
-    settings.beginGroup("theme");
-    QSettings file(themePath()+settings.value("theme").toString()+".texiteasy-theme",QSettings::IniFormat);
+    QSettings file(themePath()+this->setting("theme/theme").toString()+".texiteasy-theme",QSettings::IniFormat);
 
     QMapIterator<QString,QTextCharFormat> it(*this->textCharFormats);
     QString key;
@@ -453,15 +578,11 @@ bool ConfigManager::load(QString theme)
     QString dataPath = dataLocation();
     if(theme.isEmpty())
     {
-        QSettings settings;
-        settings.beginGroup("theme");
-        theme = settings.value("theme").toString();
+        theme = this->setting("theme/theme").toString();
     }
     else
     {
-        QSettings settings;
-        settings.beginGroup("theme");
-        settings.setValue("theme",theme);
+        this->setSetting("theme/theme",theme);
     }
     this->_theme = theme;
     QSettings file(themePath()+theme+".texiteasy-theme",QSettings::IniFormat);
@@ -473,11 +594,10 @@ bool ConfigManager::load(QString theme)
 
     QStringList keys = file.allKeys();
 
-    QSettings settings;
     DEBUG_THEME_PARSER(qDebug()<<"Style normal :");
     QTextCharFormat normal = this->stringToTextCharFormat(file.value("normal").toString());
     QFont normalFont = normal.font();
-    normalFont.setPointSize(settings.value("theme/pointSize").toInt());
+    normalFont.setPointSize(this->setting("theme/pointSize").toInt());
     normal.setFont(normalFont);
     this->textCharFormats->insert("normal", normal);
     foreach(const QString& key, keys)
@@ -492,14 +612,11 @@ bool ConfigManager::load(QString theme)
         this->textCharFormats->insert(key, val);
     }
 
+    if(this->setting("theme/replaceDefaultFont").toBool())
     {
-        QSettings settings;
-        settings.beginGroup("theme");
-        if(settings.value("replaceDefaultFont").toBool())
-        {
-            this->replaceDefaultFont();
-        }
+        this->replaceDefaultFont();
     }
+    this->compileTheme();
 
     return true;
 }
@@ -536,8 +653,7 @@ QStringList ConfigManager::userDictionnary(QString dico)
 
 QStringList ConfigManager::completionFiles()
 {
-     QSettings settings;
-     QStringList list = settings.value("completionFiles", ConfigManager::DefaultCompletionFiles).toStringList();
+     QStringList list = this->setting("completionFiles", ConfigManager::DefaultCompletionFiles).toStringList();
 
      QDir completionDir(customCompletionFolder());
      foreach(const QString& elem, completionDir.entryList(QDir::Files | QDir::Readable)) {
@@ -673,8 +789,7 @@ void ConfigManager::applyTranslation()
 }
 bool ConfigManager::isThisVersionHaveToBeReminded(QString version)
 {
-    QSettings settings;
-    if(settings.value("lastDetectedUpdate", CURRENT_VERSION).toString().compare(version))
+    if(this->setting("lastDetectedUpdate", CURRENT_VERSION).toString().compare(version))
     {
         return true;
     }
@@ -682,8 +797,7 @@ bool ConfigManager::isThisVersionHaveToBeReminded(QString version)
 }
 void ConfigManager::dontRemindMeThisVersion(QString version)
 {
-    QSettings settings;
-    settings.setValue("lastDetectedUpdate",version);
+    this->setSetting("lastDetectedUpdate",version);
 
 }
 
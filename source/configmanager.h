@@ -25,9 +25,15 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QPen>
+#include <QBrush>
 #include <QString>
 #include <QTextCharFormat>
 #include <QSettings>
+#include <QVariant>
+#include <QTimer>
 #include <QDebug>
 #include <QMutex>
 #include <QDesktopServices>
@@ -36,6 +42,37 @@
 
 class QWidget;
 
+/**
+ * @brief The ThemeFormat struct holds a theme entry with the pen and the brush the painters need,
+ * built once when the theme changes.
+ */
+struct ThemeFormat
+{
+    QTextCharFormat format;
+    QPen foreground;
+    QBrush background;
+};
+
+/**
+ * @brief The SettingsSnapshot struct holds the settings read while typing and painting as plain fields,
+ * refreshed by ConfigManager each time a setting changes.
+ */
+struct SettingsSnapshot
+{
+    SettingsSnapshot();
+    int tabWidth;
+    bool spaceIndentation;
+    QString tabString;
+    int pointSize;
+    bool dollarAuto;
+    bool lineWrapped;
+    bool doubleClickToGoToError;
+    bool completionFuzzy;
+    bool blockChangeMarkerEnable;
+    bool pdfSynchronized;
+    int pdfPrefetchPages;
+};
+
 class ConfigManager : public QObject
 {
     Q_OBJECT
@@ -52,8 +89,42 @@ public:
         return format;
     }
 
+    /**
+     * @brief NormalFormat is the id of the "normal" entry, always registered.
+     */
+    static const int NormalFormat = 0;
+    /**
+     * @brief formatId resolve a theme key to a small integer, to be done once, outside the hot paths.
+     * Unknown keys fall back to the "normal" entry, as getTextCharFormats does.
+     */
+    int formatId(const QString & key);
+    /**
+     * @brief themeFormat return the compiled entry of a formatId().
+     * The reference is valid until the next formatId() call that registers a new key.
+     */
+    const ThemeFormat & themeFormat(int id) const { return _themeFormats.at(id); }
+    const QTextCharFormat & textCharFormat(int id) const { return _themeFormats.at(id).format; }
+    const QPen & foregroundPen(int id) const { return _themeFormats.at(id).foreground; }
+    const QBrush & backgroundBrush(int id) const { return _themeFormats.at(id).background; }
+    /**
+     * @brief themeRevision is incremented each time the compiled theme is rebuilt,
+     * so that the formats derived from it can be cached.
+     */
+    int themeRevision() const { return _themeRevision; }
+
     ~ConfigManager();
 
+    /**
+     * @brief setting return the value of a key from the in-memory snapshot of the settings,
+     * loaded once at the end of init(). Before that it reads QSettings directly.
+     */
+    QVariant setting(const QString & key, const QVariant & defaultValue = QVariant()) const;
+    /**
+     * @brief setSetting update the snapshot and emit settingChanged(key).
+     * The value is written to the disk later by flushSettings(), together with the other pending changes.
+     */
+    void setSetting(const QString & key, const QVariant & value);
+
     QString settingsPath() const { return _settingsPath; }
 
     void setDevicePixelRatio(qreal ratio) { _devicePixelRatio = ratio; }
@@ -64,28 +135,20 @@ public:
     static const QStringList DefaultCompletionFiles;
 
 
-    int tabWidth() { QSettings settings; return settings.value("tabWidth", 4).toInt(); }
-    void setTabWidth(int tabW) { QSettings settings; settings.setValue("tabWidth", tabW); emit tabWidthChanged(); }
+    int tabWidth() { return _snapshot.tabWidth; }
+    void setTabWidth(int tabW) { this->setSetting("tabWidth", tabW); emit tabWidthChanged(); }
 
-    bool isUsingSpaceIndentation() { QSettings settings; return settings.value("spaceIndentation", true).toBool(); }
-    void setUsingSpaceIndentation(bool use) { QSettings settings; settings.setValue("spaceIndentation", use); }
-    QString tabToString()
-    {
-        QSettings settings;
-        if(settings.value("spaceIndentation", true).toBool())
-        {
-            return QString().fill(' ',settings.value("tabWidth", 4).toInt());
-        }
-        return QString("\t");
-    }
+    bool isUsingSpaceIndentation() { return _snapshot.spaceIndentation; }
+    void setUsingSpaceIndentation(bool use) { this->setSetting("spaceIndentation", use); }
+    const QString & tabToString() { return _snapshot.tabString; }
 
     bool darkTheme() { return 120 > this->getTextCharFormats().background().color().value(); }
 
     void changePointSizeBy(int delta);
     void setPointSize(int size);
     void setReplaceDefaultFont(bool replace);
-    bool isDefaultFontReplaced() { QSettings settings; return settings.value("theme/replaceDefaultFont").toBool(); }
-    int pointSize() { QSettings settings; return settings.value("theme/pointSize").toInt(); }
+    bool isDefaultFontReplaced() { return this->setting("theme/replaceDefaultFont").toBool(); }
+    int pointSize() { return _snapshot.pointSize; }
     void setFontFamily(QString family);
 
     void            setMainWindow(QWidget * mainWindow);
@@ -98,54 +161,47 @@ public:
 
     void            setOpenFilesWhenClosing(QStringList files, QStringList fileCursorPositions, int tabIndex)
     {
-        QSettings settings;
-        settings.setValue("openTabIndexWhenClosing", tabIndex);
-        settings.setValue("openFilesWhenClosing", files);
-        settings.setValue("openFileCursorPositionsWhenClosing", fileCursorPositions);
+        this->setSetting("openTabIndexWhenClosing", tabIndex);
+        this->setSetting("openFilesWhenClosing", files);
+        this->setSetting("openFileCursorPositionsWhenClosing", fileCursorPositions);
     }
     void            setOpenFilesWhenClosingPdfPosition(const QList<QVariant> & pdfPosition, const QList<QVariant> & pdfZoom)
     {
-        QSettings settings;
-        settings.setValue("openFilesWhenClosingPdfPosition", pdfPosition);
-        settings.setValue("openFilesWhenClosingPdfZoom", pdfZoom);
+        this->setSetting("openFilesWhenClosingPdfPosition", pdfPosition);
+        this->setSetting("openFilesWhenClosingPdfZoom", pdfZoom);
     }
     QList<QVariant>            openFilesWhenClosingPdfPosition()
     {
-        QSettings settings;
-        return settings.value("openFilesWhenClosingPdfPosition").toList();
+        return this->setting("openFilesWhenClosingPdfPosition").toList();
     }
 
     QList<QVariant>            openFilesWhenClosingPdfZoom()
     {
-        QSettings settings;
-        return settings.value("openFilesWhenClosingPdfZoom").toList();
+        return this->setting("openFilesWhenClosingPdfZoom").toList();
     }
 
 
     int     openTabIndexWhenClosing()
     {
-        QSettings settings;
-        return settings.value("openTabIndexWhenClosing", 0).toInt();
+        return this->setting("openTabIndexWhenClosing", 0).toInt();
     }
     QStringList     openFilesWhenClosing()
     {
-        QSettings settings;
-        return settings.value("openFilesWhenClosing").toStringList();
+        return this->setting("openFilesWhenClosing").toStringList();
     }
     QStringList     openFileCursorPositionsWhenClosing()
     {
-        QSettings settings;
-        return settings.value("openFileCursorPositionsWhenClosing").toStringList();
+        return this->setting("openFileCursorPositionsWhenClosing").toStringList();
     }
-    void            setOpenLastSessionAtStartup(bool open) { QSettings settings; settings.setValue("openLastSessionAtStartup", open); }
-    bool            openLastSessionAtStartup() { QSettings settings; return settings.value("openLastSessionAtStartup", true).toBool(); }
+    void            setOpenLastSessionAtStartup(bool open) { this->setSetting("openLastSessionAtStartup", open); }
+    bool            openLastSessionAtStartup() { return this->setting("openLastSessionAtStartup", true).toBool(); }
 
 
-    bool            isDollarAuto() {  QSettings settings; return settings.value("dollarAuto", true).toBool();  }
-    void            setDollarAuto(bool b) {  QSettings settings; settings.setValue("dollarAuto", b);  }
+    bool            isDollarAuto() {  return _snapshot.dollarAuto;  }
+    void            setDollarAuto(bool b) {  this->setSetting("dollarAuto", b);  }
 
-    bool            isLineWrapped() {  QSettings settings; return settings.value("lineWrapped", true).toBool();  }
-    void            setLineWrapped(bool b) {  QSettings settings; settings.setValue("lineWrapped", b);  }
+    bool            isLineWrapped() {  return _snapshot.lineWrapped;  }
+    void            setLineWrapped(bool b) {  this->setSetting("lineWrapped", b);  }
 
     QStringList     themesList();
     const QString&  theme() { return _theme; }
@@ -153,20 +209,19 @@ public:
 
 
     QStringList     languagesList();
-    QString         language()                      { QSettings settings; return settings.value("language").toString(); }
-    void            setLanguage(QString language)   { QSettings settings; settings.setValue("language", language); applyTranslation(); }
+    QString         language()                      { return this->setting("language").toString(); }
+    void            setLanguage(QString language)   { this->setSetting("language", language); applyTranslation(); }
     void            applyTranslation();
 
-    bool            doubleClickToGoToError() { QSettings settings; return settings.value("doubleClickToGoToError", false).toBool(); }
-    void            setDoubleClickToGoToError(bool d) { QSettings settings; return settings.setValue("doubleClickToGoToError", d); }
+    bool            doubleClickToGoToError() { return _snapshot.doubleClickToGoToError; }
+    void            setDoubleClickToGoToError(bool d) { this->setSetting("doubleClickToGoToError", d); }
 
     QStringList     dictionnaries();
-    void            setDictionary(QString dico )    { QSettings settings; settings.setValue("defaultDictionary", dico); }
+    void            setDictionary(QString dico )    { this->setSetting("defaultDictionary", dico); }
     QString         currentDictionaryFilename()     { return dictionaryPath()+currentDictionary(); }
     QString         currentDictionary()
     {
-        QSettings settings;
-        QString dico = settings.value("defaultDictionary").toString();
+        QString dico = this->setting("defaultDictionary").toString();
         if(dictionnaries().contains(dico))
         {
             return dico;
@@ -188,64 +243,75 @@ public:
     void checkRevision();
     void recursiveCopy(QString from, QString to, QFile::Permissions permission);
 
-    bool hideAuxFiles() { QSettings settings; return settings.value("builder/hideAuxFiles", true).toBool(); }
-    void setHideAuxFiles(bool hide) { QSettings settings; settings.setValue("builder/hideAuxFiles", hide); }
+    bool hideAuxFiles() { return this->setting("builder/hideAuxFiles", true).toBool(); }
+    void setHideAuxFiles(bool hide) { this->setSetting("builder/hideAuxFiles", hide); }
+    /**
+     * @brief isIncrementalBuild return true if the build skips the passes whose inputs have not changed
+     */
+    bool isIncrementalBuild() { return this->setting("builder/incrementalBuild", true).toBool(); }
+    void setIncrementalBuild(bool incremental) { this->setSetting("builder/incrementalBuild", incremental); }
 
     QString customCompletionFolder();
     QStringList completionFiles();
-    void setCompletionFiles(QStringList completionFiles) { QSettings settings; settings.setValue("completionFiles", completionFiles); }
+    void setCompletionFiles(QStringList completionFiles) { this->setSetting("completionFiles", completionFiles); }
+    bool isCompletionFuzzy() { return _snapshot.completionFuzzy; }
+    void setCompletionFuzzy(bool fuzzy) { this->setSetting("completionFuzzy", fuzzy); }
 
 
     QStringList latexCommandNames()
-                {  QSettings settings; return settings.value("builder/latexCommandNames").toStringList();  }
+                {  return this->setting("builder/latexCommandNames").toStringList();  }
     void        setLatexCommandNames(QStringList list)
-                {  QSettings settings; settings.setValue("builder/latexCommandNames", list);  }
+                {  this->setSetting("builder/latexCommandNames", list);  }
     QStringList latexCommands()
-                {  QSettings settings; return settings.value("builder/latexCommands").toStringList();  }
+                {  return this->setting("builder/latexCommands").toStringList();  }
     void    setLatexCommands(QStringList list)
-                {  QSettings settings; settings.setValue("builder/latexCommands", list);  }
+                {  this->setSetting("builder/latexCommands", list);  }
 
-    void    setDefaultLatex(QString name) {  QSettings settings; settings.setValue("builder/defaultLatex", name);  }
-    QString defaultLatex() {  QSettings settings; return settings.value("builder/defaultLatex").toString();  }
+    void    setDefaultLatex(QString name) {  this->setSetting("builder/defaultLatex", name);  }
+    QString defaultLatex() {  return this->setting("builder/defaultLatex").toString();  }
     QString latexCommand(QString name = QString::null);
 
 
-    QString bibtexCommand(bool fullPath = false) { QSettings settings; return (fullPath ? settings.value("builder/latexPath").toString()+"/" : QString(""))+settings.value("builder/bibtex").toString(); }
-    QString pdflatexCommand(bool fullPath = false) { QSettings settings; return (fullPath ? settings.value("builder/latexPath").toString() : QString(""))+settings.value("builder/pdflatex").toString(); }
-    QString latexPath() { QSettings settings; return settings.value("builder/latexPath").toString(); }
-    QString svnPath() { QSettings settings; return settings.value("svn/path", "").toString(); }
+    QString bibtexCommand(bool fullPath = false) { return (fullPath ? this->setting("builder/latexPath").toString()+"/" : QString(""))+this->setting("builder/bibtex").toString(); }
+    QString pdflatexCommand(bool fullPath = false) { return (fullPath ? this->setting("builder/latexPath").toString() : QString(""))+this->setting("builder/pdflatex").toString(); }
+    QString latexPath() { return this->setting("builder/latexPath").toString(); }
+    QString svnPath() { return this->setting("svn/path", "").toString(); }
     QString applicationPath() { return _applicationPath; }
 
-    QString commandDatabaseFilename() { QSettings settings; return settings.value("commandDatabaseFilename").toString(); }
+    QString commandDatabaseFilename() { return this->setting("commandDatabaseFilename").toString(); }
 
-    void setBibtexCommand(QString command) { QSettings settings; settings.setValue("builder/bibtex", command); }
-    void setPdflatexCommand(QString command) { QSettings settings; settings.setValue("builder/pdflatex", command); }
-    void setLatexPath(QString path) { QSettings settings; settings.setValue("builder/latexPath", path); }
-    void setSvnPath(QString path) { QSettings settings; settings.setValue("svn/path", path); }
-    void setSvnEnable(bool enable) { QSettings settings; settings.setValue("svn/enable", enable); }
-    bool isSvnEnable() { QSettings settings; return settings.value("svn/enable", true).toBool(); }
-    void setBlockChangeMarkerEnable(bool enable) { QSettings settings; return settings.setValue("blockChangeMarkerEnable", enable); }
-    bool isBlockChangeMarkerEnable() { QSettings settings; return settings.value("blockChangeMarkerEnable", true).toBool(); }
+    void setBibtexCommand(QString command) { this->setSetting("builder/bibtex", command); }
+    void setPdflatexCommand(QString command) { this->setSetting("builder/pdflatex", command); }
+    void setLatexPath(QString path) { this->setSetting("builder/latexPath", path); }
+    void setSvnPath(QString path) { this->setSetting("svn/path", path); }
+    void setSvnEnable(bool enable) { this->setSetting("svn/enable", enable); }
+    bool isSvnEnable() { return this->setting("svn/enable", true).toBool(); }
+    void setBlockChangeMarkerEnable(bool enable) { this->setSetting("blockChangeMarkerEnable", enable); }
+    bool isBlockChangeMarkerEnable() { return _snapshot.blockChangeMarkerEnable; }
 
-    bool isPdfSynchronized() { QSettings settings; return settings.value("pdfSynchronized", true).toBool(); }
+    bool isPdfSynchronized() { return _snapshot.pdfSynchronized; }
 
-    bool pdfViewerInItsOwnWidget() { QSettings settings; return settings.value("pdfViewerItsOwnWidget", false).toBool(); }
+    bool pdfViewerInItsOwnWidget() { return this->setting("pdfViewerItsOwnWidget", false).toBool(); }
+    int pdfPrefetchPages() { return _snapshot.pdfPrefetchPages; }
+    int pdfCacheSize() { return this->setting("pdfCacheSize", 256).toInt(); }
+    bool isPdfCacheDownscaling() { return this->setting("pdfCacheDownscaling", true).toBool(); }
 
-    bool splitEditor() { QSettings settings; return settings.value("splitEditor", false).toBool(); }
+    bool splitEditor() { return this->setting("splitEditor", false).toBool(); }
 
     bool isThisVersionHaveToBeReminded(QString version);
     void dontRemindMeThisVersion(QString version);
 
-    QString lastFolder() { QSettings settings; return settings.value("lastFolder").toString(); }
+    QString lastFolder() { return this->setting("lastFolder").toString(); }
+    void setLastFolder(QString folder) { this->setSetting("lastFolder", folder); }
 
 
     QString         macrosPath();
 
-    QString softId() { QSettings settings; return settings.value("softId").toString(); }
+    QString softId() { return this->setting("softId").toString(); }
     QString systemInfo();
 
-    int autoSaveDuration() { QSettings settings; return settings.value("autoSaveDuration", 40000).toInt(); }
-    void setAutoSaveDuration(int duration) { QSettings settings; return settings.setValue("autoSaveDuration", duration); }
+    int autoSaveDuration() { return this->setting("autoSaveDuration", 40000).toInt(); }
+    void setAutoSaveDuration(int duration) { this->setSetting("autoSaveDuration", duration); }
 
     static QString Extensions;
     static QString MacroSuffix;
@@ -264,14 +330,22 @@ public slots:
      */
     void signalVersionIsOutdated() { emit versionIsOutdated(); }
 
-    void setPdfSynchronized(bool pdfSynchronized) { QSettings settings; settings.setValue("pdfSynchronized", pdfSynchronized); }
-    void setPdfViewerInItsOwnWidget(bool b) { QSettings settings; settings.setValue("pdfViewerItsOwnWidget", b); }
-    void setSplitEditor(bool split) { QSettings settings; settings.setValue("splitEditor", split); }
+    void setPdfSynchronized(bool pdfSynchronized) { this->setSetting("pdfSynchronized", pdfSynchronized); }
+    void setPdfViewerInItsOwnWidget(bool b) { this->setSetting("pdfViewerItsOwnWidget", b); }
+    void setPdfPrefetchPages(int pages) { this->setSetting("pdfPrefetchPages", pages); }
+    void setPdfCacheSize(int megabytes) { this->setSetting("pdfCacheSize", megabytes); }
+    void setPdfCacheDownscaling(bool downscale) { this->setSetting("pdfCacheDownscaling", downscale); }
+    void setSplitEditor(bool split) { this->setSetting("splitEditor", split); }
     void openThemeFolder();
     void openUpdateWebsite() { QString link = TEXITEASY_UPDATE_WEBSITE;
                                QDesktopServices::openUrl(QUrl(link)); }
 
     void sendChangedSignal() { emit changed(); }
+    /**
+     * @brief flushSettings write the pending changes of the snapshot to the disk.
+     * Called by the write-behind timer and when the application quits.
+     */
+    void flushSettings();
 signals:
 
     /**
@@ -281,10 +355,18 @@ signals:
     void versionIsOutdated();
     void changed();
     void tabWidthChanged();
+    /**
+     * @brief settingChanged is emitted by setSetting() as soon as the snapshot is updated
+     */
+    void settingChanged(const QString & key);
 private:
     void checkLatexExecutable();
     void resetThemes();
     void replaceDefaultFont();
+    void compileTheme();
+    void compileThemeFormat(int id);
+    void loadSettings();
+    void updateSnapshot();
     ConfigManager();
 
     qreal _devicePixelRatio;
@@ -292,6 +374,15 @@ private:
     QMutex _charFormatMutex;
     QWidget * mainWindow;
     QMap<QString,QTextCharFormat> * textCharFormats;
+    QHash<QString, int> _formatIds;
+    QStringList _formatKeys;
+    QVector<ThemeFormat> _themeFormats;
+    int _themeRevision;
+    bool _settingsLoaded;
+    QHash<QString, QVariant> _settings;
+    QHash<QString, QVariant> _pendingSettings;
+    QTimer _flushTimer;
+    SettingsSnapshot _snapshot;
     QString _theme;
     QString _pdflatexExe;
     QString _settingsPath;
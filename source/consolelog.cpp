@@ -0,0 +1,136 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "consolelog.h"
+
+/**
+ * @brief ERROR_CONTEXT_LINES and MESSAGE_CONTEXT_LINES are the maximum number of lines shown after the first line
+ * of an error (TeX prints the context and the line number), of a warning or a bad box
+ */
+#define ERROR_CONTEXT_LINES 10
+#define MESSAGE_CONTEXT_LINES 4
+
+ConsoleLog::ConsoleLog() :
+    _maximumLineLength(0),
+    _filter(AllLines),
+    _filteredLinesDirty(true)
+{
+}
+
+void ConsoleLog::clear()
+{
+    _text.clear();
+    _lineStarts.clear();
+    _entries.clear();
+    _maximumLineLength = 0;
+    _filteredLines.clear();
+    _filteredLinesDirty = true;
+}
+
+void ConsoleLog::append(const QString &text)
+{
+    if(text.isEmpty())
+    {
+        return;
+    }
+    int offset = _text.length();
+    _text.append(text);
+    if(_lineStarts.isEmpty())
+    {
+        _lineStarts.append(0);
+    }
+    // the last line continues with the new text
+    int firstModifiedLine = _lineStarts.count() - 1;
+    int position = offset;
+    while((position = _text.indexOf('\n', position)) != -1)
+    {
+        ++position;
+        _lineStarts.append(position);
+    }
+    for(int index = firstModifiedLine; index < _lineStarts.count(); ++index)
+    {
+        _maximumLineLength = qMax(_maximumLineLength, this->lineEnd(index) - _lineStarts.at(index));
+    }
+    _filteredLinesDirty = true;
+}
+
+void ConsoleLog::addEntry(int line, LogType type)
+{
+    if(line < 0)
+    {
+        return;
+    }
+    _entries.insert(line, type);
+    _filteredLinesDirty = true;
+}
+
+int ConsoleLog::lineEnd(int index) const
+{
+    return index + 1 < _lineStarts.count() ? _lineStarts.at(index + 1) - 1 : _text.length();
+}
+
+QString ConsoleLog::line(int index) const
+{
+    int start = _lineStarts.at(index);
+    int end = this->lineEnd(index);
+    if(end > start && _text.at(end - 1) == QChar('\r'))
+    {
+        --end;
+    }
+    return _text.mid(start, end - start);
+}
+
+const QVector<int> &ConsoleLog::filteredLines(ConsoleLog::Filter filter)
+{
+    if(filter == _filter && !_filteredLinesDirty)
+    {
+        return _filteredLines;
+    }
+    _filter = filter;
+    _filteredLinesDirty = false;
+    _filteredLines.clear();
+    LogType type = filter == Errors ? LT_ERROR : filter == Warnings ? LT_WARNING : LT_BADBOX;
+    QMap<int, LogType>::const_iterator it;
+    for(it = _entries.constBegin(); it != _entries.constEnd(); ++it)
+    {
+        if(filter == AllLines || it.value() != type)
+        {
+            continue;
+        }
+        QMap<int, LogType>::const_iterator next = it + 1;
+        int last = it.key() + (type == LT_ERROR ? ERROR_CONTEXT_LINES : MESSAGE_CONTEXT_LINES);
+        if(next != _entries.constEnd())
+        {
+            last = qMin(last, next.key() - 1);
+        }
+        last = qMin(last, _lineStarts.count() - 1);
+        for(int index = it.key(); index <= last; ++index)
+        {
+            // the message ends at the first empty line
+            if(index > it.key() && this->line(index).isEmpty())
+            {
+                break;
+            }
+            _filteredLines.append(index);
+        }
+    }
+    return _filteredLines;
+}
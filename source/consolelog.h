@@ -0,0 +1,85 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef CONSOLELOG_H
+#define CONSOLELOG_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include "latexoutputfilter.h"
+
+/**
+ * @brief The ConsoleLog class holds the output of a build, appended chunk by chunk,
+ * with the offset of each line so that any line is read without splitting the text.
+ *
+ * The entries found by the log parser mark their first line. A filter gives the indices
+ * of the lines of its entries (the first line and the following lines of the message),
+ * the text itself is never copied.
+ */
+class ConsoleLog
+{
+public:
+    enum Filter { AllLines, Errors, Warnings, BadBoxes };
+
+    ConsoleLog();
+
+    void clear();
+    /**
+     * @brief append add the text at the end, the last line may be continued by the next chunk
+     */
+    void append(const QString & text);
+    /**
+     * @brief addEntry mark the line where an error, a warning or a bad box begins
+     */
+    void addEntry(int line, LogType type);
+
+    int lineCount() const { return _lineStarts.count(); }
+    QString line(int index) const;
+    /**
+     * @brief lineType return the type of the entry beginning at the line, LT_NONE if there is none
+     */
+    LogType lineType(int index) const { return _entries.value(index, LT_NONE); }
+    /**
+     * @brief maximumLineLength return the number of characters of the longest line
+     */
+    int maximumLineLength() const { return _maximumLineLength; }
+    /**
+     * @brief filteredLines return the indices of the lines shown by the filter (not used for AllLines)
+     */
+    const QVector<int> & filteredLines(Filter filter);
+
+private:
+    /**
+     * @brief lineEnd return the offset of the end of the line, before its new line character
+     */
+    int lineEnd(int index) const;
+
+    QString _text;
+    QVector<int> _lineStarts;
+    QMap<int, LogType> _entries;
+    int _maximumLineLength;
+    Filter _filter;
+    QVector<int> _filteredLines;
+    bool _filteredLinesDirty;
+};
+
+#endif // CONSOLELOG_H
@@ -136,6 +136,7 @@ void DialogConfig::save()
 
 
     ConfigManager::Instance.setHideAuxFiles(this->ui->checkBoxHideAuxFiles->isChecked());
+    ConfigManager::Instance.setIncrementalBuild(this->ui->checkBoxIncrementalBuild->isChecked());
 
     ConfigManager::Instance.setBibtexCommand(this->ui->lineEdit_bibtex->text());
     //ConfigManager::Instance.setPdflatexCommand(this->ui->lineEdit_pdflatex->text());
@@ -233,6 +234,7 @@ void DialogConfig::show()
     // Page Builder:
 
     this->ui->checkBoxHideAuxFiles->setChecked(ConfigManager::Instance.hideAuxFiles());
+    this->ui->checkBoxIncrementalBuild->setChecked(ConfigManager::Instance.isIncrementalBuild());
 
     currentLatexName = ConfigManager::Instance.defaultLatex();
     this->ui->lineEdit_bibtex->setText(ConfigManager::Instance.bibtexCommand());
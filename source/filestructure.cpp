@@ -28,7 +28,12 @@
 
 
 TextStruct::TextStruct(WidgetTextEdit * parent) :
-    _widgetTextEdit(parent)
+    _widgetTextEdit(parent),
+    _dirty(true),
+    _renamed(false),
+    _blockCount(0),
+    _highlightedBlockCount(0),
+    _reloadedBlockCount(0)
 {
     _documentItem = 0;
 }
@@ -49,9 +54,116 @@ void TextStruct::clear()
     clear(&_sectionRoot);
 }
 
+void TextStruct::invalidate()
+{
+    _dirty = true;
+}
+
+void TextStruct::invalidateNames()
+{
+    _renamed = true;
+}
+
+void TextStruct::onHighlightedBlockCountChanged(int blockCount)
+{
+    _highlightedBlockCount = blockCount;
+    if(blockCount > _reloadedBlockCount)
+    {
+        _dirty = true;
+    }
+}
+
+void TextStruct::refresh() const
+{
+    if(_dirty)
+    {
+        const_cast<TextStruct *>(this)->reload();
+    }
+    else if(_renamed)
+    {
+        TextStruct * self = const_cast<TextStruct *>(this);
+        self->_renamed = false;
+        self->updateNames(&self->_environementRoot);
+        self->updateNames(&self->_sectionRoot);
+    }
+}
+
+void TextStruct::updateNames(StructItem *item)
+{
+    foreach(StructItem * child, item->children)
+    {
+        QTextBlock block = _widgetTextEdit->document()->findBlockByNumber(child->blockBeginNumber);
+        BlockData * data = block.isValid() ? static_cast<BlockData *>(block.userData()) : 0;
+        if(data)
+        {
+            foreach(const LatexBlockInfo & blockInfo, data->latexblocks())
+            {
+                // the begin of the items is computed as in reload()
+                if((child->type == StructItem::ENVIRONMENT && blockInfo.type == LatexBlockInfo::ENVIRONEMENT_BEGIN
+                        && blockInfo.position + block.position() == child->begin)
+                        || (child->type == StructItem::SECTION && blockInfo.type == LatexBlockInfo::SECTION
+                        && blockInfo.position + block.position() - 1 == child->begin))
+                {
+                    child->name = blockInfo.name;
+                    break;
+                }
+            }
+        }
+        updateNames(child);
+    }
+}
+
+void TextStruct::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    int blockCount = _widgetTextEdit->document()->blockCount();
+    int blockDelta = blockCount - _blockCount;
+    _blockCount = blockCount;
+    if(_dirty)
+    {
+        return;
+    }
+    // an item whose delimiter is inside the modified text cannot be moved, it is rebuilt
+    if(!shift(&_environementRoot, position, charsRemoved, charsAdded, blockDelta)
+            || !shift(&_sectionRoot, position, charsRemoved, charsAdded, blockDelta))
+    {
+        _dirty = true;
+    }
+}
+
+bool TextStruct::shift(StructItem *item, int position, int charsRemoved, int charsAdded, int blockDelta)
+{
+    foreach(StructItem * child, item->children)
+    {
+        if((child->begin >= position && child->begin < position + charsRemoved)
+                || (child->end >= position && child->end < position + charsRemoved))
+        {
+            return false;
+        }
+        if(child->begin >= position + charsRemoved)
+        {
+            child->begin += charsAdded - charsRemoved;
+            child->blockBeginNumber += blockDelta;
+        }
+        if(child->end >= position + charsRemoved)
+        {
+            child->end += charsAdded - charsRemoved;
+            child->blockEndNumber += blockDelta;
+        }
+        if(!shift(child, position, charsRemoved, charsAdded, blockDelta))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void TextStruct::reload()
 {
     clear();
+    _dirty = false;
+    _renamed = false;
+    _blockCount = _widgetTextEdit->document()->blockCount();
+    _reloadedBlockCount = _highlightedBlockCount;
     QTextBlock block = _widgetTextEdit->document()->begin();
     //QStack<StructItem*> structItemsStack;
 
@@ -77,19 +189,19 @@ void TextStruct::reload()
             block = block.next();
             continue;
         }
-        foreach(LatexBlockInfo* blockInfo, data->latexblocks())
+        foreach(const LatexBlockInfo &blockInfo, data->latexblocks())
         {
-            switch(blockInfo->type)
+            switch(blockInfo.type)
             {
             case LatexBlockInfo::ENVIRONEMENT_BEGIN:
             {
-                //qDebug()<<"ENVIRONEMENT_BEGIN : "<<blockInfo->name<<" "<<block.blockNumber();
+                //qDebug()<<"ENVIRONEMENT_BEGIN : "<<blockInfo.name<<" "<<block.blockNumber();
                 StructItem * item = new StructItem();
                 item->type   = StructItem::ENVIRONMENT;
                 item->parent = currentEnvironmentItem;
-                item->name   = blockInfo->name;
+                item->name   = blockInfo.name;
                 item->level  = currentEnvironmentItem->level + 1;
-                item->begin  = item->end  = blockInfo->position + block.position();
+                item->begin  = item->end  = blockInfo.position + block.position();
                 item->blockBeginNumber  = item->blockEndNumber  = block.blockNumber();
                 currentEnvironmentItem->children.append(item);
                 currentEnvironmentItem = item;
@@ -100,23 +212,23 @@ void TextStruct::reload()
                 {
                     break;
                 }
-                while(currentEnvironmentItem->name.compare(blockInfo->name) && currentEnvironmentItem->parent)
+                while(currentEnvironmentItem->name.compare(blockInfo.name) && currentEnvironmentItem->parent)
                 {
-                    //qDebug()<<"ENVIRONEMENT_END : "<<blockInfo->name<<"  current:"<<currentEnvironmentItem->name;
+                    //qDebug()<<"ENVIRONEMENT_END : "<<blockInfo.name<<"  current:"<<currentEnvironmentItem->name;
 
 
                     /*if()
                     {
-                        //qDebug()<<"Warning: Parsing Document Structur. Environment "<<currentEnvironmentItem->name<<" (l."<<currentEnvironmentItem->blockBeginNumber<<") ends with "<<blockInfo->name<<" (l."<<blockInfo->blockNumber<<")";
+                        //qDebug()<<"Warning: Parsing Document Structur. Environment "<<currentEnvironmentItem->name<<" (l."<<currentEnvironmentItem->blockBeginNumber<<") ends with "<<blockInfo.name<<" (l."<<blockInfo.blockNumber<<")";
                         return;
                     }*/
-                    currentEnvironmentItem->end   = blockInfo->position + block.position();
+                    currentEnvironmentItem->end   = blockInfo.position + block.position();
                     currentEnvironmentItem->blockEndNumber  = block.blockNumber();
                     currentEnvironmentItem = currentEnvironmentItem->parent;
                     //qDebug()<<" change current: "<<currentEnvironmentItem->name;
                 }
 
-                currentEnvironmentItem->end   = blockInfo->position + block.position();
+                currentEnvironmentItem->end   = blockInfo.position + block.position();
                 currentEnvironmentItem->blockEndNumber  = block.blockNumber();
                 if(currentEnvironmentItem->name == "document")
                 {
@@ -129,21 +241,21 @@ void TextStruct::reload()
                 break;
             case LatexBlockInfo::SECTION:
                 //close previous sections
-                while(blockInfo->sectionLevel <= currentSectionItem->level && currentSectionItem->parent)
+                while(blockInfo.sectionLevel <= currentSectionItem->level && currentSectionItem->parent)
                 {
-                    currentSectionItem->end   = blockInfo->position + block.position();
+                    currentSectionItem->end   = blockInfo.position + block.position();
                     currentSectionItem->blockEndNumber  = block.blockNumber()-1;
                     currentSectionItem = currentSectionItem->parent;
                 }
                 //creacte new section
                 {
-                    //qDebug()<<"SECTION : "<<blockInfo->name;
+                    //qDebug()<<"SECTION : "<<blockInfo.name;
                     StructItem * item = new StructItem();
                     item->type   = StructItem::SECTION;
                     item->parent = currentSectionItem;
-                    item->name   = blockInfo->name;
-                    item->level  = blockInfo->sectionLevel;
-                    item->begin  = blockInfo->position + block.position() - 1;
+                    item->name   = blockInfo.name;
+                    item->level  = blockInfo.sectionLevel;
+                    item->begin  = blockInfo.position + block.position() - 1;
                     item->end = _widgetTextEdit->document()->lastBlock().position() + _widgetTextEdit->document()->lastBlock().length();
                     item->blockBeginNumber  = block.blockNumber();
                     item->blockEndNumber  = _widgetTextEdit->document()->blockCount();
@@ -176,40 +288,55 @@ QString TextStruct::currentEnvironment() const
     return environmentPath().last()->name;
 }
 
+const StructItem * TextStruct::childAt(const StructItem *item, int position)
+{
+    // the children are sorted and do not overlap, so the only candidate
+    // is the last child that begins before the position
+    int lower = 0;
+    int upper = item->children.count();
+    while(lower < upper)
+    {
+        int middle = (lower + upper) / 2;
+        if(item->children.at(middle)->begin < position)
+        {
+            lower = middle + 1;
+        }
+        else
+        {
+            upper = middle;
+        }
+    }
+    if(lower == 0)
+    {
+        return 0;
+    }
+    const StructItem * child = item->children.at(lower - 1);
+    return child->end > position ? child : 0;
+}
+
 QStack<const StructItem*> TextStruct::environmentPath(int position) const
 {
+    refresh();
     QStack<const StructItem*> path;
     const StructItem * currentItem = &_environementRoot;
     path.append(currentItem);
 
-    while(currentItem->children.count())
+    while((currentItem = childAt(currentItem, position)))
     {
-        bool isInAChild = false;
-        foreach(const StructItem * child, currentItem->children)
-        {
-            if(child->begin < position && child->end > position)
-            {
-                path << child;
-                currentItem = child;
-                isInAChild = true;
-                break;
-            }
-        }
-        if(!isInAChild)
-        {
-            break;
-        }
+        path << currentItem;
     }
     return path;
 }
 
 const StructItem* TextStruct::documentItem() const
 {
+    refresh();
     return _documentItem;
 }
 
 QStringList TextStruct::sectionsList(QString fill) const
 {
+    refresh();
     QStringList list;
     sectionsList(&list, &_sectionRoot, 0, fill);
     return list;
@@ -232,27 +359,14 @@ void TextStruct::sectionsList(QStringList * list, const StructItem * item, int l
 
 QString TextStruct::currentSection() const
 {
+    refresh();
     int position = _widgetTextEdit->textCursor().position();
 
     const StructItem * currentItem = &_sectionRoot;
     QString lastSectionFound("");
-    while(currentItem->children.count())
+    while((currentItem = childAt(currentItem, position)))
     {
-        bool isInAChild = false;
-        foreach(const StructItem * child, currentItem->children)
-        {
-            if(child->begin < position && child->end > position)
-            {
-                lastSectionFound = child->name;
-                currentItem = child;
-                isInAChild = true;
-                break;
-            }
-        }
-        if(!isInAChild)
-        {
-            break;
-        }
+        lastSectionFound = currentItem->name;
     }
     return lastSectionFound;
 
@@ -260,6 +374,7 @@ QString TextStruct::currentSection() const
 
 int TextStruct::sectionNameToLine(QString sectionName) const
 {
+    refresh();
     int line = -1;
 
     const StructItem * currentItem = &_sectionRoot;
@@ -315,9 +430,13 @@ void TextStruct::debug(StructItem * item, int level)
 
 
 FileStructure::FileStructure(WidgetTextEdit *parent) :
-    blockIndentations(new BlockIndentation[0]),
     structureInfo(new QList<FileStructureInfo*>()),
-    widgetTextEdit(parent)
+    widgetTextEdit(parent),
+    _dirty(true),
+    _renamed(false),
+    _blockCount(0),
+    _highlightedBlockCount(0),
+    _reloadedBlockCount(0)
 {
 
 }
@@ -326,11 +445,149 @@ FileStructure::~FileStructure()
 #ifdef DEBUG_DESTRUCTOR
     qDebug()<<"delete FileStructure";
 #endif
-    delete this->blockIndentations;
+    foreach(FileStructureInfo * in,*this->structureInfo)
+    {
+        delete in;
+    }
     structureInfo->clear();
     delete structureInfo;
 }
 
+QList<FileStructureInfo*> * FileStructure::info()
+{
+    if(_dirty)
+    {
+        updateStructure();
+    }
+    else if(_renamed)
+    {
+        updateNames();
+    }
+    return this->structureInfo;
+}
+
+BlockIndentation FileStructure::indentation(int blockNumber)
+{
+    if(_dirty)
+    {
+        updateStructure();
+    }
+    // the sections are sorted by startBlock: find the last one starting before blockNumber
+    int lower = 0;
+    int upper = this->structureInfo->count();
+    while(lower < upper)
+    {
+        int middle = (lower + upper) / 2;
+        if(this->structureInfo->at(middle)->startBlock <= blockNumber)
+        {
+            lower = middle + 1;
+        }
+        else
+        {
+            upper = middle;
+        }
+    }
+    BlockIndentation indentation;
+    indentation.level = lower ? this->structureInfo->at(lower - 1)->level : 0;
+    indentation.next = lower < this->structureInfo->count() ? this->structureInfo->at(lower)->startBlock : _blockCount;
+    return indentation;
+}
+
+void FileStructure::invalidate()
+{
+    _dirty = true;
+}
+
+void FileStructure::invalidateNames()
+{
+    _renamed = true;
+}
+
+/**
+ * @brief sectionLevel return the level of the outline entry of the block (0 if there is none) and set its name
+ */
+static int sectionLevel(const BlockData * data, QString * name)
+{
+    foreach(const LatexBlockInfo & blockInfo, data->latexblocks())
+    {
+        if(blockInfo.type == LatexBlockInfo::SECTION
+                && blockInfo.sectionLevel >= LatexBlockInfo::LEVEL_SECTION
+                && blockInfo.sectionLevel <= LatexBlockInfo::LEVEL_SUBSUBSECTION)
+        {
+            *name = blockInfo.name;
+            return blockInfo.sectionLevel - LatexBlockInfo::LEVEL_SECTION + 1;
+        }
+        if(blockInfo.type == LatexBlockInfo::ENVIRONEMENT_BEGIN && blockInfo.name == "thebibliography")
+        {
+            *name = "Bibliography";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void FileStructure::updateNames()
+{
+    _renamed = false;
+    foreach(FileStructureInfo * in, *this->structureInfo)
+    {
+        QTextBlock textBlock = this->widgetTextEdit->document()->findBlockByNumber(in->startBlock);
+        BlockData * data = textBlock.isValid() ? static_cast<BlockData*>(textBlock.userData()) : 0;
+        QString name;
+        if(!data || sectionLevel(data, &name) != in->level)
+        {
+            updateStructure();
+            return;
+        }
+        in->name = name;
+    }
+}
+
+void FileStructure::onHighlightedBlockCountChanged(int blockCount)
+{
+    _highlightedBlockCount = blockCount;
+    if(blockCount > _reloadedBlockCount)
+    {
+        _dirty = true;
+    }
+}
+
+void FileStructure::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    int blockCount = this->widgetTextEdit->document()->blockCount();
+    int blockDelta = blockCount - _blockCount;
+    _blockCount = blockCount;
+    if(_dirty || !blockDelta)
+    {
+        return;
+    }
+    if(charsRemoved && charsAdded)
+    {
+        // lines are both removed and added: the removed blocks are unknown
+        _dirty = true;
+        return;
+    }
+    // the sections of the modified block are checked by the highlighter (see SyntaxHighlighter::structureChanged),
+    // the ones after it only move, unless their block has been removed
+    int modifiedBlock = this->widgetTextEdit->document()->findBlock(position).blockNumber();
+    foreach(FileStructureInfo * in, *this->structureInfo)
+    {
+        if(blockDelta < 0 && in->startBlock > modifiedBlock && in->startBlock <= modifiedBlock - blockDelta)
+        {
+            _dirty = true;
+            return;
+        }
+        if(in->startBlock > modifiedBlock)
+        {
+            in->startBlock += blockDelta;
+        }
+        if(in->endBlock >= modifiedBlock)
+        {
+            in->endBlock += blockDelta;
+        }
+    }
+}
+
 void FileStructure::updateStructure()
 {
     // clean memory
@@ -339,103 +596,42 @@ void FileStructure::updateStructure()
         delete in;
     }
     this->structureInfo->clear();
-    delete this->blockIndentations;
-    this->blockIndentations = new BlockIndentation[this->widgetTextEdit->document()->blockCount()];
+    _dirty = false;
+    _renamed = false;
+    _blockCount = this->widgetTextEdit->document()->blockCount();
+    _reloadedBlockCount = _highlightedBlockCount;
 
-    int textBlockIndex = 0;
-    FileStructureInfo * stru;
+    // the sections are read from the records of the highlighter, so this is a single pass without any parsing
     int lastLevel[3];
     lastLevel[0] = lastLevel[1] = lastLevel[2] = -1;
-    int level = 0;
-    int lastBlock=0;
-    QTextBlock textBlock = this->widgetTextEdit->document()->begin();
-    bool first = true;
-    do{
-
-        if(textBlock.text().indexOf(QRegExp("\\\\(sub){0,2}section\\{[^\\}]*\\}"), 0) != -1 ||
-                textBlock.text().indexOf(QRegExp("\\\\begin\\{thebibliography\\}"), 0) != -1)
+    for(QTextBlock textBlock = this->widgetTextEdit->document()->begin(); textBlock.isValid(); textBlock = textBlock.next())
+    {
+        BlockData * data = static_cast<BlockData*>(textBlock.userData());
+        if(!data || data->latexblocks().isEmpty())
         {
-            for(int i = lastBlock; i < textBlockIndex; ++i)
-            {
-                this->blockIndentations[i].level = level;
-                this->blockIndentations[i].next = textBlockIndex;
-            }
-            level = textBlock.text().indexOf(QRegExp("\\\\subsubsection\\{[^\\}]*\\}"), 0) != -1 ? 3 : textBlock.text().indexOf(QRegExp("\\\\subsection\\{[^\\}]*\\}"), 0) != -1 ? 2 : 1;
-            for(int i = level; i <= 3; ++i)
-            {
-                if(lastLevel[i - 1] != -1)
-                {
-                    this->structureInfo->at(lastLevel[i - 1])->endBlock = textBlockIndex - 1;
-                    lastLevel[i - 1] = -1;
-                }
-            }
-            lastBlock = textBlockIndex;
-            lastLevel[level - 1] = this->structureInfo->count();
-            first = false;
-            QString s = textBlock.text();
-            stru = new FileStructureInfo;
-            stru->startBlock = textBlockIndex;
-            stru->endBlock = this->widgetTextEdit->document()->blockCount() - 1;
-            stru->name = textBlock.text().indexOf(QRegExp("\\\\(sub){0,2}section\\{[^\\}]*\\}"), 0) != -1 ? s.replace(QRegExp(".*\\\\(sub){0,2}section\\{([^\\}]*)\\}.*"), "\\2") : "Bibliography";
-            stru->level = level;
-            this->structureInfo->append(stru);
+            continue;
         }
-        textBlock = textBlock.next();
-        ++textBlockIndex;
-    }while(textBlockIndex < this->widgetTextEdit->document()->blockCount());
-
-    for(int i = lastBlock; i < this->widgetTextEdit->document()->blockCount(); ++i)
-    {
-        this->blockIndentations[i].level = level;
-        this->blockIndentations[i].next = this->widgetTextEdit->document()->blockCount();
-    }
-
-    return;
-
-    first = true;
-    textBlockIndex = 0;
-    textBlock = this->widgetTextEdit->document()->begin();
-    do{
-        if(textBlock.text().indexOf(QRegExp("\\\\subsection\\{[^\\}]*\\}"), 0) != -1)
+        QString name;
+        int level = sectionLevel(data, &name);
+        if(!level)
         {
-            if(!first)
-            {
-                this->structureInfo->last()->endBlock = textBlockIndex-1;
-            }
-            level = 2;
-            first = false;
-            QString s = textBlock.text();
-            stru = new FileStructureInfo;
-            stru->startBlock = textBlockIndex;
-            stru->endBlock = this->widgetTextEdit->document()->blockCount() - 1;
-            stru->name = s.replace(QRegExp(".*\\\\subsection\\{([^\\}]*)\\}.*"), "\\1");
-            stru->level = level;
-            this->structureInfo->append(stru);
+            continue;
         }
-        textBlock = textBlock.next();
-        ++textBlockIndex;
-    }while(textBlockIndex < this->widgetTextEdit->document()->blockCount());
-    first = true;
-    textBlockIndex = 0;
-    textBlock = this->widgetTextEdit->document()->begin();
-    do{
-        if(textBlock.text().indexOf(QRegExp("\\\\subsubsection\\{[^\\}]*\\}"), 0) != -1)
+        int textBlockIndex = textBlock.blockNumber();
+        for(int i = level; i <= 3; ++i)
         {
-            if(!first)
+            if(lastLevel[i - 1] != -1)
             {
-                this->structureInfo->last()->endBlock = textBlockIndex-1;
+                this->structureInfo->at(lastLevel[i - 1])->endBlock = textBlockIndex - 1;
+                lastLevel[i - 1] = -1;
             }
-            level = 3;
-            first = false;
-            QString s = textBlock.text();
-            stru = new FileStructureInfo;
-            stru->startBlock = textBlockIndex;
-            stru->endBlock = this->widgetTextEdit->document()->blockCount() - 1;
-            stru->name = s.replace(QRegExp(".*\\\\subsubsection\\{([^\\}]*)\\}.*"), "\\1");
-            stru->level = level;
-            this->structureInfo->append(stru);
         }
-        textBlock = textBlock.next();
-        ++textBlockIndex;
-    }while(textBlockIndex < this->widgetTextEdit->document()->blockCount());
+        lastLevel[level - 1] = this->structureInfo->count();
+        FileStructureInfo * stru = new FileStructureInfo;
+        stru->startBlock = textBlockIndex;
+        stru->endBlock = _blockCount - 1;
+        stru->name = name;
+        stru->level = level;
+        this->structureInfo->append(stru);
+    }
 }
@@ -99,15 +99,54 @@ public:
 public slots:
     void reload();
     void clear();
+    /**
+     * @brief invalidate request a reload before the next query (called when the highlighter
+     * changed the environments or sections of a block).
+     */
+    void invalidate();
+    /**
+     * @brief invalidateNames request an update of the names of the items before the next query
+     * (called when the highlighter only changed the names of the environments or sections of a block).
+     */
+    void invalidateNames();
+    /**
+     * @brief onContentsChange move the items located after the modification
+     * so that the structure stays valid without being reloaded.
+     */
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    /**
+     * @brief onHighlightedBlockCountChanged follow the watermark of the highlighter: when blocks
+     * that were still pending at the last reload get their final state, a reload is requested.
+     */
+    void onHighlightedBlockCountChanged(int blockCount);
 
 private:
     void clear(StructItem * item);
+    /**
+     * @brief refresh reload the structure if it has been invalidated.
+     */
+    void refresh() const;
+    /**
+     * @brief updateNames read again the name of each item from the LatexBlockInfo of its block.
+     */
+    void updateNames(StructItem * item);
+    bool shift(StructItem * item, int position, int charsRemoved, int charsAdded, int blockDelta);
+    static const StructItem * childAt(const StructItem * item, int position);
     void debug(StructItem * item, int level);
     void sectionsList(QStringList * list, const StructItem *item, int level, QString fill) const;
     WidgetTextEdit * _widgetTextEdit;
     StructItem _environementRoot;
     StructItem * _documentItem;
     StructItem _sectionRoot;
+    bool _dirty;
+    bool _renamed;
+    int _blockCount;
+    /**
+     * @brief _highlightedBlockCount is the last watermark of the highlighter,
+     * _reloadedBlockCount its value at the last reload
+     */
+    int _highlightedBlockCount;
+    int _reloadedBlockCount;
 };
 
 
@@ -125,18 +164,52 @@ class FileStructure : public QObject
 public:
     explicit FileStructure(WidgetTextEdit *parent = 0);
     ~FileStructure();
-    QList<FileStructureInfo*> * info() { return this->structureInfo; }
-    BlockIndentation *  indentations() { return this->blockIndentations; }
+    QList<FileStructureInfo*> * info();
+    /**
+     * @brief indentation return the level of the section containing the block
+     * and the number of the block where the next section begins.
+     */
+    BlockIndentation indentation(int blockNumber);
 
 signals:
     
 public slots:
+    /**
+     * @brief updateStructure rebuild the list of sections from the LatexBlockInfo of the blocks
+     */
     void updateStructure(void);
-    
+    void invalidate();
+    /**
+     * @brief invalidateNames request an update of the names of the sections before the next query
+     */
+    void invalidateNames();
+    /**
+     * @brief onContentsChange move the sections located after a modification that adds or removes lines
+     */
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    /**
+     * @brief onHighlightedBlockCountChanged follow the watermark of the highlighter: when blocks
+     * that were still pending at the last reload get their final state, a reload is requested.
+     */
+    void onHighlightedBlockCountChanged(int blockCount);
+
 private:
-    BlockIndentation * blockIndentations;
+    /**
+     * @brief updateNames read again the name of each section from the LatexBlockInfo of its block,
+     * the structure is rebuilt if a block does not hold the same kind of section anymore.
+     */
+    void updateNames();
     QList<FileStructureInfo*> * structureInfo;
     WidgetTextEdit * widgetTextEdit;
+    bool _dirty;
+    bool _renamed;
+    int _blockCount;
+    /**
+     * @brief _highlightedBlockCount is the last watermark of the highlighter,
+     * _reloadedBlockCount its value at the last reload
+     */
+    int _highlightedBlockCount;
+    int _reloadedBlockCount;
 };
 
 #endif // FILESTRUCTURE_H
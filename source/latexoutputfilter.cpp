@@ -18,6 +18,7 @@
 //  - use KileDocument::Extensions
 // 2015-05-03 Quentin Bramas (quentin.bramas@gmail.com)
 //  - use string as input instead of textDocument
+//  - parse the output chunk by chunk while it is produced (begin, append, end)
 
 #include "latexoutputfilter.h"
 #include <QDebug>
@@ -115,7 +116,7 @@ void LatexLogEntry::clear(){
 
 //===========================OutputFilter===============================
 OutputFilter::OutputFilter() : QObject(),
-	m_nOutputLines(0), m_log(QString())
+	m_nOutputLines(0), m_log(QString()), m_cookie(0)
 {
 }
 
@@ -142,17 +143,45 @@ void OutputFilter::setSource(const QString &src)
 
 bool OutputFilter::run(const QString &log)
 {
+    begin();
     m_log = log;
-	short sCookie = 0;
-    QString s;
-    QStringList lines = m_log.split(QRegExp("(\\r\\n)|(\\n)"));
-    m_nOutputLines = lines.count();
-    foreach(const QString &line, lines)
+    append(log);
+    return end();
+}
+
+void OutputFilter::begin()
+{
+    m_log.clear();
+    m_partialLine.clear();
+    m_nOutputLines = 0;
+    m_cookie = 0;
+}
+
+void OutputFilter::append(const QString &chunk)
+{
+    int start = 0;
+    int lineEnd;
+    while((lineEnd = chunk.indexOf('\n', start)) != -1)
     {
-        sCookie = parseLine(line, sCookie);
+        m_partialLine.append(chunk.mid(start, lineEnd - start));
+        if(m_partialLine.endsWith('\r'))
+        {
+            m_partialLine.chop(1);
+        }
+        m_cookie = parseLine(m_partialLine, m_cookie);
         ++m_nOutputLines;
+        m_partialLine.clear();
+        start = lineEnd + 1;
     }
-	return OnTerminate();
+    m_partialLine.append(chunk.mid(start));
+}
+
+bool OutputFilter::end()
+{
+    m_cookie = parseLine(m_partialLine, m_cookie);
+    ++m_nOutputLines;
+    m_partialLine.clear();
+    return OnTerminate();
 }
 
 
@@ -564,6 +593,9 @@ void LatexOutputFilter::flushCurrentItem()
 
 		default: break;
 	}
+	if (nItemType == LT_ERROR || nItemType == LT_WARNING || nItemType == LT_BADBOX) {
+		emit entryAdded(m_infoList.last());
+	}
 	m_currentItem.clear();
 }
 
@@ -962,17 +994,17 @@ short LatexOutputFilter::parseLine(const QString & strLine, short dwCookie)
 //
 // dani 18.02.2005
 
-bool LatexOutputFilter::run(const QString &log)
+void LatexOutputFilter::begin()
 {
+	OutputFilter::begin();
 	m_filelookup.clear();
 	m_infoList.clear();
+	m_currentItem.clear();
 	m_nErrors = m_nWarnings = m_nBadBoxes = m_nParens = 0;
 	m_stackFile.clear();
 	QString mainfile = QFileInfo(source()).fileName();
 	m_stackFile.push(LOFStackItem(mainfile, true));
 	PRINT_FILE_STACK("push", mainfile);
-
-	return OutputFilter::run(log);
 }
 /*
 void LatexOutputFilter::updateInfoLists(const QString &texfilename, int selrow, int docrow)
@@ -16,6 +16,7 @@
 
 // 2015-05-03 Quentin Bramas (quentin.bramas@gmail.com)
 //  - use string as input instead of textDocument
+//  - parse the output chunk by chunk while it is produced (begin, append, end)
 
 #ifndef LATEXOUTPUTFILTER_H
 #define LATEXOUTPUTFILTER_H
@@ -89,7 +90,22 @@ public:
 protected:
 
 public:
+    /**
+     * @brief run parse the whole log at once
+     */
     virtual bool run(const QString &log);
+    /**
+     * @brief begin start parsing a new log, given chunk by chunk to append
+     */
+    virtual void begin();
+    /**
+     * @brief append parse the complete lines of the chunk, the last incomplete line waits for the next chunk
+     */
+    void append(const QString &chunk);
+    /**
+     * @brief end parse the last line of the log
+     */
+    bool end();
 
     const QString& log() const { return m_log; }
 
@@ -110,17 +126,21 @@ private:
     /** Number of current line in output file */
     unsigned int		m_nOutputLines;
     QString		m_log, m_source, m_srcPath;
+    /** Beginning of the line not terminated yet */
+    QString		m_partialLine;
+    short		m_cookie;
 };
 
 class LatexOutputFilter : public OutputFilter
 {
+	Q_OBJECT
 	friend class LatexOutputFilterTest;
 
     public:
         LatexOutputFilter();
         ~LatexOutputFilter();
 
-    virtual bool run(const QString &log);
+    virtual void begin();
 	//void sendProblems();
 	//void updateInfoLists(const QString &texfilename, int selrow, int docrow);
 
@@ -188,5 +208,9 @@ class LatexOutputFilter : public OutputFilter
     public:                                                                     // Public attributes
         /** Pointer to list of Latex output information */
         QList<LatexLogEntry> m_infoList;		
+
+    signals:
+        /** Emitted as soon as an error, a warning or a bad box is complete, it is the last of m_infoList */
+        void entryAdded(const LatexLogEntry & entry);
 };
 #endif
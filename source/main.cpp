@@ -36,6 +36,7 @@
 #include "dialogdownloadupdate.h"
 #include "tools.h"
 #include "pdfsynchronizer.h"
+#include "benchmark.h"
 #include <QSettings>
 #include <QFontDatabase>
 #include <QDebug>
@@ -137,6 +138,13 @@ int main(int argc, char *argv[])
     Tools::Log("MacroEngine init");
     MacroEngine::Instance.init();
 
+#ifdef DEBUG_BENCHMARK
+    if(Benchmark::run(args))
+    {
+        return 0;
+    }
+#endif
+
     Tools::Log("Create MainWindow");
     MainWindow w;
     Tools::Log("Show MainWindow");
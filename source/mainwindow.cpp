@@ -587,9 +587,8 @@ void MainWindow::createLastOpenedFilesMenu()
 void MainWindow::addFilenameToLastOpened(QString filename)
 {
     filename.replace("\\","/");
-    QSettings settings;
     QFileInfo info(filename);
-    settings.setValue("lastFolder",info.path());
+    ConfigManager::Instance.setLastFolder(info.path());
     QString basename = info.baseName();
     //udpate the settings
     {
@@ -0,0 +1,215 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "pdfpagecache.h"
+
+PdfPageCache::PdfPageCache(qint64 budget) :
+    _budget(budget),
+    _cost(0),
+    _clock(0),
+    _frameClock(0),
+    _downscaleFarPages(true),
+    _firstVisiblePage(-1),
+    _lastVisiblePage(-1),
+    _nearMargin(0),
+    _level(0),
+    _hits(0),
+    _misses(0)
+{
+}
+
+void PdfPageCache::setBudget(qint64 budget)
+{
+    _budget = budget;
+    trim();
+}
+
+void PdfPageCache::setViewport(int firstVisiblePage, int lastVisiblePage, int nearMargin, int level)
+{
+    _firstVisiblePage = firstVisiblePage;
+    _lastVisiblePage = lastVisiblePage;
+    _nearMargin = nearMargin;
+    _level = level;
+    _frameClock = _clock;
+}
+
+void PdfPageCache::clear()
+{
+    _entries.clear();
+    _cost = 0;
+}
+
+void PdfPageCache::insert(const PdfTile &tile, const QImage &image)
+{
+    Entry & entry = _entries[tile];
+    _cost -= entry.image.byteCount();
+    entry.image = image;
+    entry.downscaled = false;
+    entry.lastUse = ++_clock;
+    _cost += image.byteCount();
+    trim();
+}
+
+QImage PdfPageCache::image(const PdfTile &tile)
+{
+    QHash<PdfTile, Entry>::iterator it = _entries.find(tile);
+    if(it == _entries.end())
+    {
+        ++_misses;
+        return QImage();
+    }
+    if(it.value().downscaled)
+    {
+        ++_misses;
+    }
+    else
+    {
+        ++_hits;
+    }
+    it.value().lastUse = ++_clock;
+    return it.value().image;
+}
+
+QImage PdfPageCache::fallback(const PdfTile &tile)
+{
+    QHash<PdfTile, Entry>::iterator it = _entries.find(tile);
+    if(it == _entries.end())
+    {
+        return QImage();
+    }
+    it.value().lastUse = ++_clock;
+    return it.value().image;
+}
+
+void PdfPageCache::removePage(int page)
+{
+    QHash<PdfTile, Entry>::iterator it = _entries.begin();
+    while(it != _entries.end())
+    {
+        if(it.key().page == page)
+        {
+            _cost -= it.value().image.byteCount();
+            it = _entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void PdfPageCache::removePagesFrom(int page)
+{
+    QHash<PdfTile, Entry>::iterator it = _entries.begin();
+    while(it != _entries.end())
+    {
+        if(it.key().page >= page)
+        {
+            _cost -= it.value().image.byteCount();
+            it = _entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool PdfPageCache::isRendered(const PdfTile &tile) const
+{
+    QHash<PdfTile, Entry>::const_iterator it = _entries.constFind(tile);
+    return it != _entries.constEnd() && !it.value().downscaled;
+}
+
+QString PdfPageCache::status() const
+{
+    return QString("%1 hits, %2 misses, %3 MB / %4 MB")
+            .arg(_hits)
+            .arg(_misses)
+            .arg(_cost / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(_budget / (1024.0 * 1024.0), 0, 'f', 0);
+}
+
+bool PdfPageCache::leastRecentlyUsed(Candidates candidates, bool downscaled, PdfTile *tile) const
+{
+    bool found = false;
+    quint64 lastUse = 0;
+    QHash<PdfTile, Entry>::const_iterator it;
+    for(it = _entries.constBegin(); it != _entries.constEnd(); ++it)
+    {
+        const PdfTile & key = it.key();
+        if(!downscaled && it.value().downscaled)
+        {
+            continue;
+        }
+        switch(candidates)
+        {
+        case FarPages:
+            if(isNear(key.page)) continue;
+            break;
+        case OtherLevels:
+            if(key.level == _level) continue;
+            break;
+        case NearPages:
+            if(isVisible(key.page)) continue;
+            break;
+        case UnusedTiles:
+            // painted in the current frame
+            if(it.value().lastUse > _frameClock) continue;
+            break;
+        }
+        if(!found || it.value().lastUse < lastUse)
+        {
+            found = true;
+            *tile = key;
+            lastUse = it.value().lastUse;
+        }
+    }
+    return found;
+}
+
+void PdfPageCache::trim()
+{
+    PdfTile tile;
+    while(_budget > 0 && _cost > _budget)
+    {
+        // a downscaled tile of a far page is still a good placeholder
+        if(_downscaleFarPages && leastRecentlyUsed(FarPages, false, &tile))
+        {
+            Entry & entry = _entries[tile];
+            _cost -= entry.image.byteCount();
+            entry.image = entry.image.scaled(entry.image.size() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            entry.downscaled = true;
+            _cost += entry.image.byteCount();
+            continue;
+        }
+        if(!leastRecentlyUsed(FarPages, true, &tile)
+                && !leastRecentlyUsed(OtherLevels, true, &tile)
+                && !leastRecentlyUsed(NearPages, true, &tile)
+                && !leastRecentlyUsed(UnusedTiles, true, &tile))
+        {
+            // only the tiles on screen are left
+            return;
+        }
+        _cost -= _entries.value(tile).image.byteCount();
+        _entries.remove(tile);
+    }
+}
@@ -0,0 +1,171 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PDFPAGECACHE_H
+#define PDFPAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMetaType>
+#include <QString>
+#include <qmath.h>
+
+/**
+ * @brief PDF_TILE_SIZE is the width and height of a tile, in pixels.
+ */
+#define PDF_TILE_SIZE 256
+
+/**
+ * @brief The PdfTile struct identifies a square of PDF_TILE_SIZE pixels of a page rendered at a zoom level.
+ *
+ * The levels are discrete zooms, a factor sqrt(2) apart: level 0 is the zoom 1, level 2 the zoom 2,
+ * level -2 the zoom 0.5. The tiles of a level are painted scaled for all the zooms between two levels.
+ */
+struct PdfTile
+{
+    PdfTile() : page(-1), level(0), column(0), row(0) {}
+    PdfTile(int page, int level, int column, int row) : page(page), level(level), column(column), row(row) {}
+
+    bool operator==(const PdfTile & other) const
+    {
+        return page == other.page && level == other.level && column == other.column && row == other.row;
+    }
+
+    /**
+     * @brief scale return the zoom of the level
+     */
+    static qreal scale(int level) { return qPow(2.0, level / 2.0); }
+    /**
+     * @brief level return the level used to display the zoom: the smallest one that is not blurred.
+     */
+    static int level(qreal zoom) { return qCeil(2.0 * qLn(zoom) / qLn(2.0) - 0.01); }
+
+    int page;
+    int level;
+    int column;
+    int row;
+};
+Q_DECLARE_METATYPE(PdfTile)
+
+inline uint qHash(const PdfTile & tile)
+{
+    return ((uint(tile.page) * 31u + uint(tile.level)) * 1031u + uint(tile.column)) * 1031u + uint(tile.row);
+}
+
+/**
+ * @brief The PdfPageCache class keeps the rendered tiles of the pages of a pdf within a memory budget.
+ *
+ * When the budget is exceeded, the tiles of the pages far from the viewport are first downscaled (they remain
+ * usable as placeholders), then the least recently used tiles are dropped in this order: the far pages,
+ * the other zoom levels, the pages around the viewport, and finally the tiles that were not painted
+ * in the last frame. The tiles on screen are never dropped.
+ */
+class PdfPageCache
+{
+public:
+    explicit PdfPageCache(qint64 budget = 0);
+
+    /**
+     * @brief setBudget set the maximum size of the images, in bytes (0 for no limit)
+     */
+    void setBudget(qint64 budget);
+    qint64 budget() const { return _budget; }
+    void setDownscaleFarPages(bool downscale) { _downscaleFarPages = downscale; }
+    /**
+     * @brief setViewport is called before each frame with the visible pages and the current level.
+     * nearMargin is the number of pages around them that are kept as long as possible.
+     */
+    void setViewport(int firstVisiblePage, int lastVisiblePage, int nearMargin, int level);
+
+    void clear();
+    /**
+     * @brief removePage remove the tiles of the page, at all levels
+     */
+    void removePage(int page);
+    /**
+     * @brief removePagesFrom remove the tiles of the page and of the following ones
+     */
+    void removePagesFrom(int page);
+    void insert(const PdfTile & tile, const QImage & image);
+    /**
+     * @brief image return the image of the tile (null if none) and mark it as used in this frame.
+     * It is a hit when the tile is available and has not been downscaled.
+     */
+    QImage image(const PdfTile & tile);
+    /**
+     * @brief fallback return the image of the tile, possibly downscaled, without counting a hit or a miss.
+     */
+    QImage fallback(const PdfTile & tile);
+    /**
+     * @brief isRendered return true if the tile is available at full resolution
+     */
+    bool isRendered(const PdfTile & tile) const;
+
+    qint64 cost() const { return _cost; }
+    int hits() const { return _hits; }
+    int misses() const { return _misses; }
+    /**
+     * @brief status return a readout of the hits, misses and resident size
+     */
+    QString status() const;
+
+private:
+    struct Entry
+    {
+        QImage image;
+        bool downscaled;
+        quint64 lastUse;
+    };
+    enum Candidates
+    {
+        FarPages,
+        OtherLevels,
+        NearPages,
+        UnusedTiles
+    };
+
+    void trim();
+    bool isVisible(int page) const { return page >= _firstVisiblePage && page <= _lastVisiblePage; }
+    bool isNear(int page) const { return page >= _firstVisiblePage - _nearMargin && page <= _lastVisiblePage + _nearMargin; }
+    /**
+     * @brief leastRecentlyUsed find the least recently used tile among the candidates
+     * @return false if there is none
+     */
+    bool leastRecentlyUsed(Candidates candidates, bool downscaled, PdfTile * tile) const;
+
+    QHash<PdfTile, Entry> _entries;
+    qint64 _budget;
+    qint64 _cost;
+    quint64 _clock;
+    /**
+     * @brief _frameClock is the value of _clock when the current frame started
+     */
+    quint64 _frameClock;
+    bool _downscaleFarPages;
+    int _firstVisiblePage;
+    int _lastVisiblePage;
+    int _nearMargin;
+    int _level;
+    int _hits;
+    int _misses;
+};
+
+#endif // PDFPAGECACHE_H
@@ -0,0 +1,276 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "pdfrenderer.h"
+#include <QMutexLocker>
+#include <QDataStream>
+#include <QDebug>
+
+/**
+ * @brief FINGERPRINT_RESOLUTION is the resolution (in dpi) of the thumbnail hashed in the fingerprints
+ */
+#define FINGERPRINT_RESOLUTION 18
+
+PdfRenderer::PdfRenderer(QObject *parent) :
+    QThread(parent),
+    _document(0),
+    _baseResolution(72),
+    _rendering(false),
+    _renderingBaseResolution(0),
+    _stopRequested(false),
+    _generation(0)
+{
+    qRegisterMetaType<PdfTile>("PdfTile");
+    qRegisterMetaType<PdfLinkList>("PdfLinkList");
+    start(QThread::LowPriority);
+}
+
+PdfRenderer::~PdfRenderer()
+{
+    _queueMutex.lock();
+    _stopRequested = true;
+    _queue.clear();
+    _fingerprintQueue.clear();
+    _idleFingerprintQueue.clear();
+    _linkQueue.clear();
+    _queueWaiter.wakeAll();
+    _queueMutex.unlock();
+    wait();
+#ifdef DEBUG_DESTRUCTOR
+    qDebug()<<"delete PdfRenderer";
+#endif
+}
+
+void PdfRenderer::setDocument(Poppler::Document *document)
+{
+    _queueMutex.lock();
+    _queue.clear();
+    _fingerprintQueue.clear();
+    _idleFingerprintQueue.clear();
+    _linkQueue.clear();
+    _queueMutex.unlock();
+
+    QMutexLocker locker(&_documentMutex);
+    _document = document;
+    ++_generation;
+}
+
+void PdfRenderer::request(const QList<PdfTile> &tiles, qreal baseResolution)
+{
+    QMutexLocker locker(&_queueMutex);
+    _queue = tiles;
+    _baseResolution = baseResolution;
+    if(_rendering && _renderingBaseResolution == baseResolution)
+    {
+        // already in progress
+        _queue.removeAll(_renderingTile);
+    }
+    if(!_queue.isEmpty())
+    {
+        _queueWaiter.wakeAll();
+    }
+}
+
+void PdfRenderer::requestFingerprints(const QList<int> &pages, bool beforeTiles)
+{
+    QMutexLocker locker(&_queueMutex);
+    if(beforeTiles)
+    {
+        _fingerprintQueue << pages;
+    }
+    else
+    {
+        _idleFingerprintQueue << pages;
+    }
+    if(!pages.isEmpty())
+    {
+        _queueWaiter.wakeAll();
+    }
+}
+
+void PdfRenderer::requestLinks(const QList<int> &pages)
+{
+    QMutexLocker locker(&_queueMutex);
+    _linkQueue << pages;
+    if(!pages.isEmpty())
+    {
+        _queueWaiter.wakeAll();
+    }
+}
+
+bool PdfRenderer::isIdle()
+{
+    QMutexLocker locker(&_queueMutex);
+    return _queue.isEmpty() && _fingerprintQueue.isEmpty() && _idleFingerprintQueue.isEmpty() && _linkQueue.isEmpty() && !_rendering;
+}
+
+uint PdfRenderer::fingerprint(Poppler::Page *page)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << page->pageSizeF() << page->text(QRectF());
+    // the destinations move when the pages before them change, even if the page looks the same
+    foreach(Poppler::Link * link, page->links())
+    {
+        stream << link->linkArea();
+        if(link->linkType() == Poppler::Link::Goto)
+        {
+            Poppler::LinkDestination destination = static_cast<Poppler::LinkGoto*>(link)->destination();
+            stream << destination.pageNumber() << destination.left() << destination.top();
+        }
+        delete link;
+    }
+    // the text does not see the figures
+    QImage thumbnail = page->renderToImage(FINGERPRINT_RESOLUTION, FINGERPRINT_RESOLUTION);
+    stream.writeRawData(reinterpret_cast<const char*>(thumbnail.constBits()), thumbnail.byteCount());
+    return qHash(data);
+}
+
+PdfLinkList PdfRenderer::links(Poppler::Page *page)
+{
+    PdfLinkList links;
+    QSizeF pageSize = page->pageSizeF();
+    foreach(Poppler::Link * popLink, page->links())
+    {
+        if(popLink->linkType() == Poppler::Link::Goto)
+        {
+            Poppler::LinkDestination destination = static_cast<Poppler::LinkGoto*>(popLink)->destination();
+            QRectF linkArea = popLink->linkArea();
+            PdfLink link;
+            link.rectangle = QRectF(pageSize.width()*linkArea.left(), pageSize.height()*linkArea.top(),
+                                    pageSize.width()*linkArea.width(), pageSize.height()*linkArea.height()).normalized();
+            link.destinationPage = destination.pageNumber() - 1;
+            link.destination = QRectF(QPointF(destination.left(), destination.top()), QPointF(destination.right(), destination.bottom()));
+            links << link;
+        }
+        delete popLink;
+    }
+    return links;
+}
+
+void PdfRenderer::run()
+{
+    forever
+    {
+        _queueMutex.lock();
+        _rendering = false;
+        while(_queue.isEmpty() && _fingerprintQueue.isEmpty() && _idleFingerprintQueue.isEmpty() && _linkQueue.isEmpty() && !_stopRequested)
+        {
+            _queueWaiter.wait(&_queueMutex);
+        }
+        if(_stopRequested)
+        {
+            _queueMutex.unlock();
+            return;
+        }
+        if(!_linkQueue.isEmpty())
+        {
+            int pageNumber = _linkQueue.takeFirst();
+            _rendering = true;
+            _renderingTile = PdfTile();
+            _queueMutex.unlock();
+
+            PdfLinkList pageLinks;
+            bool collected = false;
+            int generation;
+            {
+                QMutexLocker locker(&_documentMutex);
+                generation = _generation;
+                Poppler::Page * page = _document && pageNumber >= 0 && pageNumber < _document->numPages() ? _document->page(pageNumber) : 0;
+                if(page)
+                {
+                    pageLinks = links(page);
+                    collected = true;
+                    delete page;
+                }
+            }
+            if(collected)
+            {
+                emit pageLinksCollected(generation, pageNumber, pageLinks);
+            }
+            continue;
+        }
+        if(!_fingerprintQueue.isEmpty() || _queue.isEmpty())
+        {
+            int pageNumber = _fingerprintQueue.isEmpty() ? _idleFingerprintQueue.takeFirst() : _fingerprintQueue.takeFirst();
+            _rendering = true;
+            _renderingTile = PdfTile();
+            _queueMutex.unlock();
+
+            uint pageFingerprint = 0;
+            int generation;
+            {
+                QMutexLocker locker(&_documentMutex);
+                generation = _generation;
+                Poppler::Page * page = _document && pageNumber >= 0 && pageNumber < _document->numPages() ? _document->page(pageNumber) : 0;
+                if(page)
+                {
+                    pageFingerprint = fingerprint(page);
+                    delete page;
+                }
+            }
+            if(pageFingerprint)
+            {
+                emit pageFingerprinted(generation, pageNumber, pageFingerprint);
+            }
+            continue;
+        }
+        PdfTile tile = _queue.takeFirst();
+        qreal baseResolution = _baseResolution;
+        _rendering = true;
+        _renderingTile = tile;
+        _renderingBaseResolution = baseResolution;
+        _queueMutex.unlock();
+
+        qreal resolution = baseResolution * PdfTile::scale(tile.level);
+
+        QImage image;
+        int generation;
+        {
+            QMutexLocker locker(&_documentMutex);
+            generation = _generation;
+            if(!_document || tile.page < 0 || tile.page >= _document->numPages())
+            {
+                continue;
+            }
+            Poppler::Page * page = _document->page(tile.page);
+            if(!page)
+            {
+                continue;
+            }
+            // the tiles of the last column and row are cut at the border of the page
+            QSizeF pageSize = page->pageSizeF() * resolution / 72.0;
+            int x = tile.column * PDF_TILE_SIZE;
+            int y = tile.row * PDF_TILE_SIZE;
+            int width = qMin(PDF_TILE_SIZE, qCeil(pageSize.width()) - x);
+            int height = qMin(PDF_TILE_SIZE, qCeil(pageSize.height()) - y);
+            if(width > 0 && height > 0)
+            {
+                image = page->renderToImage(resolution, resolution, x, y, width, height);
+            }
+            delete page;
+        }
+        if(!image.isNull())
+        {
+            emit tileRendered(generation, tile, image);
+        }
+    }
+}
@@ -0,0 +1,153 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef PDFRENDERER_H
+#define PDFRENDERER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QList>
+#include <QRectF>
+#include <QMetaType>
+#include "pdfpagecache.h"
+
+#ifdef OS_MAC
+#include "poppler/qt5/poppler-qt5.h"
+#else
+    #ifdef OS_WINDOWS
+        #include <poppler/qt5/poppler-qt5.h>
+    #else
+        #include "poppler/qt4/poppler-qt4.h"
+    #endif
+#endif
+
+/**
+ * @brief The PdfLink struct is a goto link of a page, copied out of Poppler by the worker thread.
+ */
+struct PdfLink
+{
+    PdfLink() : destinationPage(-1) {}
+    /**
+     * @brief rectangle is the area of the link in the page, in points
+     */
+    QRectF rectangle;
+    /**
+     * @brief destinationPage is the target page, starting from 0
+     */
+    int destinationPage;
+    /**
+     * @brief destination is the target area, relative to the size of the target page (from 0 to 1)
+     */
+    QRectF destination;
+};
+Q_DECLARE_METATYPE(PdfLink)
+typedef QList<PdfLink> PdfLinkList;
+Q_DECLARE_METATYPE(PdfLinkList)
+
+/**
+ * @brief The PdfRenderer class renders the tiles of the pages of a Poppler document in a worker thread.
+ *
+ * The requests are replaced at each call of request(): the tiles are rendered in the order
+ * of the list (visible tiles first, then the prefetched ones) and each image is sent to the GUI thread
+ * with the tileRendered() signal.
+ * Poppler cannot render the same document from several threads at once, so there is a single worker,
+ * which also collects the links of the pages, and the GUI thread must hold documentMutex() to use the document.
+ */
+class PdfRenderer : public QThread
+{
+    Q_OBJECT
+public:
+    explicit PdfRenderer(QObject * parent = 0);
+    ~PdfRenderer();
+
+    /**
+     * @brief setDocument change the rendered document. It waits for the end of the page being rendered,
+     * so the previous document can be deleted once this function returns.
+     */
+    void setDocument(Poppler::Document * document);
+    /**
+     * @brief request replace the pending requests by tiles. The resolution of a tile is
+     * baseResolution (in dpi, the resolution of the zoom 1) times the scale of its level.
+     */
+    void request(const QList<PdfTile> & tiles, qreal baseResolution);
+    /**
+     * @brief requestFingerprints add pages to the pages to fingerprint (see fingerprint()).
+     * @param beforeTiles if true the pages are fingerprinted before the tiles are rendered,
+     * otherwise when there is no tile left to render.
+     */
+    void requestFingerprints(const QList<int> & pages, bool beforeTiles);
+    /**
+     * @brief requestLinks add pages whose goto links must be collected, before the tiles are rendered.
+     * The links are sent with the pageLinksCollected() signal.
+     */
+    void requestLinks(const QList<int> & pages);
+    /**
+     * @brief fingerprint return a hash of the content of the page: its size, its text, its links
+     * and a thumbnail, so that the pages of two versions of a pdf can be compared without rendering them.
+     */
+    static uint fingerprint(Poppler::Page * page);
+    /**
+     * @brief isIdle return true if there is no pending request
+     */
+    bool isIdle();
+    /**
+     * @brief generation is incremented by setDocument: the images of a previous generation
+     * still in the event queue must be ignored.
+     */
+    int generation() const { return _generation; }
+    /**
+     * @brief documentMutex must be locked by the GUI thread around any access to the pages of the document
+     */
+    QMutex & documentMutex() { return _documentMutex; }
+
+signals:
+    void tileRendered(int generation, PdfTile tile, QImage image);
+    void pageFingerprinted(int generation, int page, uint fingerprint);
+    void pageLinksCollected(int generation, int page, PdfLinkList links);
+
+protected:
+    void run();
+
+private:
+    static PdfLinkList links(Poppler::Page * page);
+
+    Poppler::Document * _document;
+    /**
+     * @brief _documentMutex is locked while a page is rendered
+     */
+    QMutex _documentMutex;
+    QMutex _queueMutex;
+    QWaitCondition _queueWaiter;
+    QList<PdfTile> _queue;
+    QList<int> _fingerprintQueue;
+    QList<int> _linkQueue;
+    QList<int> _idleFingerprintQueue;
+    qreal _baseResolution;
+    bool _rendering;
+    PdfTile _renderingTile;
+    qreal _renderingBaseResolution;
+    bool _stopRequested;
+    int _generation;
+};
+
+#endif // PDFRENDERER_H
@@ -50,6 +50,60 @@ public:
         return Instance._wait();
     }
 
+    /**
+     * @brief query run a forward search directly on the scanner: find the input, then synctex_display_query.
+     * @param page the page of the result, starting at 0
+     * @param rect the bounding box of the result in the page
+     * @return true if the line has been found
+     */
+    static bool query(synctex_scanner_t scanner, QString sourceFile, int sourceLine, int * page, QRectF * rect)
+    {
+#ifdef OS_WINDOWS
+        QString filePath=QFileInfo(sourceFile).canonicalFilePath().replace("/", "\\");
+#else
+        QString filePath=QFileInfo(sourceFile).absolutePath()+"/./"+QFileInfo(sourceFile).fileName();
+#endif
+        PDF_SYNCHRONIZER_DEBUG(qDebug()<<"SYNC "<<filePath<<" line "<<sourceLine);
+        synctex_node_t node = synctex_scanner_input(scanner);
+        QString name;
+        bool found = false;
+        while (node != NULL)
+        {
+            name = QString::fromUtf8(synctex_scanner_get_name(scanner, synctex_node_tag(node)));
+            if (name == filePath)
+            {
+                found = true;
+                break;
+            }
+            node = synctex_node_sibling(node);
+        }
+
+        if (!found || synctex_display_query(scanner, name.toUtf8().data(), sourceLine, 0) <= 0)
+        {
+            return false;
+        }
+        int resultPage = -1;
+        QPainterPath path;
+        while ((node = synctex_next_result(scanner)) != NULL)
+        {
+
+            if (resultPage == -1) resultPage = synctex_node_page(node);
+            if (synctex_node_page(node) != resultPage) continue;
+            QRectF nodeRect(synctex_node_box_visible_h(node),
+                            synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
+                            synctex_node_box_visible_width(node),
+                            synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node));
+            path.addRect(nodeRect);
+        }
+        if (resultPage <= 0)
+        {
+            return false;
+        }
+        *page = resultPage - 1;
+        *rect = path.boundingRect();
+        return true;
+    }
+
 private:
 
     void _start()
@@ -199,54 +253,17 @@ private:
             {
                 continue;
             }
-#ifdef OS_WINDOWS
-            QString filePath=QFileInfo(sourceFile).canonicalFilePath().replace("/", "\\");
-#else
-            QString filePath=QFileInfo(sourceFile).absolutePath()+"/./"+QFileInfo(sourceFile).fileName();
-#endif
-            PDF_SYNCHRONIZER_DEBUG(qDebug()<<"SYNC "<<filePath<<" line "<<sourceLine);
-            synctex_node_t node = synctex_scanner_input(scanner);
-            QString name;
-            bool found = false;
-            while (node != NULL)
-            {
-                name = QString::fromUtf8(synctex_scanner_get_name(scanner, synctex_node_tag(node)));
-                //qDebug()<<filePath;
-                //qDebug()<<name<<"  "<<(name == filePath);
-                if (name == filePath)
-                {
-                    found = true;
-                    break;
-                }
-                node = synctex_node_sibling(node);
-            }
-
-
-            if (found && synctex_display_query(scanner, name.toUtf8().data(), sourceLine, 0) > 0)
+            int page;
+            QRectF rect;
+            if (query(scanner, sourceFile, sourceLine, &page, &rect))
             {
-                int page = -1;
-                QPainterPath path;
-                while ((node = synctex_next_result(scanner)) != NULL)
-                {
-
-                    if (page == -1) page = synctex_node_page(node);
-                    if (synctex_node_page(node) != page) continue;
-                    QRectF nodeRect(synctex_node_box_visible_h(node),
-                                    synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
-                                    synctex_node_box_visible_width(node),
-                                    synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node));
-                    path.addRect(nodeRect);
-                }
-                if (page > 0)
-                {
-                    QMetaObject::invokeMethod(const_cast<QObject *>(receiver),
-                                              methodName.toLatin1().constData(), Qt::QueuedConnection,
-                                              Q_ARG( int, page - 1),
-                                              Q_ARG( QRectF, path.boundingRect())
-                                              );
-                    PDF_SYNCHRONIZER_DEBUG(qDebug()<<"QMetaObject::invokeMethod    "<<methodName);
-                    //emit rectSync(page - 1, path.boundingRect());
-                }
+                QMetaObject::invokeMethod(const_cast<QObject *>(receiver),
+                                          methodName.toLatin1().constData(), Qt::QueuedConnection,
+                                          Q_ARG( int, page),
+                                          Q_ARG( QRectF, rect)
+                                          );
+                PDF_SYNCHRONIZER_DEBUG(qDebug()<<"QMetaObject::invokeMethod    "<<methodName);
+                //emit rectSync(page, rect);
             }
         }
     }
@@ -0,0 +1,225 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "spellchecker.h"
+#include "configmanager.h"
+#include "hunspell/hunspell.hxx"
+
+#include <QApplication>
+#include <QTextCodec>
+#include <QMutexLocker>
+#include <QDebug>
+
+QMap<QString, SpellChecker *> SpellChecker::_spellCheckers;
+
+SpellChecker * SpellChecker::forDictionary(QString dictionary)
+{
+    if(dictionary == ConfigManager::NoDictionnary)
+    {
+        return 0;
+    }
+    if(!_spellCheckers.contains(dictionary))
+    {
+        // owned by the application so that the worker is stopped before the application quits
+        _spellCheckers.insert(dictionary, new SpellChecker(dictionary, qApp));
+    }
+    return _spellCheckers.value(dictionary);
+}
+
+SpellChecker::SpellChecker(QString dictionary, QObject *parent) :
+    QThread(parent),
+    _dictionary(dictionary),
+    _cache(SPELL_CHECKER_CACHE_SIZE),
+    _cacheHits(0),
+    _cacheMisses(0),
+    _stopRequested(false)
+{
+    _hunspell = new Hunspell((ConfigManager::Instance.dictionaryPath() + _dictionary).toLatin1()+".aff",
+                             (ConfigManager::Instance.dictionaryPath() + _dictionary).toLatin1()+".dic");
+    _encoding = QString::fromLatin1(_hunspell->get_dic_encoding());
+    _codec = QTextCodec::codecForName(_encoding.toLatin1());
+    if(!_codec)
+    {
+        _codec = QTextCodec::codecForName("UTF-8");
+    }
+    foreach(const QString & word, ConfigManager::Instance.userDictionnary(_dictionary))
+    {
+        _hunspell->add(_codec->fromUnicode(word).data());
+    }
+
+    // the signal is emitted by the worker thread, the cache is updated in the GUI thread
+    connect(this, SIGNAL(batchChecked(QStringList,QStringList)), this, SLOT(onBatchChecked(QStringList,QStringList)), Qt::QueuedConnection);
+    start(QThread::LowPriority);
+}
+
+SpellChecker::~SpellChecker()
+{
+    _queueMutex.lock();
+    _stopRequested = true;
+    _queueWaiter.wakeAll();
+    _queueMutex.unlock();
+    wait();
+
+    if(_spellCheckers.value(_dictionary) == this)
+    {
+        _spellCheckers.remove(_dictionary);
+    }
+    delete _hunspell;
+#ifdef DEBUG_DESTRUCTOR
+    qDebug()<<"delete SpellChecker";
+#endif
+}
+
+SpellChecker::WordStatus SpellChecker::wordStatus(const QString &word)
+{
+    bool * correct = _cache.object(word);
+    if(correct)
+    {
+        ++_cacheHits;
+        return *correct ? Correct : Misspelled;
+    }
+    ++_cacheMisses;
+    if(!_requestedWords.contains(word))
+    {
+        _requestedWords.insert(word);
+        QMutexLocker locker(&_queueMutex);
+        _queue.append(word);
+        _queueWaiter.wakeAll();
+    }
+    return Unknown;
+}
+
+bool SpellChecker::spell(const QString &word)
+{
+    bool * correct = _cache.object(word);
+    if(correct)
+    {
+        ++_cacheHits;
+        return *correct;
+    }
+    ++_cacheMisses;
+    bool check = hunspellSpell(word);
+    _cache.insert(word, new bool(check));
+    return check;
+}
+
+QStringList SpellChecker::suggest(const QString &word)
+{
+    QStringList suggestions;
+    QMutexLocker locker(&_hunspellMutex);
+    char ** wordList;
+    int count = _hunspell->suggest(&wordList, _codec->fromUnicode(word).data());
+    for(int i = 0; i < count; ++i)
+    {
+        suggestions.append(_codec->toUnicode(wordList[i]));
+    }
+    if(count > 0)
+    {
+        _hunspell->free_list(&wordList, count);
+    }
+    return suggestions;
+}
+
+void SpellChecker::add(const QString &word)
+{
+    {
+        QMutexLocker locker(&_hunspellMutex);
+        _hunspell->add(_codec->fromUnicode(word).data());
+    }
+    _cache.insert(word, new bool(true));
+    // a batch in flight may have checked the word before it was added
+    if(_requestedWords.remove(word))
+    {
+        {
+            QMutexLocker locker(&_queueMutex);
+            _queue.removeAll(word);
+        }
+        // the blocks waiting for it will not get the result of the worker
+        emit wordsChecked(QStringList() << word);
+    }
+}
+
+bool SpellChecker::hunspellSpell(const QString &word)
+{
+    QByteArray encodedString = _codec->fromUnicode(word);
+    QMutexLocker locker(&_hunspellMutex);
+    return _hunspell->spell(encodedString.data());
+}
+
+void SpellChecker::onBatchChecked(QStringList correctWords, QStringList misspelledWords)
+{
+    QStringList words;
+    foreach(const QString & word, correctWords)
+    {
+        if(_requestedWords.remove(word))
+        {
+            _cache.insert(word, new bool(true));
+            words << word;
+        }
+    }
+    foreach(const QString & word, misspelledWords)
+    {
+        if(_requestedWords.remove(word))
+        {
+            _cache.insert(word, new bool(false));
+            words << word;
+        }
+    }
+    if(!words.isEmpty())
+    {
+        emit wordsChecked(words);
+    }
+}
+
+void SpellChecker::run()
+{
+    forever
+    {
+        _queueMutex.lock();
+        while(_queue.isEmpty() && !_stopRequested)
+        {
+            _queueWaiter.wait(&_queueMutex);
+        }
+        if(_stopRequested)
+        {
+            _queueMutex.unlock();
+            return;
+        }
+        QStringList words = _queue.mid(0, SPELL_CHECKER_BATCH_SIZE);
+        _queue = _queue.mid(words.count());
+        _queueMutex.unlock();
+
+        QStringList correctWords;
+        QStringList misspelledWords;
+        foreach(const QString & word, words)
+        {
+            if(hunspellSpell(word))
+            {
+                correctWords.append(word);
+            }
+            else
+            {
+                misspelledWords.append(word);
+            }
+        }
+        emit batchChecked(correctWords, misspelledWords);
+    }
+}
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SPELLCHECKER_H
+#define SPELLCHECKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QCache>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+
+class Hunspell;
+class QTextCodec;
+
+/**
+ * @brief SPELL_CHECKER_CACHE_SIZE is the number of words kept in the cache of each dictionary.
+ */
+#define SPELL_CHECKER_CACHE_SIZE 100000
+/**
+ * @brief SPELL_CHECKER_BATCH_SIZE is the maximum number of words checked by the worker thread
+ * before the results are sent back to the editors.
+ */
+#define SPELL_CHECKER_BATCH_SIZE 512
+
+/**
+ * @brief The SpellChecker class wraps the Hunspell instance of a dictionary.
+ *
+ * The results are kept in a LRU cache (word -> correct/misspelled). Unknown words
+ * are checked by a worker thread and the wordsChecked() signal is emitted when
+ * a batch of results is available, so that the editors can update their underlines.
+ * All the methods must be called from the GUI thread.
+ */
+class SpellChecker : public QThread
+{
+    Q_OBJECT
+public:
+    typedef enum WordStatus { Unknown, Correct, Misspelled } WordStatus;
+
+    /**
+     * @brief forDictionary return the spell checker shared by all the files using this dictionary,
+     * 0 if dictionary is ConfigManager::NoDictionnary.
+     */
+    static SpellChecker * forDictionary(QString dictionary);
+
+    explicit SpellChecker(QString dictionary, QObject * parent = 0);
+    ~SpellChecker();
+
+    /**
+     * @brief wordStatus return the cached status of word. If the word is not in the cache,
+     * it is queued for the worker thread and Unknown is returned.
+     */
+    WordStatus wordStatus(const QString & word);
+    /**
+     * @brief spell synchronously check word (using the cache)
+     */
+    bool spell(const QString & word);
+    QStringList suggest(const QString & word);
+    void add(const QString & word);
+    QString encoding() const { return _encoding; }
+    QString dictionary() const { return _dictionary; }
+
+    int cacheHits() const { return _cacheHits; }
+    int cacheMisses() const { return _cacheMisses; }
+
+signals:
+    /**
+     * @brief wordsChecked is emitted when the status of words has been cached by the worker thread
+     */
+    void wordsChecked(QStringList words);
+    void batchChecked(QStringList correctWords, QStringList misspelledWords);
+
+private slots:
+    void onBatchChecked(QStringList correctWords, QStringList misspelledWords);
+
+protected:
+    void run();
+
+private:
+    bool hunspellSpell(const QString & word);
+
+    static QMap<QString, SpellChecker *> _spellCheckers;
+
+    QString _dictionary;
+    QString _encoding;
+    QTextCodec * _codec;
+    Hunspell * _hunspell;
+    /**
+     * @brief _hunspellMutex protects _hunspell that is used by both the worker and the GUI thread
+     */
+    QMutex _hunspellMutex;
+
+    QCache<QString, bool> _cache;
+    /**
+     * @brief _requestedWords are the words queued or being checked by the worker thread,
+     * the results of the other words are dropped (see add())
+     */
+    QSet<QString> _requestedWords;
+    int _cacheHits;
+    int _cacheMisses;
+
+    QMutex _queueMutex;
+    QWaitCondition _queueWaiter;
+    QStringList _queue;
+    bool _stopRequested;
+};
+
+#endif // SPELLCHECKER_H
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "symboltable.h"
+
+void SymbolTable::add(const QStringList &words)
+{
+    foreach(const QString & word, words)
+    {
+        int & count = _counts[word];
+        if(!count++)
+        {
+            ++_revision;
+        }
+    }
+}
+
+void SymbolTable::remove(const QStringList &words)
+{
+    foreach(const QString & word, words)
+    {
+        QMap<QString, int>::iterator it = _counts.find(word);
+        if(it == _counts.end())
+        {
+            continue;
+        }
+        if(!--it.value())
+        {
+            _counts.erase(it);
+            ++_revision;
+        }
+    }
+}
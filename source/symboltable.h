@@ -0,0 +1,60 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QSharedData>
+#include <QMap>
+#include <QStringList>
+
+/**
+ * @brief The SymbolTable class counts the symbols defined in a document (labels, custom commands, bibitems),
+ * stored as the completion words they produce (\\ref{label}, \\mycommand, \\cite{key}).
+ *
+ * Each block registers its own symbols (see BlockData::setSymbols) and removes them when it is
+ * highlighted again or deleted, so the table is kept up to date without reading the whole document.
+ * The table is shared by the blocks and the highlighter so that it lives as long as one of them.
+ */
+class SymbolTable : public QSharedData
+{
+public:
+    SymbolTable() : _revision(0) {}
+
+    void add(const QStringList & words);
+    void remove(const QStringList & words);
+
+    /**
+     * @brief words return the distinct symbols, sorted.
+     */
+    QStringList words() const { return _counts.keys(); }
+    int count() const { return _counts.count(); }
+    /**
+     * @brief revision is incremented each time a symbol appears or disappears.
+     */
+    int revision() const { return _revision; }
+
+private:
+    QMap<QString, int> _counts;
+    int _revision;
+};
+
+#endif // SYMBOLTABLE_H
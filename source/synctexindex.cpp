@@ -0,0 +1,264 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "synctexindex.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QSet>
+#include <QPainterPath>
+#include <algorithm>
+
+/**
+ * @brief SYNCTEX_LINE_LOOKAHEAD is the number of following lines synctex_display_query tries
+ * when a line has no node (the number of friend lists of the scanner).
+ */
+#define SYNCTEX_LINE_LOOKAHEAD 1024
+/**
+ * @brief SYNCTEX_BAND_HEIGHT is the height of the bands of the reverse search index, in points
+ */
+#define SYNCTEX_BAND_HEIGHT 24
+
+void SynctexIndex::build(synctex_scanner_t scanner, int pageCount)
+{
+    clear();
+    if(scanner == NULL)
+    {
+        return;
+    }
+
+    // the lines that produced a node, by input tag
+    QHash<int, QSet<int> > lines;
+    _pages.resize(pageCount);
+    for(int page = 1; page <= pageCount; ++page)
+    {
+        for(synctex_node_t node = synctex_sheet_content(scanner, page); node != NULL; node = synctex_node_next(node))
+        {
+            if(synctex_node_tag(node) > 0 && synctex_node_line(node) > 0)
+            {
+                lines[synctex_node_tag(node)].insert(synctex_node_line(node));
+                addNode(_pages[page - 1], node);
+            }
+        }
+        Page & pageIndex = _pages[page - 1];
+        std::stable_sort(pageIndex.positions.begin(), pageIndex.positions.end(), positionLessThan);
+    }
+
+    QHash<int, QSet<int> >::const_iterator input;
+    for(input = lines.constBegin(); input != lines.constEnd(); ++input)
+    {
+        QByteArray name(synctex_scanner_get_name(scanner, input.key()));
+        _inputs.insert(input.key(), QString::fromUtf8(name));
+        QMap<int, Box> & boxes = _boxes[canonicalName(QString::fromUtf8(name))];
+        foreach(int line, input.value())
+        {
+            if(synctex_display_query(scanner, name.constData(), line, 0) <= 0)
+            {
+                continue;
+            }
+            // the same result as PdfSynchronizer: the nodes of the first page found
+            int page = -1;
+            QPainterPath path;
+            synctex_node_t node;
+            while ((node = synctex_next_result(scanner)) != NULL)
+            {
+                if (page == -1) page = synctex_node_page(node);
+                if (synctex_node_page(node) != page) continue;
+                path.addRect(QRectF(synctex_node_box_visible_h(node),
+                                    synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
+                                    synctex_node_box_visible_width(node),
+                                    synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node)));
+            }
+            if(page > 0)
+            {
+                Box box;
+                box.page = page - 1;
+                box.rect = path.boundingRect();
+                boxes.insert(line, box);
+            }
+        }
+    }
+}
+
+void SynctexIndex::clear()
+{
+    _boxes.clear();
+    _pages.clear();
+    _inputs.clear();
+}
+
+void SynctexIndex::addNode(Page &page, synctex_node_t node)
+{
+    Node entry;
+    entry.tag = synctex_node_tag(node);
+    entry.line = synctex_node_line(node);
+    switch(synctex_node_type(node))
+    {
+    case synctex_node_type_vbox:
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_hbox:
+    case synctex_node_type_void_hbox:
+    {
+        entry.rect = QRectF(synctex_node_box_visible_h(node),
+                            synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
+                            synctex_node_box_visible_width(node),
+                            synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node));
+        if(entry.rect.isEmpty())
+        {
+            return;
+        }
+        int lastBand = qMax(0, int(entry.rect.bottom() / SYNCTEX_BAND_HEIGHT));
+        if(page.bands.count() <= lastBand)
+        {
+            page.bands.resize(lastBand + 1);
+        }
+        for(int band = qMax(0, int(entry.rect.top() / SYNCTEX_BAND_HEIGHT)); band <= lastBand; ++band)
+        {
+            page.bands[band].append(page.boxes.count());
+        }
+        page.boxes.append(entry);
+        break;
+    }
+    case synctex_node_type_kern:
+    case synctex_node_type_glue:
+    case synctex_node_type_math:
+        entry.rect = QRectF(synctex_node_visible_h(node), synctex_node_visible_v(node), 0, 0);
+        page.positions.append(entry);
+        break;
+    default:
+        break;
+    }
+}
+
+bool SynctexIndex::positionLessThan(const Node &first, const Node &second)
+{
+    return first.rect.top() < second.rect.top();
+}
+
+qreal SynctexIndex::baselineDistance(qreal baseline, qreal ordinate)
+{
+    // the text of a line is above its baseline: the baselines below the point come first
+    return baseline >= ordinate ? baseline - ordinate : 1000 + ordinate - baseline;
+}
+
+int SynctexIndex::boxAt(const Page &page, const QPointF &point)
+{
+    int band = int(point.y() / SYNCTEX_BAND_HEIGHT);
+    int smallest = -1;
+    if(point.y() >= 0 && band < page.bands.count())
+    {
+        foreach(int box, page.bands.at(band))
+        {
+            const QRectF & rect = page.boxes.at(box).rect;
+            if(rect.contains(point) && (smallest == -1 || rect.width() * rect.height() < page.boxes.at(smallest).rect.width() * page.boxes.at(smallest).rect.height()))
+            {
+                smallest = box;
+            }
+        }
+    }
+    if(smallest != -1)
+    {
+        return smallest;
+    }
+    // in a margin: the closest box
+    qreal smallestDistance = 0;
+    for(int box = 0; box < page.boxes.count(); ++box)
+    {
+        const QRectF & rect = page.boxes.at(box).rect;
+        qreal dx = qMax(qreal(0), qMax(rect.left() - point.x(), point.x() - rect.right()));
+        qreal dy = qMax(qreal(0), qMax(rect.top() - point.y(), point.y() - rect.bottom()));
+        if(smallest == -1 || dx * dx + dy * dy < smallestDistance)
+        {
+            smallest = box;
+            smallestDistance = dx * dx + dy * dy;
+        }
+    }
+    return smallest;
+}
+
+bool SynctexIndex::findSource(int page, const QPointF &point, QString *sourceFile, int *line) const
+{
+    if(page < 0 || page >= _pages.count())
+    {
+        return false;
+    }
+    const Page & pageIndex = _pages.at(page);
+    int box = boxAt(pageIndex, point);
+    if(box == -1)
+    {
+        return false;
+    }
+    const Node * result = &pageIndex.boxes.at(box);
+    // the closest position on the left of the point, on the lines of the box
+    const QRectF & rect = result->rect;
+    Node top;
+    top.rect = QRectF(0, rect.top(), 0, 0);
+    QVector<Node>::const_iterator it = std::lower_bound(pageIndex.positions.constBegin(), pageIndex.positions.constEnd(), top, positionLessThan);
+    const Node * position = 0;
+    for(; it != pageIndex.positions.constEnd() && it->rect.top() <= rect.bottom(); ++it)
+    {
+        if(it->rect.left() < rect.left() || it->rect.left() > point.x())
+        {
+            continue;
+        }
+        // the line of the point, then the position closest to it
+        if(!position
+                || baselineDistance(it->rect.top(), point.y()) < baselineDistance(position->rect.top(), point.y())
+                || (it->rect.top() == position->rect.top() && it->rect.left() > position->rect.left()))
+        {
+            position = &*it;
+        }
+    }
+    if(position)
+    {
+        result = position;
+    }
+    *sourceFile = _inputs.value(result->tag);
+    *line = result->line;
+    return !sourceFile->isEmpty();
+}
+
+bool SynctexIndex::find(const QString &sourceFile, int line, Box *box) const
+{
+    QHash<QString, QString>::const_iterator name = _canonicalNames.constFind(sourceFile);
+    if(name == _canonicalNames.constEnd())
+    {
+        name = _canonicalNames.insert(sourceFile, canonicalName(sourceFile));
+    }
+    QHash<QString, QMap<int, Box> >::const_iterator boxes = _boxes.constFind(name.value());
+    if(boxes == _boxes.constEnd())
+    {
+        return false;
+    }
+    QMap<int, Box>::const_iterator it = boxes.value().lowerBound(line);
+    if(it == boxes.value().constEnd() || it.key() >= line + SYNCTEX_LINE_LOOKAHEAD)
+    {
+        return false;
+    }
+    *box = it.value();
+    return true;
+}
+
+QString SynctexIndex::canonicalName(const QString &filename)
+{
+    QFileInfo info(filename);
+    QString canonical = info.canonicalFilePath();
+    return canonical.isEmpty() ? QDir::cleanPath(info.absoluteFilePath()) : canonical;
+}
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCTEXINDEX_H
+#define SYNCTEXINDEX_H
+
+#include <QHash>
+#include <QMap>
+#include <QPointF>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+
+#include "synctex_parser.h"
+
+/**
+ * @brief The SynctexIndex class answers the forward (source line -> pdf) and reverse (pdf -> source line)
+ * searches without querying synctex.
+ *
+ * It is built once per synctex file: synctex_display_query is run for each line of each input that
+ * produced a node, and the page and the bounding box of the result are stored by canonical file path and line.
+ * As synctex_display_query falls back to the next lines, a line without node is answered by the next indexed line.
+ *
+ * For the reverse searches, the boxes of each page are stored in horizontal bands of SYNCTEX_BAND_HEIGHT points,
+ * and the glues, kerns and math nodes (the positions inside the lines) are sorted by ordinate.
+ */
+class SynctexIndex
+{
+public:
+    struct Box
+    {
+        /**
+         * @brief page is the page of the box, starting at 0
+         */
+        int page;
+        QRectF rect;
+    };
+
+    /**
+     * @brief build index the scanner. It runs synctex queries, so the scanner must not be used by another thread.
+     */
+    void build(synctex_scanner_t scanner, int pageCount);
+    void clear();
+    bool isEmpty() const { return _boxes.isEmpty() && _pages.isEmpty(); }
+    /**
+     * @brief find return the box produced by the line of the source file
+     * @return false if the line did not produce anything
+     */
+    bool find(const QString & sourceFile, int line, Box * box) const;
+    /**
+     * @brief findSource return the source line of the point of the page (starting at 0), in points:
+     * the position on the left of the point in the smallest box containing it, or the closest box.
+     * @return false if the page has no box
+     */
+    bool findSource(int page, const QPointF & point, QString * sourceFile, int * line) const;
+
+private:
+    struct Node
+    {
+        QRectF rect;
+        int tag;
+        int line;
+    };
+    struct Page
+    {
+        /**
+         * @brief boxes are the hboxes and vboxes of the page
+         */
+        QVector<Node> boxes;
+        /**
+         * @brief bands are the indexes of the boxes crossing each band
+         */
+        QVector<QVector<int> > bands;
+        /**
+         * @brief positions are the glues, kerns and math nodes (empty rectangles), sorted by ordinate
+         */
+        QVector<Node> positions;
+    };
+
+    static QString canonicalName(const QString & filename);
+    void addNode(Page & page, synctex_node_t node);
+    /**
+     * @brief boxAt return the index of the smallest box containing the point, or the closest one
+     */
+    static int boxAt(const Page & page, const QPointF & point);
+    static bool positionLessThan(const Node & first, const Node & second);
+    static qreal baselineDistance(qreal baseline, qreal ordinate);
+
+    /**
+     * @brief _boxes are the boxes of each input, by canonical file path and line
+     */
+    QHash<QString, QMap<int, Box> > _boxes;
+    QVector<Page> _pages;
+    /**
+     * @brief _inputs are the file names of the inputs, by tag
+     */
+    QHash<int, QString> _inputs;
+    /**
+     * @brief _canonicalNames caches the canonical paths of the source files, which need a file system access
+     */
+    mutable QHash<QString, QString> _canonicalNames;
+};
+
+#endif // SYNCTEXINDEX_H
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "synctexloader.h"
+#include "synctexindex.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+SynctexLoader::SynctexLoader(QObject *parent) :
+    QThread(parent),
+    _pageCount(0),
+    _loadRequested(false),
+    _stopRequested(false),
+    _scanner(NULL),
+    _index(0)
+{
+    start(QThread::LowPriority);
+}
+
+SynctexLoader::~SynctexLoader()
+{
+    _mutex.lock();
+    _stopRequested = true;
+    _waiter.wakeAll();
+    _mutex.unlock();
+    wait();
+    freeResult(_scanner, _index);
+#ifdef DEBUG_DESTRUCTOR
+    qDebug()<<"delete SynctexLoader";
+#endif
+}
+
+void SynctexLoader::load(const QString &syncFile, int pageCount)
+{
+    QMutexLocker locker(&_mutex);
+    _syncFile = syncFile;
+    _pageCount = pageCount;
+    _loadRequested = true;
+    _waiter.wakeAll();
+}
+
+void SynctexLoader::takeResult(synctex_scanner_t *scanner, SynctexIndex **index)
+{
+    QMutexLocker locker(&_mutex);
+    *scanner = _scanner;
+    *index = _index;
+    _scanner = NULL;
+    _index = 0;
+}
+
+void SynctexLoader::freeResult(synctex_scanner_t scanner, SynctexIndex *index)
+{
+    if(scanner != NULL)
+    {
+        synctex_scanner_free(scanner);
+    }
+    delete index;
+}
+
+void SynctexLoader::run()
+{
+    forever
+    {
+        _mutex.lock();
+        while(!_loadRequested && !_stopRequested)
+        {
+            _waiter.wait(&_mutex);
+        }
+        if(_stopRequested)
+        {
+            _mutex.unlock();
+            return;
+        }
+        QString syncFile = _syncFile;
+        int pageCount = _pageCount;
+        _loadRequested = false;
+        _mutex.unlock();
+
+        synctex_scanner_t scanner = synctex_scanner_new_with_output_file(syncFile.toUtf8().data(), NULL, 1);
+        if( scanner == NULL )
+        {
+            scanner = synctex_scanner_new_with_output_file(syncFile.toLatin1().data(), NULL, 1);
+        }
+        if( scanner == NULL )
+        {
+            qDebug()<<"scanner is NULL, cannot open "<<syncFile+".synctex.gz"<<" -> Maybe some special character that make it fails?";
+            continue;
+        }
+        SynctexIndex * index = new SynctexIndex();
+        index->build(scanner, pageCount);
+
+        _mutex.lock();
+        if(_loadRequested || _stopRequested)
+        {
+            // a newer file has been requested
+            _mutex.unlock();
+            freeResult(scanner, index);
+            continue;
+        }
+        freeResult(_scanner, _index);
+        _scanner = scanner;
+        _index = index;
+        _mutex.unlock();
+        emit loaded();
+    }
+}
@@ -0,0 +1,75 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef SYNCTEXLOADER_H
+#define SYNCTEXLOADER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+#include "synctex_parser.h"
+
+class SynctexIndex;
+
+/**
+ * @brief The SynctexLoader class parses a synctex file and builds its SynctexIndex in a worker thread.
+ *
+ * The loaded() signal is emitted when the last requested file is ready; the receiver then takes
+ * the scanner and the index with takeResult(). The results of the files requested in the meantime are dropped.
+ */
+class SynctexLoader : public QThread
+{
+    Q_OBJECT
+public:
+    explicit SynctexLoader(QObject * parent = 0);
+    ~SynctexLoader();
+
+    /**
+     * @brief load parse the synctex file of syncFile (the path of the pdf without its extension)
+     */
+    void load(const QString & syncFile, int pageCount);
+    /**
+     * @brief takeResult give the ownership of the last scanner and index loaded (NULL and 0 if there is none)
+     */
+    void takeResult(synctex_scanner_t * scanner, SynctexIndex ** index);
+
+signals:
+    void loaded();
+
+protected:
+    void run();
+
+private:
+    static void freeResult(synctex_scanner_t scanner, SynctexIndex * index);
+
+    QMutex _mutex;
+    QWaitCondition _waiter;
+    QString _syncFile;
+    int _pageCount;
+    bool _loadRequested;
+    bool _stopRequested;
+    synctex_scanner_t _scanner;
+    SynctexIndex * _index;
+};
+
+#endif // SYNCTEXLOADER_H
@@ -19,13 +19,14 @@
  *                                                                         *
  ***************************************************************************/
 
-#include "hunspell/hunspell.hxx"
+#include "spellchecker.h"
 
 #include "syntaxhighlighter.h"
 #include <QTextCharFormat>
 #include <QTextDocument>
 #include <QDebug>
 #include <QTextCodec>
+#include <QElapsedTimer>
 #include "blockdata.h"
 #include "configmanager.h"
 #include "widgetfile.h"
@@ -33,6 +34,7 @@
 #include "file.h"
 
 #include <QBrush>
+#include <algorithm>
 
 QStringList initTextBlockCommands()
 {
@@ -68,16 +70,77 @@ QStringList initMathEnvironment()
     return list;
 }
 
+QByteArray initCharacterClasses()
+{
+    QByteArray classes(128, char(SyntaxHighlighter::NoClass));
+    for(int c = 0; c < 128; ++c)
+    {
+        int flags = SyntaxHighlighter::NoClass;
+        if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+        {
+            flags |= SyntaxHighlighter::LetterClass | SyntaxHighlighter::ArgumentClass | SyntaxHighlighter::WordClass;
+        }
+        else if(c >= '0' && c <= '9')
+        {
+            flags |= SyntaxHighlighter::ArgumentClass | SyntaxHighlighter::WordClass;
+        }
+        else if(c == ' ')
+        {
+            flags |= SyntaxHighlighter::ArgumentClass;
+        }
+        else if(c == '_')
+        {
+            flags |= SyntaxHighlighter::WordClass;
+        }
+        classes[c] = char(flags);
+    }
+    return classes;
+}
+
 QStringList SyntaxHighlighter::otherBlockCommands = initOtherBlockCommands();
 QStringList SyntaxHighlighter::textBlockCommands = initTextBlockCommands();
 QStringList SyntaxHighlighter::commandsWithOptions = initCommandsWithOptions();
 QStringList SyntaxHighlighter::mathEnvironments = initMathEnvironment();
+QSet<QString> SyntaxHighlighter::_otherBlockCommandSet = SyntaxHighlighter::otherBlockCommands.toSet();
+QSet<QString> SyntaxHighlighter::_textBlockCommandSet = SyntaxHighlighter::textBlockCommands.toSet();
+QSet<QString> SyntaxHighlighter::_commandsWithOptionSet = SyntaxHighlighter::commandsWithOptions.toSet();
+QSet<QString> SyntaxHighlighter::_mathEnvironmentSet = SyntaxHighlighter::mathEnvironments.toSet();
+const QByteArray SyntaxHighlighter::characterClasses = initCharacterClasses();
 
 SyntaxHighlighter::SyntaxHighlighter(WidgetFile *widgetFile) :
-    QSyntaxHighlighter(widgetFile->widgetTextEdit()->document())
+    QSyntaxHighlighter(widgetFile->widgetTextEdit()->document()),
+    _lastBlockCount(widgetFile->widgetTextEdit()->document()->blockCount()),
+    _highlightingPendingBlocks(false),
+    _symbolTable(new SymbolTable()),
+    _formatCommand(ConfigManager::Instance.formatId("command")),
+    _formatCommandInMathMode(ConfigManager::Instance.formatId("command-in-math-mode")),
+    _formatOption(ConfigManager::Instance.formatId("option")),
+    _formatComment(ConfigManager::Instance.formatId("comment")),
+    _formatMath(ConfigManager::Instance.formatId("math")),
+    _formatOther(ConfigManager::Instance.formatId("other")),
+    _formatBibTitle(ConfigManager::Instance.formatId("bibtex/command")),
+    _formatBibKeywords(ConfigManager::Instance.formatId("bibtex/keyword")),
+    _formatBibString(ConfigManager::Instance.formatId("bibtex/string")),
+    _formatBibQuotes(ConfigManager::Instance.formatId("bibtex/quote"))
 {
     _widgetFile = widgetFile;
+    _pendingTimer.setSingleShot(true);
+    _pendingTimer.setInterval(0);
+    connect(&_pendingTimer, SIGNAL(timeout()), this, SLOT(highlightPendingBlocks()));
+    _spellingTimer.setSingleShot(true);
+    _spellingTimer.setInterval(0);
+    connect(&_spellingTimer, SIGNAL(timeout()), this, SLOT(highlightSpellingBlocks()));
+    connect(document(), SIGNAL(blockCountChanged(int)), this, SLOT(onBlockCountChanged(int)));
+
+    // merged into the format of the misspelled words
+    _spellingErrorFormat.setFontUnderline(true);
+    _spellingErrorFormat.setUnderlineColor(QColor(Qt::red));
 
+#if QT_VERSION > 0x050000
+    _argumentDelimiterFormat.setFontStretch(1);
+#endif
+    _argumentDelimiterFormat.setFontLetterSpacing(10);
+    _argumentDelimiterFormat.setForeground(QBrush(QColor(0,0,0,0)));
 }
 SyntaxHighlighter::~SyntaxHighlighter()
 {
@@ -98,11 +161,149 @@ SyntaxHighlighter::State intToState(int in) {
     }
 }
 
+/**
+ * @brief matchDelimiterCommand return the length of the sized delimiter (e.g. "\\left\\{" or "\\right)")
+ * starting at position, 0 if there is none. Equivalent to the pattern \\keyword[\\]{0,1}[^a-zA-Z\\]
+ */
+int matchDelimiterCommand(const QString &text, int position, const QLatin1String &keyword, int keywordLength)
+{
+    if(text.at(position) != '\\' || text.midRef(position + 1, keywordLength) != keyword)
+    {
+        return 0;
+    }
+    int idx = position + 1 + keywordLength;
+    if(idx < text.length() && text.at(idx) == '\\')
+    {
+        ++idx;
+    }
+    if(idx >= text.length() || text.at(idx) == '\\' || SyntaxHighlighter::isCommandLetter(text.at(idx)))
+    {
+        return 0;
+    }
+    return idx + 1 - position;
+}
+
+/**
+ * @brief scanParentheses insert in blockData the left (or right) parentheses found in text
+ * @param side ParenthesisInfo::LEFT or ParenthesisInfo::RIGHT
+ */
+void scanParentheses(const QString &text, const quint8 * characterStates, BlockData * blockData, int side)
+{
+    static const QLatin1String leftKeyword("left");
+    static const QLatin1String rightKeyword("right");
+    const QChar brace    = side == ParenthesisInfo::LEFT ? '{' : '}';
+    const QChar crochet  = side == ParenthesisInfo::LEFT ? '[' : ']';
+    const QChar parenthesis = side == ParenthesisInfo::LEFT ? '(' : ')';
+
+    int position = 0;
+    while(position < text.length())
+    {
+        int type = side;
+        int length = side == ParenthesisInfo::LEFT ? matchDelimiterCommand(text, position, leftKeyword, 4)
+                                                   : matchDelimiterCommand(text, position, rightKeyword, 5);
+        if(!length)
+        {
+            length = 1;
+            QChar c = text.at(position);
+            if(c == brace)
+            {
+                type = ParenthesisInfo::LEFT_BRACE + side;
+            }
+            else if(c == crochet)
+            {
+                type = ParenthesisInfo::LEFT_CROCHET + side;
+            }
+            else if(c == parenthesis)
+            {
+                type = ParenthesisInfo::LEFT_PARENTHESIS + side;
+            }
+            else
+            {
+                ++position;
+                continue;
+            }
+        }
+        if(   characterStates[position] != SyntaxHighlighter::Verbatim
+           && characterStates[position] != SyntaxHighlighter::Comment)
+        {
+            ParenthesisInfo info;
+            info.type     = type;
+            info.position = position;
+            info.length   = length;
+            blockData->insertPar( info );
+        }
+        position += length;
+    }
+}
+
+/**
+ * @brief harvestSymbols append prefix + argument + "}" for each occurence of command{argument} in text,
+ * or the bare argument if prefix is empty
+ */
+static void harvestSymbols(const QString & text, QLatin1String command, int commandLength, QLatin1String prefix, QStringList * symbols)
+{
+    int index = text.indexOf(command);
+    while(index != -1)
+    {
+        int closingBrace = text.indexOf('}', index + commandLength);
+        if(closingBrace == -1)
+        {
+            return;
+        }
+        QString symbol = text.mid(index + commandLength, closingBrace - index - commandLength);
+        if(*prefix.latin1())
+        {
+            symbol = prefix + symbol + QLatin1Char('}');
+        }
+        symbols->append(symbol);
+        index = text.indexOf(command, closingBrace);
+    }
+}
+
+static bool hasSameNames(const QVector<LatexBlockInfo> & first, const QVector<LatexBlockInfo> & second)
+{
+    for(int i = 0; i < first.count(); ++i)
+    {
+        if(first.at(i).name != second.at(i).name)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool hasSameStructure(const QVector<LatexBlockInfo> & first, const QVector<LatexBlockInfo> & second)
+{
+    if(first.count() != second.count())
+    {
+        return false;
+    }
+    for(int i = 0; i < first.count(); ++i)
+    {
+        if(!first.at(i).hasSameStructure(second.at(i)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void SyntaxHighlighter::highlightBlock(const QString &text)
 {
     //qDebug()<<"begin highlight block "<<currentBlock().blockNumber();
-    BlockData *blockData = new BlockData(text.length());
-    setCurrentBlockUserData(blockData);
+    // the block data is reused between two highlights of the same block to avoid allocations
+    BlockData *blockData = static_cast<BlockData *>(currentBlockUserData());
+    QVector<LatexBlockInfo> previousLatexBlocks;
+    if(blockData)
+    {
+        previousLatexBlocks = blockData->latexblocks();
+        blockData->reset(text.length());
+    }
+    else
+    {
+        blockData = new BlockData(text.length());
+        setCurrentBlockUserData(blockData);
+    }
     QTextBlock previousBlock = currentBlock().previous();
     if(previousBlock.isValid())
     {
@@ -116,11 +317,11 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
 
     if(_widgetFile->file()->format() == File::BIBTEX)
     {
-        QTextCharFormat formatBibTitle = ConfigManager::Instance.getTextCharFormats("bibtex/command");
-        QTextCharFormat formatBibKeywords = ConfigManager::Instance.getTextCharFormats("bibtex/keyword");
-        QTextCharFormat formatBibString = ConfigManager::Instance.getTextCharFormats("bibtex/string");
-        QTextCharFormat formatBibQuotes = ConfigManager::Instance.getTextCharFormats("bibtex/quote");
-        QTextCharFormat formatComment = ConfigManager::Instance.getTextCharFormats("comment");
+        const QTextCharFormat & formatBibTitle = ConfigManager::Instance.textCharFormat(_formatBibTitle);
+        const QTextCharFormat & formatBibKeywords = ConfigManager::Instance.textCharFormat(_formatBibKeywords);
+        const QTextCharFormat & formatBibString = ConfigManager::Instance.textCharFormat(_formatBibString);
+        const QTextCharFormat & formatBibQuotes = ConfigManager::Instance.textCharFormat(_formatBibQuotes);
+        const QTextCharFormat & formatComment = ConfigManager::Instance.textCharFormat(_formatComment);
 
 
         QString patternBibTitle = "@[a-zA-Z\\-_]+";
@@ -153,42 +354,34 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
 
 
 
-    QTextCharFormat spellingErrorFormat = ConfigManager::Instance.getTextCharFormats("normal");
-    spellingErrorFormat.setFontUnderline(true);
-    spellingErrorFormat.setUnderlineColor(QColor(Qt::red));
-    spellingErrorFormat.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
-
-
-
-    QTextCharFormat formatNormal = ConfigManager::Instance.getTextCharFormats("normal");
-    QTextCharFormat formatCommand = ConfigManager::Instance.getTextCharFormats("command");
-    QTextCharFormat formatCommandInMathMode = ConfigManager::Instance.getTextCharFormats("command-in-math-mode");
-    QTextCharFormat formatOption = ConfigManager::Instance.getTextCharFormats("option");
-    QTextCharFormat formatComment = ConfigManager::Instance.getTextCharFormats("comment");
-    QTextCharFormat formatMath = ConfigManager::Instance.getTextCharFormats("math");
-    QTextCharFormat formatOther = ConfigManager::Instance.getTextCharFormats("other");
-    QTextCharFormat formatVerbatim = formatOther;
-    QTextCharFormat formatArgument;
-    QTextCharFormat formatArgumentDelimiter = formatArgument;
-#if QT_VERSION > 0x050000
-                    formatArgumentDelimiter.setFontStretch(1);
-#endif
-                    formatArgumentDelimiter.setFontLetterSpacing(10);
-                    formatArgumentDelimiter.setForeground(QBrush(QColor(0,0,0,0)));
+    const QTextCharFormat & formatNormal = ConfigManager::Instance.textCharFormat(ConfigManager::NormalFormat);
+    const QTextCharFormat & formatCommand = ConfigManager::Instance.textCharFormat(_formatCommand);
+    const QTextCharFormat & formatCommandInMathMode = ConfigManager::Instance.textCharFormat(_formatCommandInMathMode);
+    const QTextCharFormat & formatOption = ConfigManager::Instance.textCharFormat(_formatOption);
+    const QTextCharFormat & formatComment = ConfigManager::Instance.textCharFormat(_formatComment);
+    const QTextCharFormat & formatMath = ConfigManager::Instance.textCharFormat(_formatMath);
+    const QTextCharFormat & formatOther = ConfigManager::Instance.textCharFormat(_formatOther);
+    const QTextCharFormat & formatVerbatim = formatOther;
+    const QTextCharFormat formatArgument;
+    const QTextCharFormat & formatArgumentDelimiter = _argumentDelimiterFormat;
 
      setFormat(0, text.size(), formatNormal);
 
 
-QString currentEnvironment = blockData->blockStartingState.environment;
-State state = intToState(blockData->blockStartingState.state);
-State previousState = intToState(blockData->blockStartingState.previousState);
-State stateAfterOption = intToState(blockData->blockStartingState.stateAfterOption);
-State stateAfterArguments = intToState(blockData->blockStartingState.stateAfterArguments);
+BlockState endingState = *blockData->blockStartingState;
+_characterStates.fill(Text, blockData->length());
+quint8 * characterStates = _characterStates.data();
+
+QString currentEnvironment = blockData->blockStartingState->environment;
+State state = intToState(blockData->blockStartingState->state);
+State previousState = intToState(blockData->blockStartingState->previousState);
+State stateAfterOption = intToState(blockData->blockStartingState->stateAfterOption);
+State stateAfterArguments = intToState(blockData->blockStartingState->stateAfterArguments);
 bool beginEnvironmentName = false;
 bool endEnvironmentName = false;
 bool waitingBraceArgument = false;
-QStack<int> * parenthesisLevel = &(blockData->blockEndingState.parenthesisLevel);
-QStack<int> * crocherLevel = &(blockData->blockEndingState.crocherLevel);
+QStack<int> * parenthesisLevel = &(endingState.parenthesisLevel);
+QStack<int> * crocherLevel = &(endingState.crocherLevel);
 
 int index = 0;
 QChar currentChar;
@@ -215,7 +408,7 @@ while(index < text.length())
     {
         nextChar = QChar::Null;
     }
-    if((state == Command && commandBuffer.isNull()) || state == Verbatim || (state == Command && !commandBuffer.compare("verb") && QString(currentChar).contains(QRegExp("[^a-zA-Z]"))))
+    if((state == Command && commandBuffer.isNull()) || state == Verbatim || (state == Command && !commandBuffer.compare("verb") && !isCommandLetter(currentChar)))
     {
         escapedChar = true;
     }
@@ -238,7 +431,7 @@ while(index < text.length())
             {
                 int tmp = index + 7;
                 QString argument;
-                while(tmp + 1 < text.length() && QString(text.at(tmp + 1)).contains(QRegExp("[a-zA-Z0-9 ]")))
+                while(tmp + 1 < text.length() && isArgumentCharacter(text.at(tmp + 1)))
                 {
                     argument += text.at(tmp + 1);
                     ++tmp;
@@ -249,7 +442,7 @@ while(index < text.length())
                     setFormat(index, 8, formatArgumentDelimiter);
                     for(int idx = index; idx < tmp + 4; ++idx)
                     {
-                        blockData->characterData[idx].state = CompletionArgument;
+                        characterStates[idx] = CompletionArgument;
                     }
                     setFormat(index + 8, argument.length(), formatArgument);
                     setFormat(tmp + 1, 3, formatArgumentDelimiter);
@@ -265,19 +458,19 @@ while(index < text.length())
         setFormat(index, text.size() - index, formatComment);
         for(int comment_idx = index; comment_idx < text.size(); ++comment_idx)
         {
-            blockData->characterData[comment_idx].state = Comment;
+            characterStates[comment_idx] = Comment;
         }
         break;
     }
     if(currentEnvironment == "comment")
     {
-        int end = text.indexOf(QRegExp("\\\\end\\{comment\\}"), index);
+        int end = text.indexOf(QLatin1String("\\end{comment}"), index);
         if(end == -1)
         {
             setFormat(index, text.size() - index, formatComment);
             for(int comment_idx = index; comment_idx < text.size(); ++comment_idx)
             {
-                blockData->characterData[comment_idx].state = Comment;
+                characterStates[comment_idx] = Comment;
             }
             break;
         }
@@ -286,7 +479,7 @@ while(index < text.length())
             setFormat(index, end, formatComment);
             for(int comment_idx = index; comment_idx < end; ++comment_idx)
             {
-                blockData->characterData[comment_idx].state = Comment;
+                characterStates[comment_idx] = Comment;
             }
             index = end;
             currentEnvironment = "";
@@ -382,7 +575,7 @@ while(index < text.length())
             {
                 currentEnvironment = environmentNameBuffer;
                 environmentNameBuffer = "";
-                if(mathEnvironments.contains(currentEnvironment))
+                if(_mathEnvironmentSet.contains(currentEnvironment))
                 {
                     state = Math;
                 }
@@ -390,7 +583,7 @@ while(index < text.length())
             else
             if(!endEnvironmentNameBuffer.isEmpty())
             {
-                if(mathEnvironments.contains(endEnvironmentNameBuffer))// && endEnvironmentNameBuffer == currentEnvironment)
+                if(_mathEnvironmentSet.contains(endEnvironmentNameBuffer))// && endEnvironmentNameBuffer == currentEnvironment)
                 {
                     state = Text;
                     overrideCurrentState = Math;
@@ -489,7 +682,7 @@ while(index < text.length())
         }
         break;
     case Command:
-        if(commandBuffer.isNull() && QString(currentChar).contains(QRegExp("[^a-zA-Z]")))
+        if(commandBuffer.isNull() && !isCommandLetter(currentChar))
         {
             if(previousState == Math)
             {
@@ -512,7 +705,7 @@ while(index < text.length())
                 setFormat(index, 1, formatCommandInMathMode);
             }
             //go to the next index;
-            blockData->characterData[index].state = state;
+            characterStates[index] = state;
             ++index;
             if(index < text.length())
             {
@@ -523,7 +716,7 @@ while(index < text.length())
                 break;
             }
         }
-        if(QString(currentChar).contains(QRegExp("[^a-zA-Z]")))
+        if(!isCommandLetter(currentChar))
         {
             if(!commandBuffer.compare("verb"))
             {
@@ -564,7 +757,7 @@ while(index < text.length())
             {
                 parenthesisLevel->top() -= 1;
             }
-            if(textBlockCommands.contains(commandBuffer))
+            if(_textBlockCommandSet.contains(commandBuffer))
             {
                 crocherLevel->push(0);
                 state = Option;
@@ -574,7 +767,7 @@ while(index < text.length())
                 setCharacterState = false;
             }
             else
-            if(otherBlockCommands.contains(commandBuffer))
+            if(_otherBlockCommandSet.contains(commandBuffer))
             {
                 crocherLevel->push(0);
                 state = Option;
@@ -602,7 +795,7 @@ while(index < text.length())
                     setCharacterState = false;
                 }
             }
-            if(!commandsWithOptions.contains(commandBuffer))
+            if(!_commandsWithOptionSet.contains(commandBuffer))
             {
                 crocherLevel->pop();
                 state = stateAfterOption;
@@ -658,11 +851,11 @@ while(index < text.length())
         {
             if(overrideCurrentState != -1)
             {
-                blockData->characterData[index].state = overrideCurrentState;
+                characterStates[index] = overrideCurrentState;
             }
             else
             {
-                blockData->characterData[index].state = state;
+                characterStates[index] = state;
             }
         }
         ++index;
@@ -680,8 +873,8 @@ while(index < text.length())
 int dollarPos = text.indexOf( '$' );
 while ( dollarPos != -1 )
 {
-    if(   blockData->characterData[dollarPos].state != Verbatim
-       && blockData->characterData[dollarPos].state != Command)
+    if(   characterStates[dollarPos] != Verbatim
+       && characterStates[dollarPos] != Command)
     {
         blockData->insertDollar(dollarPos);
     }
@@ -689,258 +882,151 @@ while ( dollarPos != -1 )
 }
 
 
-int leftPos;/* = text.indexOf( '{' );
-while ( leftPos != -1 )
-{
-    if(   blockData->characterData[leftPos].state != Verbatim
-       && blockData->characterData[leftPos].state != Command)
-    {
-        ParenthesisInfo *info = new ParenthesisInfo;
-        info->type = ParenthesisInfo::LEFT_BRACE;
-        info->position = leftPos;
-
-        blockData->insertPar( info );
-    }
-  leftPos = text.indexOf( '{', leftPos+1 );
-}
-
-leftPos = text.indexOf( '[' );
-while ( leftPos != -1 )
-{
-   if(   blockData->characterData[leftPos].state != Verbatim
-      && blockData->characterData[leftPos].state != Command)
-   {
-       ParenthesisInfo *info = new ParenthesisInfo;
-       info->type = ParenthesisInfo::LEFT_CROCHET;
-       info->position = leftPos;
-
-       blockData->insertPar( info );
-   }
- leftPos = text.indexOf( '[', leftPos+1 );
-}
-*/
+scanParentheses(text, characterStates, blockData, ParenthesisInfo::LEFT);
+scanParentheses(text, characterStates, blockData, ParenthesisInfo::RIGHT);
 
-QRegExp leftPattern("(\\\\left[\\\\]{0,1}[^a-zA-Z\\\\]|\\{|\\[|\\()");
-leftPos = text.indexOf( leftPattern );
+int leftPos = text.indexOf(QLatin1String("\\begin{"));
 while ( leftPos != -1 )
 {
-    if(   blockData->characterData[leftPos].state != Verbatim
-      && blockData->characterData[leftPos].state != Comment)
-    {
-    ParenthesisInfo *info = new ParenthesisInfo;
-    QString left = leftPattern.capturedTexts().at(1);
-    info->position = leftPos;
-    info->length = leftPattern.matchedLength();
-    if(!left.compare("{"))
+    int closingBrace = text.indexOf('}', leftPos + 7);
+    if(closingBrace == -1)
     {
-        info->type = ParenthesisInfo::LEFT_BRACE;
-    }
-    else if(!left.compare("["))
-    {
-        info->type = ParenthesisInfo::LEFT_CROCHET;
-    }
-    else if(!left.compare("("))
-    {
-        info->type = ParenthesisInfo::LEFT_PARENTHESIS;
+        break;
     }
-    else
+    if(characterStates[leftPos] != Verbatim &&
+            characterStates[leftPos] != Comment)
     {
-        info->type = ParenthesisInfo::LEFT;
-        //info->length += 2;
-    }
-    leftPos += info->length;
+        LatexBlockInfo info;
+        info.type        = LatexBlockInfo::ENVIRONEMENT_BEGIN;
+        info.position    = leftPos;
+        info.blockNumber = currentBlock().blockNumber();
+        info.name        = text.mid(leftPos + 7, closingBrace - leftPos - 7);
 
-    blockData->insertPar( info );
-    }
-    else
-    {
-        leftPos += leftPattern.matchedLength();
-    }
- leftPos = text.indexOf( leftPattern, leftPos );
-}
-QRegExp rightPattern("(\\\\right[\\\\]{0,1}[^a-zA-Z\\\\]|\\}|\\]|\\))");
-int rightPos = text.indexOf( rightPattern );
-while ( rightPos != -1 )
-{
-    if(   blockData->characterData[rightPos].state != Verbatim
-          && blockData->characterData[rightPos].state != Comment
-          )
-    {
-        ParenthesisInfo *info = new ParenthesisInfo;
-        QString right = rightPattern.capturedTexts().at(1);
-        info->length = rightPattern.matchedLength();
-        info->position = rightPos;
-        if(!right.compare("}"))
-        {
-            info->type = ParenthesisInfo::RIGHT_BRACE;
-        }
-        else if(!right.compare("]"))
-        {
-            info->type = ParenthesisInfo::RIGHT_CROCHET;
-        }
-        else if(!right.compare(")"))
-        {
-            info->type = ParenthesisInfo::RIGHT_PARENTHESIS;
-        }
-        else
+        if(!info.name.compare("document"))
         {
-            info->type = ParenthesisInfo::RIGHT;
-            //info->length++;
+            LatexBlockInfo infoSection;
+            infoSection.type         = LatexBlockInfo::SECTION;
+            infoSection.position     = info.position;
+            infoSection.blockNumber  = info.blockNumber;
+            infoSection.sectionLevel = LatexBlockInfo::LEVEL_DOCUMENT;
+            infoSection.name         = "Document";
+            blockData->insertLat( infoSection );
         }
-        rightPos += info->length;
-        blockData->insertPar( info );
-    }
-    else
-    {
-        rightPos += rightPattern.matchedLength();
+        blockData->insertLat( info );
     }
-    rightPos = text.indexOf( rightPattern, rightPos);
+    leftPos = text.indexOf(QLatin1String("\\begin{"), leftPos+1 );
 }
 
-/*
-
-int rightPos = text.indexOf('}');
-while ( rightPos != -1 )
-{
-    if(   blockData->characterData[rightPos].state != Verbatim
-       && blockData->characterData[rightPos].state != Command)
-    {
-        ParenthesisInfo *info = new ParenthesisInfo;
-        info->type = ParenthesisInfo::RIGHT_BRACE;
-        info->position = rightPos;
-
-        blockData->insertPar( info );
-    }
-    rightPos = text.indexOf( '}', rightPos+1 );
-}
-rightPos = text.indexOf(']');
+int rightPos = text.indexOf(QLatin1String("\\end{"));
 while ( rightPos != -1 )
 {
-    if(   blockData->characterData[rightPos].state != Verbatim
-       && blockData->characterData[rightPos].state != Command)
+    int closingBrace = text.indexOf('}', rightPos + 5);
+    if(closingBrace == -1)
     {
-        ParenthesisInfo *info = new ParenthesisInfo;
-        info->type = ParenthesisInfo::RIGHT_CROCHET;
-        info->position = rightPos;
-
-        blockData->insertPar( info );
+        break;
     }
-    rightPos = text.indexOf( ']', rightPos+1 );
-}
-*/
-
-
-QRegExp beginPattern("\\\\begin\\{([^\\}]*)\\}");
-leftPos = text.indexOf( beginPattern );
-while ( leftPos != -1 )
-{
-    if(blockData->characterData[leftPos].state != Verbatim &&
-            blockData->characterData[leftPos].state != Comment)
+    if(characterStates[rightPos] != Verbatim &&
+            characterStates[rightPos] != Comment)
     {
-        LatexBlockInfo *info = new LatexBlockInfo;
-        info->type        = LatexBlockInfo::ENVIRONEMENT_BEGIN;
-        info->position    = leftPos;
-        info->blockNumber = currentBlock().blockNumber();
-        info->name        = beginPattern.capturedTexts().at(1);
+        LatexBlockInfo info;
+        info.type        = LatexBlockInfo::ENVIRONEMENT_END;
+        info.position    = closingBrace + 2;
+        info.blockNumber = currentBlock().blockNumber();
+        info.name        = text.mid(rightPos + 5, closingBrace - rightPos - 5);
 
-        if(!info->name.compare("document"))
-        {
-            LatexBlockInfo *infoSection = new LatexBlockInfo;
-            infoSection->type         = LatexBlockInfo::SECTION;
-            infoSection->position     = info->position;
-            infoSection->blockNumber  = info->blockNumber;
-            infoSection->sectionLevel = LatexBlockInfo::LEVEL_DOCUMENT;
-            infoSection->name         = "Document";
-            blockData->insertLat( infoSection );
-        }
         blockData->insertLat( info );
     }
-    leftPos = text.indexOf(beginPattern, leftPos+1 );
+    rightPos = text.indexOf(QLatin1String("\\end{"), rightPos+1 );
 }
 
-QRegExp endPattern("\\\\end\\{([^\\}]*)\\}");
-rightPos = text.indexOf(endPattern);
+// \\((sub)*)(chapter|paragraph|section)\{([^\}]*)\}
+rightPos = text.indexOf('\\');
 while ( rightPos != -1 )
 {
-    if(blockData->characterData[rightPos].state != Verbatim &&
-            blockData->characterData[rightPos].state != Comment)
+    int idx = rightPos + 1;
+    int subLength = 0;
+    while(text.midRef(idx, 3) == QLatin1String("sub"))
     {
-        LatexBlockInfo *info = new LatexBlockInfo;
-        info->type        = LatexBlockInfo::ENVIRONEMENT_END;
-        info->position    = rightPos + endPattern.matchedLength() + 1;
-        info->blockNumber = currentBlock().blockNumber();
-        info->name        = endPattern.capturedTexts().at(1);
-
-        blockData->insertLat( info );
+        idx += 3;
+        subLength += 3;
     }
-    rightPos = text.indexOf(endPattern, rightPos+1 );
-}
-
-QRegExp sectionsPattern("\\\\((sub)*)(chapter|paragraph|section)\\{([^\\}]*)\\}");
-rightPos = text.indexOf(sectionsPattern);
-while ( rightPos != -1 )
-{
-    LatexBlockInfo *info = new LatexBlockInfo;
-    info->type          = LatexBlockInfo::SECTION;
-    info->position      = rightPos;
-    info->blockNumber   = currentBlock().blockNumber();
-    info->name          = sectionsPattern.capturedTexts().at(4);
-    QString sectionType(sectionsPattern.capturedTexts().at(3));
-    if(!sectionType.compare("section"))
+    int sectionLevel = -1;
+    if(text.midRef(idx, 7) == QLatin1String("section"))
     {
-        int subLength = sectionsPattern.capturedTexts().at(1).length();
+        idx += 7;
         switch(int(subLength/3))
         {
         default:
         case 0:
-            info->sectionLevel = LatexBlockInfo::LEVEL_SECTION;
+            sectionLevel = LatexBlockInfo::LEVEL_SECTION;
             break;
         case 1:
-            info->sectionLevel = LatexBlockInfo::LEVEL_SUBSECTION;
+            sectionLevel = LatexBlockInfo::LEVEL_SUBSECTION;
             break;
         case 2:
-            info->sectionLevel = LatexBlockInfo::LEVEL_SUBSECTION;
+            sectionLevel = LatexBlockInfo::LEVEL_SUBSUBSECTION;
             break;
         }
     }
-    else if(!sectionType.compare("chapter"))
+    else if(text.midRef(idx, 7) == QLatin1String("chapter"))
     {
-        info->sectionLevel = LatexBlockInfo::LEVEL_CHAPTER;
+        idx += 7;
+        sectionLevel = LatexBlockInfo::LEVEL_CHAPTER;
     }
-    else
+    else if(text.midRef(idx, 9) == QLatin1String("paragraph"))
     {
-        info->sectionLevel = LatexBlockInfo::LEVEL_PARAGRAPH;
+        idx += 9;
+        sectionLevel = LatexBlockInfo::LEVEL_PARAGRAPH;
     }
+    if(sectionLevel != -1 && idx < text.length() && text.at(idx) == '{')
+    {
+        int closingBrace = text.indexOf('}', idx + 1);
+        if(closingBrace == -1)
+        {
+            break;
+        }
+        LatexBlockInfo info;
+        info.type          = LatexBlockInfo::SECTION;
+        info.position      = rightPos;
+        info.blockNumber   = currentBlock().blockNumber();
+        info.name          = text.mid(idx + 1, closingBrace - idx - 1);
+        info.sectionLevel  = sectionLevel;
 
-  blockData->insertLat( info );
-  rightPos = text.indexOf(sectionsPattern, rightPos+1 );
+        blockData->insertLat( info );
+    }
+    rightPos = text.indexOf('\\', rightPos+1 );
 }
 
 
+blockData->characterData.assign(characterStates, blockData->length());
 
+//*****************************************************************************
+// Symbols : labels, custom commands and bibitems used by the completion
 
-
-
-
-
+{
+    QStringList symbols;
+    harvestSymbols(text, QLatin1String("\\label{"), 7, QLatin1String("\\ref{"), &symbols);
+    harvestSymbols(text, QLatin1String("\\bibitem{"), 9, QLatin1String("\\cite{"), &symbols);
+    harvestSymbols(text, QLatin1String("\\newcommand{"), 12, QLatin1String(""), &symbols);
+    harvestSymbols(text, QLatin1String("\\renewcommand{"), 14, QLatin1String(""), &symbols);
+    blockData->setSymbols(_symbolTable.data(), symbols);
+}
 
 //*****************************************************************************
 // Spell Checker
 
 if (_widgetFile->spellChecker())
 {
+    SpellChecker * spellChecker = _widgetFile->spellChecker();
     QString buffer;
     QChar ch;
     int i=0;
-    int check;
-    QByteArray encodedString;
-    QTextCodec *codec = QTextCodec::codecForName(_widgetFile->spellCheckerEncoding().toLatin1());
 
     while (i < text.length())
     {
         buffer = QString::null;
         ch = text.at( i );
-        while ((blockData->characterData[i].state == Text) && (!isWordSeparator(ch)))
+        while ((characterStates[i] == Text) && (!isWordSeparator(ch)))
         {
               buffer += ch;
               i++;
@@ -949,18 +1035,29 @@ if (_widgetFile->spellChecker())
         }
         if ((buffer.length() > 1))// && (!ignoredwordList.contains(buffer)) && (!hardignoredwordList.contains(buffer)))
         {
-            encodedString = codec->fromUnicode(buffer);
-            check = _widgetFile->spellChecker()->spell(encodedString.data());
-            if (!check)
+            SpellChecker::WordStatus status = spellChecker->wordStatus(buffer);
+            if (status == SpellChecker::Unknown)
+            {
+                // the word is checked in background, the block is highlighted again when the result is available
+                _blocksWaitingForWords[buffer].insert(currentBlock().blockNumber());
+            }
+            else if (status == SpellChecker::Misspelled)
             {
-                for(int buffer_idx = 0; buffer_idx < buffer.length(); ++buffer_idx)
+                // the underline is merged once per run of characters sharing the same format
+                int runStart = i - buffer.length();
+                while(runStart < i)
                 {
-                    QTextCharFormat f = format(i - buffer.length() + buffer_idx);
-                    f.setFontUnderline(true);
-                    f.setUnderlineColor(QColor(Qt::red));
-                    setFormat(i - buffer.length() + buffer_idx, 1, f);
-                    blockData->characterData[i - buffer.length() + buffer_idx].misspelled = true;
+                    QTextCharFormat f = format(runStart);
+                    int runEnd = runStart + 1;
+                    while(runEnd < i && format(runEnd) == f)
+                    {
+                        ++runEnd;
+                    }
+                    f.merge(_spellingErrorFormat);
+                    setFormat(runStart, runEnd - runStart, f);
+                    runStart = runEnd;
                 }
+                blockData->characterData.setMisspelled(i - buffer.length(), buffer.length());
             }
         }
         i++;
@@ -974,11 +1071,12 @@ if(state == Command)
     state = previousState;
 }
 
-blockData->blockEndingState.state               = state;
-blockData->blockEndingState.previousState       = previousState;
-blockData->blockEndingState.stateAfterOption    = stateAfterOption;
-blockData->blockEndingState.stateAfterArguments    = stateAfterArguments;
-blockData->blockEndingState.environment    = currentEnvironment;
+endingState.state               = state;
+endingState.previousState       = previousState;
+endingState.stateAfterOption    = stateAfterOption;
+endingState.stateAfterArguments    = stateAfterArguments;
+endingState.environment    = currentEnvironment;
+blockData->blockEndingState = BlockState::intern(endingState);
 
 // Check if we need to rehighlight the next block
 QTextBlock nextBlock = this->currentBlock().next();
@@ -992,16 +1090,33 @@ if(!nextBlock.isValid())
     }
 
 }
+if(!hasSameStructure(previousLatexBlocks, blockData->latexblocks()))
+{
+    emit structureChanged();
+}
+else if(!hasSameNames(previousLatexBlocks, blockData->latexblocks()))
+{
+    emit structureRenamed();
+}
+
 if(nextBlock.isValid())
 {
     BlockData * nextData = static_cast<BlockData *>(nextBlock.userData());
-    BlockState nextStartingData;
-    if(nextData && (nextStartingData = nextData->blockStartingState).state > -1)
+    if(nextData && nextData->blockStartingState->state > -1)
     {
-        if(!nextStartingData.equals(blockData->blockEndingState))
+        // interned states are equal if and only if they share the same address
+        if(nextData->blockStartingState != blockData->blockEndingState)
         {
-            //change the currentBlock state to request the update of the next block
-            setCurrentBlockState(-currentBlockState());
+            if(!_highlightingPendingBlocks && isBlockVisible(nextBlock))
+            {
+                //change the currentBlock state to request the update of the next block
+                setCurrentBlockState(-currentBlockState());
+            }
+            else
+            {
+                // the rest of the cascade is done in background so that typing never waits for off-screen blocks
+                deferHighlighting(nextBlock.blockNumber());
+            }
         }
 
     }
@@ -1021,6 +1136,185 @@ void SyntaxHighlighter::highlightExpression(const QString &text, const QString &
 
 bool SyntaxHighlighter::isWordSeparator(QChar c) const
 {
-    return QString(c).contains(QRegExp(QString::fromUtf8("[^\\w]"),Qt::CaseInsensitive));
+    if(c.unicode() < 128)
+    {
+        return !(characterClasses.at(c.unicode()) & WordClass);
+    }
+    return !c.isLetterOrNumber() && !c.isMark();
+}
+
+int SyntaxHighlighter::highlightedBlockCount() const
+{
+    if(_pendingBlocks.isEmpty())
+    {
+        return document()->blockCount();
+    }
+    return _pendingBlocks.first();
+}
+
+bool SyntaxHighlighter::isBlockVisible(const QTextBlock &block) const
+{
+    QList<WidgetTextEdit *> editors;
+    editors << _widgetFile->widgetTextEdit() << _widgetFile->widgetTextEdit2();
+    foreach(WidgetTextEdit * editor, editors)
+    {
+        if(!editor || !editor->isVisible() || editor->document() != document())
+        {
+            continue;
+        }
+        if(block.blockNumber() < editor->firstVisibleBlockNumber())
+        {
+            continue;
+        }
+        if(editor->blockTop(block) + editor->contentOffsetTop() <= editor->viewport()->height())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SyntaxHighlighter::deferHighlighting(int blockNumber)
+{
+    QList<int>::iterator it = std::lower_bound(_pendingBlocks.begin(), _pendingBlocks.end(), blockNumber);
+    if(it == _pendingBlocks.end() || *it != blockNumber)
+    {
+        _pendingBlocks.insert(it, blockNumber);
+    }
+    if(!_highlightingPendingBlocks)
+    {
+        emit highlightedBlockCountChanged(highlightedBlockCount());
+        _pendingTimer.start();
+    }
 }
 
+int SyntaxHighlighter::firstVisiblePendingBlock() const
+{
+    for(int index = 0; index < _pendingBlocks.count(); ++index)
+    {
+        QTextBlock block = document()->findBlockByNumber(_pendingBlocks.at(index));
+        if(block.isValid() && isBlockVisible(block))
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void SyntaxHighlighter::highlightPendingBlocks()
+{
+    QElapsedTimer timer;
+    timer.start();
+    _highlightingPendingBlocks = true;
+    while(!_pendingBlocks.isEmpty())
+    {
+        // the visible blocks are always highlighted, the others only during the time slice
+        int index = 0;
+        if(timer.elapsed() >= HIGHLIGHT_TIME_SLICE)
+        {
+            index = firstVisiblePendingBlock();
+            if(index == -1)
+            {
+                break;
+            }
+        }
+        QTextBlock block = document()->findBlockByNumber(_pendingBlocks.takeAt(index));
+        if(block.isValid())
+        {
+            // if its ending state changes, the next block is added to the pending blocks
+            rehighlightBlock(block);
+        }
+    }
+    _highlightingPendingBlocks = false;
+
+    emit highlightedBlockCountChanged(highlightedBlockCount());
+    if(!_pendingBlocks.isEmpty())
+    {
+        _pendingTimer.start();
+    }
+    else
+    {
+        emit highlightingCompleted();
+    }
+}
+
+void SyntaxHighlighter::onBlockCountChanged(int newBlockCount)
+{
+    // if lines are removed before a pending block, its number has moved up:
+    // restart earlier (highlighting a few blocks twice is harmless, skipping some is not)
+    if(!_pendingBlocks.isEmpty() && newBlockCount < _lastBlockCount)
+    {
+        int removed = _lastBlockCount - newBlockCount;
+        QList<int> pendingBlocks;
+        foreach(int blockNumber, _pendingBlocks)
+        {
+            blockNumber = qMax(0, blockNumber - removed);
+            if(pendingBlocks.isEmpty() || pendingBlocks.last() != blockNumber)
+            {
+                pendingBlocks << blockNumber;
+            }
+        }
+        _pendingBlocks = pendingBlocks;
+    }
+    _lastBlockCount = newBlockCount;
+}
+
+void SyntaxHighlighter::onWordsChecked(QStringList words)
+{
+    if(_blocksWaitingForWords.isEmpty())
+    {
+        return;
+    }
+    // block numbers may be outdated if lines were inserted in the meantime,
+    // highlighting an extra block is harmless and missed words are requested again
+    QSet<int> blocks;
+    foreach(const QString & word, words)
+    {
+        QHash<QString, QSet<int> >::iterator it = _blocksWaitingForWords.find(word);
+        if(it != _blocksWaitingForWords.end())
+        {
+            blocks.unite(it.value());
+            _blocksWaitingForWords.erase(it);
+        }
+    }
+    foreach(int blockNumber, blocks)
+    {
+        QTextBlock block = document()->findBlockByNumber(blockNumber);
+        if(!block.isValid())
+        {
+            continue;
+        }
+        if(isBlockVisible(block))
+        {
+            rehighlightBlock(block);
+            continue;
+        }
+        QList<int>::iterator it = std::lower_bound(_spellingBlocks.begin(), _spellingBlocks.end(), blockNumber);
+        if(it == _spellingBlocks.end() || *it != blockNumber)
+        {
+            _spellingBlocks.insert(it, blockNumber);
+        }
+    }
+    if(!_spellingBlocks.isEmpty())
+    {
+        _spellingTimer.start();
+    }
+}
+
+void SyntaxHighlighter::highlightSpellingBlocks()
+{
+    QElapsedTimer timer;
+    timer.start();
+    while(!_spellingBlocks.isEmpty() && timer.elapsed() < HIGHLIGHT_TIME_SLICE)
+    {
+        QTextBlock block = document()->findBlockByNumber(_spellingBlocks.takeFirst());
+        if(block.isValid())
+        {
+            rehighlightBlock(block);
+        }
+    }
+    if(!_spellingBlocks.isEmpty())
+    {
+        _spellingTimer.start();
+    }
+}
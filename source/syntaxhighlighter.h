@@ -24,12 +24,26 @@
 
 #include <QSyntaxHighlighter>
 #include <QStringList>
+#include <QByteArray>
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+#include <QExplicitlySharedDataPointer>
+#include "symboltable.h"
 
 class QTextEdit;
 class WidgetFile;
 
+/**
+ * @brief HIGHLIGHT_TIME_SLICE is the time (in ms) given to each batch of the
+ * background highlighting of the blocks that are not visible.
+ */
+#define HIGHLIGHT_TIME_SLICE 8
+
 class SyntaxHighlighter : public QSyntaxHighlighter
 {
+    Q_OBJECT
 public:
     SyntaxHighlighter(WidgetFile * widgetFile);
     ~SyntaxHighlighter();
@@ -45,13 +59,117 @@ public:
     static QStringList mathEnvironments;
 
     typedef enum State { Text, Other, Math, Command, Option, Comment, Verbatim, CompletionArgument } State;
+
+    /**
+     * @brief The CharacterClass enum is used by the lexer to classify ascii characters
+     * with a single table lookup instead of a regular expression.
+     */
+    typedef enum CharacterClass {
+        NoClass       = 0,
+        LetterClass   = 1 << 0, /**< [a-zA-Z] : part of a command name */
+        ArgumentClass = 1 << 1, /**< [a-zA-Z0-9 ] : part of a completion argument */
+        WordClass     = 1 << 2  /**< \w : part of a word checked by the spell checker */
+    } CharacterClass;
+    static const QByteArray characterClasses;
+
+    static bool isCommandLetter(QChar c) { return c.unicode() < 128 && (characterClasses.at(c.unicode()) & LetterClass); }
+    static bool isArgumentCharacter(QChar c) { return c.unicode() < 128 && (characterClasses.at(c.unicode()) & ArgumentClass); }
     bool isWordSeparator(QChar c) const;
+
+    /**
+     * @brief highlightedBlockCount return the watermark of the highlighting: every block
+     * before this number is highlighted with its final state, the following ones
+     * are waiting for the background pass.
+     */
+    int highlightedBlockCount() const;
+    bool isHighlightingComplete() const { return _pendingBlocks.isEmpty(); }
+
+    /**
+     * @brief symbolTable contains the labels, custom commands and bibitems of the document
+     */
+    const SymbolTable * symbolTable() const { return _symbolTable.data(); }
+
+public slots:
+    /**
+     * @brief onWordsChecked highlight again the blocks that contain the words just checked by the spell checker:
+     * the visible ones at once, the others in time slices
+     */
+    void onWordsChecked(QStringList words);
+
+signals:
+    void highlightedBlockCountChanged(int blockCount);
+    void highlightingCompleted();
+    /**
+     * @brief structureChanged is emitted when the environments or sections of a block are modified
+     */
+    void structureChanged();
+    /**
+     * @brief structureRenamed is emitted when only the names of the environments or sections of a block are modified
+     */
+    void structureRenamed();
+
+private slots:
+    void highlightPendingBlocks();
+    void highlightSpellingBlocks();
+    void onBlockCountChanged(int newBlockCount);
+
 protected:
     virtual void highlightBlock(const QString &text);
     void highlightExpression(const QString &text, const QString &pattern, const QTextCharFormat &format);
 private:
+    static QSet<QString> _textBlockCommandSet;
+    static QSet<QString> _otherBlockCommandSet;
+    static QSet<QString> _commandsWithOptionSet;
+    static QSet<QString> _mathEnvironmentSet;
+
+    bool isBlockVisible(const QTextBlock &block) const;
+    void deferHighlighting(int blockNumber);
+    int firstVisiblePendingBlock() const;
 
     WidgetFile * _widgetFile;
+    /**
+     * @brief _characterStates is the buffer where the states of the current block are computed
+     * before being run-length encoded in its BlockData.
+     */
+    QVector<quint8> _characterStates;
+    /**
+     * @brief _pendingBlocks are the blocks whose starting state changed but that have not been highlighted yet,
+     * sorted and without duplicates. Each one is the start of a cascade.
+     */
+    QList<int> _pendingBlocks;
+    int _lastBlockCount;
+    bool _highlightingPendingBlocks;
+    QTimer _pendingTimer;
+    /**
+     * @brief _blocksWaitingForWords gives for each word not checked yet the blocks highlighted while it was unknown.
+     */
+    QHash<QString, QSet<int> > _blocksWaitingForWords;
+    /**
+     * @brief _spellingBlocks are the off-screen blocks whose words have been checked,
+     * waiting to be highlighted again (sorted, without duplicates).
+     */
+    QList<int> _spellingBlocks;
+    QTimer _spellingTimer;
+    QExplicitlySharedDataPointer<SymbolTable> _symbolTable;
+    /**
+     * @brief theme format ids, resolved once in the constructor
+     */
+    int _formatCommand;
+    int _formatCommandInMathMode;
+    int _formatOption;
+    int _formatComment;
+    int _formatMath;
+    int _formatOther;
+    int _formatBibTitle;
+    int _formatBibKeywords;
+    int _formatBibString;
+    int _formatBibQuotes;
+    /**
+     * @brief _spellingErrorFormat holds the underline merged into the misspelled words,
+     * _argumentDelimiterFormat hides the delimiters of the arguments
+     */
+    QTextCharFormat _spellingErrorFormat;
+    QTextCharFormat _argumentDelimiterFormat;
 };
 
 #endif // SYNTAXHIGHLIGHTER_H
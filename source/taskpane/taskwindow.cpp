@@ -844,8 +844,8 @@ void TaskWindow::setBuilder(Builder *builder)
     {
         return;
     }
-    connect(_builder, SIGNAL(error()),this, SLOT(onError()));
-    connect(_builder, SIGNAL(success()),this, SLOT(onError()));
+    // the entries are parsed once by the builder while the output is produced
+    connect(_builder, SIGNAL(logEntryAdded(LatexLogEntry)),this, SLOT(onLogEntryAdded(LatexLogEntry)));
     //connect(_builder, SIGNAL(success()),this, SLOT(onSuccess()));
     connect(_builder, SIGNAL(started()), this, SLOT(clearContents()));
     if(_openPaneOnError)
@@ -855,41 +855,35 @@ void TaskWindow::setBuilder(Builder *builder)
 }
 
 
-void TaskWindow::onError()
+void TaskWindow::onLogEntryAdded(const LatexLogEntry &logEntry)
 {
-    LatexOutputFilter f;
-    f.setSource(_builder->getFile()->getFilename());
-    f.run(_builder->output());
-    foreach(const LatexLogEntry &logEntry, f.m_infoList)
+    if(logEntry.message.trimmed().isEmpty() && logEntry.type != LT_ERROR)
     {
-        if(logEntry.message.trimmed().isEmpty() && logEntry.type != LT_ERROR)
-        {
-            continue;
-        }
-        Task task(Task::Unknown, logEntry.message, logEntry.file, logEntry.oldline, "latex");
-        switch(logEntry.type)
-        {
-        case LT_ERROR:
-            task.type = Task::Error;
-            task.icon = QApplication::style()->standardIcon(QStyle::SP_MessageBoxCritical);
-            task.category = "error";
-            //qDebug()<<logEntry.oldline<<logEntry.logline<<task.movedLine<<task.line;
-            break;
-        case LT_WARNING:
-            task.type = Task::Warning;
-            task.icon = QIcon(QPixmap(":/data/img/warning.png"));//QApplication::style()->standardIcon(QStyle::SP_MessageBoxWarning);
-            task.category = "warning";
-            break;
-        case LT_INFO:
-        case LT_BADBOX:
-            task.type = Task::Unknown;
-            task.category = "notice";
-            //task.icon = QApplication::style()->standardIcon(QStyle::SP_MessageBoxInformation);
-            break;
-        }
-        if(_acceptedTaskCategories.contains(task.category))
-        {
-            this->addTask(task);
-        }
+        return;
+    }
+    Task task(Task::Unknown, logEntry.message, logEntry.file, logEntry.oldline, "latex");
+    switch(logEntry.type)
+    {
+    case LT_ERROR:
+        task.type = Task::Error;
+        task.icon = QApplication::style()->standardIcon(QStyle::SP_MessageBoxCritical);
+        task.category = "error";
+        //qDebug()<<logEntry.oldline<<logEntry.logline<<task.movedLine<<task.line;
+        break;
+    case LT_WARNING:
+        task.type = Task::Warning;
+        task.icon = QIcon(QPixmap(":/data/img/warning.png"));//QApplication::style()->standardIcon(QStyle::SP_MessageBoxWarning);
+        task.category = "warning";
+        break;
+    case LT_INFO:
+    case LT_BADBOX:
+        task.type = Task::Unknown;
+        task.category = "notice";
+        //task.icon = QApplication::style()->standardIcon(QStyle::SP_MessageBoxInformation);
+        break;
+    }
+    if(_acceptedTaskCategories.contains(task.category))
+    {
+        this->addTask(task);
     }
 }
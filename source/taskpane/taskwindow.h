@@ -49,6 +49,7 @@ class TaskHub;
 class Task;
 class Builder;
 class WidgetTextEdit;
+struct LatexLogEntry;
 class TaskWindowPrivate;
 
 // Show issues (warnings or errors) and open the editor on click.
@@ -100,7 +101,10 @@ public:
     void goToPrev();
 public slots:
     void clearContents();
-    void onError();
+    /**
+     * @brief onLogEntryAdded add the task of an entry of the log while the build runs
+     */
+    void onLogEntryAdded(const LatexLogEntry & logEntry);
     void popup(int flags) { emit showPage(flags); }
 
     void hide() { emit hidePage(); }
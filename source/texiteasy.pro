@@ -28,6 +28,9 @@ DEFINES += "APPLICATION_NAME=$${APPLICATION_NAME}"
 
 
 #DEFINES += DEBUG_DESTRUCTOR
+#DEFINES += DEBUG_BENCHMARK
+#DEFINES += DEBUG_PAINT
+#DEFINES += DEBUG_PDF_CACHE
 
 SOURCES += main.cpp\
         mainwindow.cpp \
@@ -100,7 +103,17 @@ SOURCES += main.cpp\
     taskpane/taskwindow.cpp \
     taskpane/task.cpp \
     qt4panecallback.cpp \
-    helpwidget.cpp
+    helpwidget.cpp \
+    benchmark.cpp \
+    spellchecker.cpp \
+    completionindex.cpp \
+    symboltable.cpp \
+    pdfrenderer.cpp \
+    pdfpagecache.cpp \
+    synctexindex.cpp \
+    synctexloader.cpp \
+    consolelog.cpp \
+    widgetconsoleview.cpp
 
 HEADERS  += mainwindow.h \
     widgetlinenumber.h \
@@ -179,7 +192,17 @@ HEADERS  += mainwindow.h \
     iplugin.h \
     ipane.h \
     qt4panecallback.h \
-    helpwidget.h
+    helpwidget.h \
+    benchmark.h \
+    spellchecker.h \
+    completionindex.h \
+    symboltable.h \
+    pdfrenderer.h \
+    pdfpagecache.h \
+    synctexindex.h \
+    synctexloader.h \
+    consolelog.h \
+    widgetconsoleview.h
 
 FORMS    += mainwindow.ui \
     dialogwelcome.ui \
@@ -28,20 +28,40 @@
 #include <QTextBlock>
 #include <QScrollBar>
 #include <QAction>
+#include <QComboBox>
+#include <QVBoxLayout>
+#include "widgetconsoleview.h"
 #include "widgetfile.h"
 #include "builder.h"
 #include "filemanager.h"
 
 WidgetConsole::WidgetConsole(WidgetFile *widgetFile) :
     _builder(0),
-    _mainWidget(new QPlainTextEdit(0)),
+    _mainWidget(new QWidget(0)),
+    _view(new WidgetConsoleView(_mainWidget)),
     _widgetFile(widgetFile)
 {
     _action = new QAction(statusbarText(), 0);
     _action->setCheckable(true);
     _height = 100;
     _collapsed = true;
-    _mainWidget->setReadOnly(true);
+
+    // same order as ConsoleLog::Filter
+    QComboBox * filter = new QComboBox(_mainWidget);
+    filter->addItem(tr("Tout"));
+    filter->addItem(tr("Erreurs"));
+    filter->addItem(tr("Warnings"));
+    filter->addItem(tr("Bad boxes"));
+    connect(filter, SIGNAL(currentIndexChanged(int)), _view, SLOT(setFilter(int)));
+    QHBoxLayout * filterLayout = new QHBoxLayout();
+    filterLayout->setContentsMargins(0, 0, 0, 0);
+    filterLayout->addStretch();
+    filterLayout->addWidget(filter);
+    QVBoxLayout * layout = new QVBoxLayout(_mainWidget);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addLayout(filterLayout);
+    layout->addWidget(_view);
     this->updateBuilder();
     connect(_widgetFile, SIGNAL(opened()), this, SLOT(updateBuilder()));
 }
@@ -74,10 +94,12 @@ void WidgetConsole::updateBuilder()
 
     connect(_builder, SIGNAL(error()),this, SLOT(onError()));
     connect(_builder, SIGNAL(success()),this, SLOT(onSuccess()));
-    connect(_builder, SIGNAL(started()), _mainWidget, SLOT(clear()));
+    connect(_builder, SIGNAL(started()), _view, SLOT(clear()));
     connect(_builder, SIGNAL(started()), this, SLOT(openMyPane()));
     connect(_builder, SIGNAL(success()), this, SLOT(closeMyPane()));
     connect(_builder, SIGNAL(outputUpdated(QString)), this, SLOT(setOutput(QString)));
+    connect(_builder, SIGNAL(outputAppended(QString)), this, SLOT(appendOutput(QString)));
+    connect(_builder, SIGNAL(logEntryAdded(LatexLogEntry)), _view, SLOT(addLogEntry(LatexLogEntry)));
 }
 
 void WidgetConsole::openMyPane()
@@ -145,16 +167,10 @@ void WidgetConsole::onSuccess()
 
 void WidgetConsole::setOutput(QString newText)
 {
-    bool atEnd = false;
-    if(_mainWidget->verticalScrollBar()->value() == _mainWidget->verticalScrollBar()->maximum())
-    {
-        atEnd = true;
-    }
-    _mainWidget->setPlainText(newText);
-    if(atEnd)
-    {
-        //qDebug()<<this->verticalScrollBar()->maximum();
-        _mainWidget->verticalScrollBar()->setValue(_mainWidget->verticalScrollBar()->maximum());
-        //this->scroll();
-    }
+    _view->setText(newText);
+}
+
+void WidgetConsole::appendOutput(QString text)
+{
+    _view->appendText(text);
 }
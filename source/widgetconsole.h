@@ -23,12 +23,12 @@
 #define WIDGETCONSOLE_H
 
 #include <QScrollArea>
-#include <QPlainTextEdit>
 
 #include "ipane.h"
 
 class Builder;
 class WidgetFile;
+class WidgetConsoleView;
 
 class WidgetConsole : public QObject, public IPane
 {
@@ -52,6 +52,7 @@ public slots:
     void onError(void);
     void onSuccess(void);
     void setOutput(QString newText);
+    void appendOutput(QString text);
 
     void openMyPane();
     void closeMyPane();
@@ -68,7 +69,11 @@ private:
     bool _collapsed;
     int _height;
     Builder * _builder;
-    QPlainTextEdit * _mainWidget;
+    /**
+     * @brief _mainWidget holds the choice of the filter above the view
+     */
+    QWidget * _mainWidget;
+    WidgetConsoleView * _view;
     WidgetFile * _widgetFile;
     QAction * _action;
     
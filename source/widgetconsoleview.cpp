@@ -0,0 +1,227 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "widgetconsoleview.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QApplication>
+#include <QClipboard>
+#include <QStringList>
+
+WidgetConsoleView::WidgetConsoleView(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    _filter(ConsoleLog::AllLines),
+    _selectionStart(-1),
+    _selectionEnd(-1)
+{
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    this->setFont(font);
+    this->viewport()->setBackgroundRole(QPalette::Base);
+    this->viewport()->setCursor(Qt::IBeamCursor);
+    this->setFocusPolicy(Qt::StrongFocus);
+}
+
+void WidgetConsoleView::clear()
+{
+    _log.clear();
+    _selectionStart = _selectionEnd = -1;
+    this->updateScrollBars();
+    this->viewport()->update();
+}
+
+void WidgetConsoleView::setText(const QString &text)
+{
+    _log.clear();
+    _selectionStart = _selectionEnd = -1;
+    this->appendText(text);
+}
+
+void WidgetConsoleView::appendText(const QString &text)
+{
+    bool atEnd = this->verticalScrollBar()->value() == this->verticalScrollBar()->maximum();
+    _log.append(text);
+    this->updateScrollBars();
+    if(atEnd)
+    {
+        this->verticalScrollBar()->setValue(this->verticalScrollBar()->maximum());
+    }
+    this->viewport()->update();
+}
+
+void WidgetConsoleView::addLogEntry(const LatexLogEntry &logEntry)
+{
+    _log.addEntry(logEntry.logline, logEntry.type);
+    if(_filter != ConsoleLog::AllLines)
+    {
+        this->updateScrollBars();
+    }
+    this->viewport()->update();
+}
+
+void WidgetConsoleView::setFilter(int filter)
+{
+    _filter = static_cast<ConsoleLog::Filter>(filter);
+    _selectionStart = _selectionEnd = -1;
+    this->updateScrollBars();
+    this->verticalScrollBar()->setValue(this->verticalScrollBar()->maximum());
+    this->viewport()->update();
+}
+
+void WidgetConsoleView::copy()
+{
+    if(_selectionStart < 0)
+    {
+        return;
+    }
+    QStringList lines;
+    int last = qMin(qMax(_selectionStart, _selectionEnd), this->rowCount() - 1);
+    for(int row = qMin(_selectionStart, _selectionEnd); row <= last; ++row)
+    {
+        lines << _log.line(this->rowLine(row));
+    }
+    QApplication::clipboard()->setText(lines.join("\n"));
+}
+
+int WidgetConsoleView::rowCount()
+{
+    if(_filter == ConsoleLog::AllLines)
+    {
+        return _log.lineCount();
+    }
+    return _log.filteredLines(_filter).count();
+}
+
+int WidgetConsoleView::rowLine(int row)
+{
+    if(_filter == ConsoleLog::AllLines)
+    {
+        return row;
+    }
+    return _log.filteredLines(_filter).at(row);
+}
+
+int WidgetConsoleView::rowAt(int y) const
+{
+    return this->verticalScrollBar()->value() + y / this->fontMetrics().lineSpacing();
+}
+
+void WidgetConsoleView::updateScrollBars()
+{
+    int lineSpacing = this->fontMetrics().lineSpacing();
+    int visibleRows = this->viewport()->height() / lineSpacing;
+    this->verticalScrollBar()->setPageStep(visibleRows);
+    this->verticalScrollBar()->setRange(0, qMax(0, this->rowCount() - visibleRows));
+    // the font has a fixed pitch, the longest line is the longest string
+    int width = _log.maximumLineLength() * this->fontMetrics().averageCharWidth();
+    this->horizontalScrollBar()->setPageStep(this->viewport()->width());
+    this->horizontalScrollBar()->setSingleStep(this->fontMetrics().averageCharWidth());
+    this->horizontalScrollBar()->setRange(0, qMax(0, width - this->viewport()->width()));
+}
+
+void WidgetConsoleView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this->viewport());
+    int lineSpacing = this->fontMetrics().lineSpacing();
+    int firstRow = this->verticalScrollBar()->value();
+    int lastRow = qMin(this->rowCount() - 1, firstRow + this->viewport()->height() / lineSpacing);
+    int left = 2 - this->horizontalScrollBar()->value();
+    int selectionFirst = qMin(_selectionStart, _selectionEnd);
+    int selectionLast = qMax(_selectionStart, _selectionEnd);
+    for(int row = firstRow; row <= lastRow; ++row)
+    {
+        int line = this->rowLine(row);
+        QRect rect(0, (row - firstRow) * lineSpacing, this->viewport()->width(), lineSpacing);
+        if(_selectionStart >= 0 && row >= selectionFirst && row <= selectionLast)
+        {
+            painter.fillRect(rect, this->palette().highlight());
+            painter.setPen(this->palette().highlightedText().color());
+        }
+        else
+        if(_log.lineType(line) != LT_NONE)
+        {
+            painter.setPen(LatexLogEntry::textColor(_log.lineType(line)));
+        }
+        else
+        {
+            painter.setPen(this->palette().text().color());
+        }
+        painter.drawText(left, rect.top() + this->fontMetrics().ascent(), _log.line(line));
+    }
+}
+
+void WidgetConsoleView::resizeEvent(QResizeEvent *)
+{
+    bool atEnd = this->verticalScrollBar()->value() == this->verticalScrollBar()->maximum();
+    this->updateScrollBars();
+    if(atEnd)
+    {
+        this->verticalScrollBar()->setValue(this->verticalScrollBar()->maximum());
+    }
+}
+
+void WidgetConsoleView::mousePressEvent(QMouseEvent *event)
+{
+    int row = this->rowAt(event->pos().y());
+    if(row >= this->rowCount())
+    {
+        _selectionStart = _selectionEnd = -1;
+    }
+    else
+    if(event->modifiers() & Qt::ShiftModifier && _selectionStart >= 0)
+    {
+        _selectionEnd = row;
+    }
+    else
+    {
+        _selectionStart = _selectionEnd = row;
+    }
+    this->viewport()->update();
+}
+
+void WidgetConsoleView::mouseMoveEvent(QMouseEvent *event)
+{
+    if(_selectionStart < 0 || !(event->buttons() & Qt::LeftButton))
+    {
+        return;
+    }
+    _selectionEnd = qBound(0, this->rowAt(event->pos().y()), this->rowCount() - 1);
+    this->viewport()->update();
+}
+
+void WidgetConsoleView::keyPressEvent(QKeyEvent *event)
+{
+    if(event->matches(QKeySequence::Copy))
+    {
+        this->copy();
+        return;
+    }
+    if(event->matches(QKeySequence::SelectAll) && this->rowCount())
+    {
+        _selectionStart = 0;
+        _selectionEnd = this->rowCount() - 1;
+        this->viewport()->update();
+        return;
+    }
+    QAbstractScrollArea::keyPressEvent(event);
+}
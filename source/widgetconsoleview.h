@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   copyright       : (C) 2013 by Quentin BRAMAS                          *
+ *   http://texiteasy.com                                                  *
+ *                                                                         *
+ *   This file is part of texiteasy.                                       *
+ *                                                                         *
+ *   texiteasy is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   texiteasy is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with texiteasy.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef WIDGETCONSOLEVIEW_H
+#define WIDGETCONSOLEVIEW_H
+
+#include <QAbstractScrollArea>
+#include "consolelog.h"
+
+/**
+ * @brief The WidgetConsoleView class displays the output of a build. The text is only appended to a ConsoleLog
+ * and only the visible lines are drawn, so the cost of a chunk does not depend on the length of the log.
+ * The view follows the end of the log while it is scrolled to the bottom.
+ */
+class WidgetConsoleView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    explicit WidgetConsoleView(QWidget *parent = 0);
+
+public slots:
+    void clear();
+    void setText(const QString & text);
+    void appendText(const QString & text);
+    void addLogEntry(const LatexLogEntry & logEntry);
+    /**
+     * @brief setFilter show all the lines or only the messages of the errors, the warnings or the bad boxes
+     */
+    void setFilter(int filter);
+    /**
+     * @brief copy copy the selected lines to the clipboard
+     */
+    void copy();
+
+protected:
+    void paintEvent(QPaintEvent *);
+    void resizeEvent(QResizeEvent *);
+    void mousePressEvent(QMouseEvent * event);
+    void mouseMoveEvent(QMouseEvent * event);
+    void keyPressEvent(QKeyEvent * event);
+
+private:
+    /**
+     * @brief rowCount return the number of lines shown by the filter
+     */
+    int rowCount();
+    /**
+     * @brief rowLine return the index in the log of the line shown at the row
+     */
+    int rowLine(int row);
+    int rowAt(int y) const;
+    void updateScrollBars();
+
+    ConsoleLog _log;
+    ConsoleLog::Filter _filter;
+    /**
+     * @brief _selectionStart and _selectionEnd are the rows where the selection starts and ends, -1 if there is none
+     */
+    int _selectionStart;
+    int _selectionEnd;
+};
+
+#endif // WIDGETCONSOLEVIEW_H
@@ -1,5 +1,5 @@
 #include "widgetfile.h"
-#include "hunspell/hunspell.hxx"
+#include "spellchecker.h"
 #include "minisplitter.h"
 #include "widgettextedit.h"
 #include "widgetconsole.h"
@@ -33,6 +33,7 @@ WidgetFile::WidgetFile(MainWindow *parent) :
 {
     _currentPane = 0;
     _masterFile = 0;
+    _spellChecker = 0;
     TextDocument * doc = new TextDocument();
     TextDocumentLayout * doclayout = new TextDocumentLayout(doc);
     doc->setDocumentLayout(doclayout);
@@ -219,6 +220,7 @@ void WidgetFile::initTheme()
         Pal.setColor(QPalette::Background, brush.color());
         _widgetLineNumber->setAutoFillBackground(true);
         _widgetLineNumber->setPalette(Pal);
+        _widgetLineNumber->initTheme();
     }
 }
 
@@ -375,7 +377,7 @@ void WidgetFile::setFileToBuild(File *file)
 }
 
 
-Hunspell * WidgetFile::spellChecker()
+SpellChecker * WidgetFile::spellChecker()
 {
     return _spellChecker;
 }
@@ -386,24 +388,20 @@ QString WidgetFile::spellCheckerEncoding()
     {
         return "";
     }
-    return spellChecker()->get_dic_encoding();
+    return spellChecker()->encoding();
 }
 void WidgetFile::setDictionary(QString dico)
 {
     _dictionary = dico;
-    if(dico == ConfigManager::NoDictionnary)
+    if(_spellChecker)
     {
-        _spellChecker = 0;
+        disconnect(_spellChecker, SIGNAL(wordsChecked(QStringList)), syntaxHighlighter(), SLOT(onWordsChecked(QStringList)));
     }
-    else
+    // spell checkers are shared by the files using the same dictionary
+    _spellChecker = SpellChecker::forDictionary(_dictionary);
+    if(_spellChecker)
     {
-        _spellChecker = new Hunspell((ConfigManager::Instance.dictionaryPath() + _dictionary).toLatin1()+".aff",
-                                     (ConfigManager::Instance.dictionaryPath() + _dictionary).toLatin1()+".dic");
-        QTextCodec *codec = QTextCodec::codecForName(spellCheckerEncoding().toLatin1());
-        foreach(const QString & word, ConfigManager::Instance.userDictionnary(_dictionary))
-        {
-            _spellChecker->add(codec->fromUnicode(word).data());
-        }
+        connect(_spellChecker, SIGNAL(wordsChecked(QStringList)), syntaxHighlighter(), SLOT(onWordsChecked(QStringList)));
     }
     bool modified = file()->isModified();
     syntaxHighlighter()->rehighlight();
@@ -19,7 +19,7 @@ class WidgetLineNumber;
 class SyntaxHighlighter;
 class MainWindow;
 class File;
-class Hunspell;
+class SpellChecker;
 class IPane;
 
 class WidgetFile : public QWidget
@@ -56,7 +56,7 @@ public:
     void setFileToBuild(File * file);
 
 
-    Hunspell * spellChecker();
+    SpellChecker * spellChecker();
     QString spellCheckerEncoding();
     QString dictionary() { return _dictionary; }
     void setDictionary(QString dico);
@@ -115,7 +115,7 @@ private:
     TaskWindow * _widgetSimpleOutput;
     TaskWindow * _warningPane;
     WidgetLineNumber * _widgetLineNumber;
-    Hunspell * _spellChecker;
+    SpellChecker * _spellChecker;
     SyntaxHighlighter * _syntaxHighlighter;
     MainWindow * _window;
     WidgetFile * _masterFile;
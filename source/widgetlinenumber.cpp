@@ -35,6 +35,7 @@
 #include <QDebug>
 #include <QPalette>
 #include <QStack>
+#include <QElapsedTimer>
 
 WidgetLineNumber::WidgetLineNumber(WidgetFile *parent) :
     QWidget(parent),
@@ -42,7 +43,14 @@ WidgetLineNumber::WidgetLineNumber(WidgetFile *parent) :
     widgetTextEdit(0),
     firstVisibleBlock(0),
     firstVisibleBlockTop(0),
-    _currentLine(-1)
+    _currentLine(-1),
+    _styleValid(false),
+    _blockChangeMarkerEnable(true),
+    _digitsPixelRatio(1),
+    _digitWidth(0),
+    _digitHeight(0),
+    _environmentCursorPosition(-1),
+    _environmentRevision(-1)
 {
     this->scrollOffset = 0;
     _isMouseOverUnfolding = false;
@@ -58,6 +66,7 @@ WidgetLineNumber::WidgetLineNumber(WidgetFile *parent) :
     qDebug()<<QString("background-color: black")+//ConfigManager::Instance.colorToString(ConfigManager::Instance.getTextCharFormats()->value("line-number").background().color())+
               ";";*/
     this->setMouseTracking(true);
+    connect(&ConfigManager::Instance, SIGNAL(changed()), this, SLOT(initTheme()));
 }
 
 void WidgetLineNumber::setWidgetTextEdit(WidgetTextEdit *widgetTextEdit)
@@ -79,14 +88,110 @@ void WidgetLineNumber::updateFirstVisibleBlock(int block, int top)
     //qDebug()<<"first : "<<block<<"  "<< this->firstVisibleBlockTop;
 }
 
-void WidgetLineNumber::updateWidth(int lineCount)
+void WidgetLineNumber::initTheme()
 {
-    QFont font;
-    font.setFamily(ConfigManager::Instance.getTextCharFormats("line-number").font().family());
-    font.setPointSize(ConfigManager::Instance.getTextCharFormats("line-number").font().pointSize());
-    QFontMetrics fm(font);
+    _styleValid = false;
+    if(this->widgetTextEdit)
+    {
+        // the width depends on the font of the theme
+        this->updateWidth(this->widgetTextEdit->document()->blockCount());
+    }
+    this->update();
+}
 
+void WidgetLineNumber::updateStyle()
+{
+    if(_styleValid)
+    {
+        return;
+    }
+    _styleValid = true;
+    QTextCharFormat lineNumberFormat = ConfigManager::Instance.getTextCharFormats("line-number");
+    _lineNumberColor = lineNumberFormat.foreground().color();
+    _backgroundColor = lineNumberFormat.background().color();
+    _currentLineNumberColor = ConfigManager::Instance.getTextCharFormats("current-line-number").foreground().color();
+    QColor highlightedColor = ConfigManager::Instance.getTextCharFormats("highlighted-linenumber").foreground().color();
+    _blockChangeMarkerEnable = ConfigManager::Instance.isBlockChangeMarkerEnable();
+
+    _defaultFont = QFont();
+    _defaultFont.setFamily(lineNumberFormat.font().family());
+    _defaultFont.setPointSize(lineNumberFormat.font().pointSize());
+    QFont currentLineFont(_defaultFont);
+    currentLineFont.setWeight(QFont::Bold);
+    _defaultPen = QPen(_lineNumberColor, 1);
+    _currentLinePen = QPen(_currentLineNumberColor, 1);
+
+    QFontMetrics fm(_defaultFont);
+    QFontMetrics currentLineFm(currentLineFont);
     _zeroWidth = fm.width("0");
+    _digitWidth = 0;
+    for(int digit = 0; digit < 10; ++digit)
+    {
+        _digitWidth = qMax(_digitWidth, qMax(fm.width(QString::number(digit)), currentLineFm.width(QString::number(digit))));
+    }
+    _digitHeight = qMax(fm.height(), currentLineFm.height());
+
+    // the digits are rendered once, the numbers are drawn by copying them
+    _digitsPixelRatio = 1;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    if(this->window())
+    {
+        _digitsPixelRatio = this->window()->devicePixelRatio();
+    }
+#endif
+    _digits = QPixmap(10 * _digitWidth * _digitsPixelRatio, 3 * _digitHeight * _digitsPixelRatio);
+    _digits.fill(Qt::transparent);
+    QPainter painter(&_digits);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.scale(_digitsPixelRatio, _digitsPixelRatio);
+    QFont fonts[3] = { _defaultFont, currentLineFont, currentLineFont };
+    QColor colors[3] = { _lineNumberColor, _currentLineNumberColor, highlightedColor };
+    for(int style = DefaultDigits; style <= HighlightedDigits; ++style)
+    {
+        painter.setFont(fonts[style]);
+        painter.setPen(colors[style]);
+        for(int digit = 0; digit < 10; ++digit)
+        {
+            painter.drawText(QRect(digit * _digitWidth, style * _digitHeight, _digitWidth, _digitHeight),
+                             Qt::AlignRight | Qt::AlignTop, QString::number(digit));
+        }
+    }
+}
+
+void WidgetLineNumber::updateEnvironment()
+{
+    int cursorPosition = this->widgetTextEdit->textCursor().position();
+    int revision = this->widgetTextEdit->document()->revision();
+    if(cursorPosition == _environmentCursorPosition && revision == _environmentRevision)
+    {
+        return;
+    }
+    _environmentCursorPosition = cursorPosition;
+    _environmentRevision = revision;
+    const StructItem * environment = this->widgetTextEdit->textStruct()->environmentPath().top();
+    _foldableLineBegin = environment->blockBeginNumber;
+    _foldableLineEnd = environment->blockEndNumber;
+    _foldableEnvironmentName = environment->name;
+}
+
+void WidgetLineNumber::drawLineNumber(QPainter &painter, int rightEdge, int top, int number, DigitStyle style)
+{
+    int x = rightEdge;
+    do
+    {
+        int digit = number % 10;
+        number /= 10;
+        x -= _digitWidth;
+        painter.drawPixmap(QRectF(x, top, _digitWidth, _digitHeight), _digits,
+                           QRectF(digit * _digitWidth * _digitsPixelRatio, style * _digitHeight * _digitsPixelRatio,
+                                  _digitWidth * _digitsPixelRatio, _digitHeight * _digitsPixelRatio));
+    }
+    while(number);
+}
+
+void WidgetLineNumber::updateWidth(int lineCount)
+{
+    this->updateStyle();
     int ln = 1;
     while(lineCount >= 10)
     {
@@ -101,77 +206,63 @@ void WidgetLineNumber::updateWidth(int lineCount)
 void WidgetLineNumber::paintEvent(QPaintEvent * /*event*/)
 {
     if(!widgetTextEdit) return;
+#ifdef DEBUG_PAINT
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    int paintedLines = 0;
+#endif
 
-    //update info about the scroll position
-    this->scrollOffset = -this->widgetTextEdit->verticalScrollBar()->value();
-
-    QStack<const StructItem*> environmentPath = this->widgetTextEdit->textStruct()->environmentPath();
-    _foldableLineBegin = environmentPath.top()->blockBeginNumber;
-    _foldableLineEnd = environmentPath.top()->blockEndNumber;
-    this->firstVisibleBlock = widgetTextEdit->firstVisibleBlockNumber();
+    this->updateStyle();
+    this->updateEnvironment();
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
-    QFont defaultFont;
-    defaultFont.setFamily(ConfigManager::Instance.getTextCharFormats("line-number").font().family());
-    defaultFont.setPointSize(ConfigManager::Instance.getTextCharFormats("line-number").font().pointSize());
-    QFontMetrics fm(defaultFont);
-    painter.setFont(defaultFont);
-
-    QFont currentLineFont;
-    currentLineFont.setFamily(ConfigManager::Instance.getTextCharFormats("line-number").font().family());
-    currentLineFont.setPointSize(ConfigManager::Instance.getTextCharFormats("line-number").font().pointSize());
-    currentLineFont.setWeight(QFont::Bold);
-
-    QPen defaultPen(ConfigManager::Instance.getTextCharFormats("line-number").foreground().color(),1);
-    QPen currentLinePen(ConfigManager::Instance.getTextCharFormats("current-line-number").foreground().color(), 1);
-    QPen blockRangePen(QColor(160,10,10),4);
-    painter.setPen(defaultPen);
+    painter.setPen(_defaultPen);
 
+    QTextDocument * document = this->widgetTextEdit->document();
+    int lastSaveRevision = document->lastSaveRevision();
     int right           = this->width() - 8 - _zeroWidth - 5 - 4;
-    int fontHeight      = fm.height();
     int l               = this->firstVisibleBlock = this->widgetTextEdit->firstVisibleBlockNumber();
     this->scrollOffset  = this->widgetTextEdit->contentOffsetTop();
 
     _unfoldableLines.clear();
     QLine foldingLine(right + 10 + (_zeroWidth+1)/2, 0, right + 10 + (_zeroWidth+1)/2, height());
-    if(environmentPath.top()->blockEndNumber < l)
+    if(_foldableLineEnd < l)
     {
         foldingLine.setLine(-1,-1,-1,-1);
     }
-    while(l < widgetTextEdit->document()->blockCount() && this->widgetTextEdit->blockTop(l) + this->scrollOffset < height())
+    // walk the visible blocks once, l is the number of block
+    for(QTextBlock block = document->findBlockByNumber(l); block.isValid(); block = block.next(), ++l)
     {
-        if(!widgetTextEdit->document()->findBlockByNumber(l).isVisible())
-        {
-            ++l;
-            continue;
-        }
-        int top = this->scrollOffset+this->widgetTextEdit->blockTop(l) + 2;
-        if(l == _currentLine)
+        QRectF geometry = this->widgetTextEdit->blockGeometry(block);
+        if(geometry.top() + this->scrollOffset >= height())
         {
-            painter.setPen(currentLinePen);
-            painter.setFont(currentLineFont);
+            break;
         }
-        else
+        if(!block.isVisible())
         {
-            painter.setPen(defaultPen);
-            painter.setFont(defaultFont);
+            continue;
         }
-        if (ConfigManager::Instance.isBlockChangeMarkerEnable() && widgetTextEdit->document()->findBlockByNumber(l).revision() != widgetTextEdit->document()->lastSaveRevision())
+#ifdef DEBUG_PAINT
+        ++paintedLines;
+#endif
+        int top = this->scrollOffset + geometry.top() + 2;
+        if (_blockChangeMarkerEnable && block.revision() != lastSaveRevision)
         {
             painter.save();
             painter.setRenderHint(QPainter::Antialiasing, false);
-            if (widgetTextEdit->document()->findBlockByNumber(l).revision() < 0)
+            if (block.revision() < 0)
                 painter.setPen(QPen(QColor(0,100,0), 2));
             else
                 painter.setPen(QPen(QColor(130,0,0), 2));
-            painter.drawLine(right+9, top, right+9, top + widgetTextEdit->document()->findBlockByNumber(l).layout()->boundingRect().height());
+            painter.drawLine(right+9, top, right+9, top + geometry.height());
             painter.restore();
         }
-        if(_highlightCurrentLine && l == _currentLine)
+        DigitStyle digitStyle = DefaultDigits;
+        if(l == _currentLine)
         {
-            painter.setPen(QPen(ConfigManager::Instance.getTextCharFormats("highlighted-linenumber").foreground().color(), 2));
+            digitStyle = _highlightCurrentLine ? HighlightedDigits : CurrentLineDigits;
         }
-        painter.drawText(5,top, right, widgetTextEdit->document()->findBlockByNumber(l).layout()->boundingRect().height(), Qt::AlignRight,   QString::number(l+1));
+        this->drawLineNumber(painter, 5 + right, top, l + 1, digitStyle);
 
 
         if(widgetTextEdit->isFolded(l))
@@ -183,13 +274,13 @@ void WidgetLineNumber::paintEvent(QPaintEvent * /*event*/)
             _unfoldableLines.append(unfoldableLine);
             if(unfoldableLine.isMouseOver)
             {
-                painter.setPen(currentLinePen);
-                painter.setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("current-line-number").foreground().color())));
+                painter.setPen(_currentLinePen);
+                painter.setBrush(QBrush(_currentLineNumberColor));
             }
             else
             {
-                painter.setPen(defaultPen);
-                painter.setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("line-number").foreground().color())));
+                painter.setPen(_defaultPen);
+                painter.setBrush(QBrush(_lineNumberColor));
             }
             painter.drawRect(QRectF(right + 14.0, top + 3.0 + _zeroWidth/2.0 - _zeroWidth/20.0, _zeroWidth, _zeroWidth/10.0));
             painter.drawRect(QRectF(right + 14.0 + _zeroWidth/2.0 - _zeroWidth/20.0, top + 3, _zeroWidth/10.0, _zeroWidth));
@@ -198,30 +289,31 @@ void WidgetLineNumber::paintEvent(QPaintEvent * /*event*/)
         else
         {
             // Environement ranges
-            if(l == environmentPath.top()->blockBeginNumber)
+            if(l == _foldableLineBegin)
             {
+                painter.setPen(l == _currentLine ? _currentLinePen : _defaultPen);
                 drawFoldingBegin(&painter, right + 14, top, _zeroWidth+1);
                 foldingLine.setP1(QPoint(foldingLine.x1(), top + 3 + _zeroWidth+1));
             }
             else
-            if(l == environmentPath.top()->blockEndNumber)
+            if(l == _foldableLineEnd)
             {
+                painter.setPen(l == _currentLine ? _currentLinePen : _defaultPen);
                 drawFoldingEnd(&painter, right + 14, top, _zeroWidth+1);
                 foldingLine.setP2(QPoint(foldingLine.x2(), top + 3));
             }
         }
-        ++l;
     }
-    if(l > environmentPath.top()->blockBeginNumber
-            && (   l > environmentPath.top()->blockEndNumber
-                || this->firstVisibleBlock < environmentPath.top()->blockBeginNumber)
-            && !widgetTextEdit->isFolded(environmentPath.top()->blockBeginNumber)
-            && environmentPath.top()->blockBeginNumber != 0
-            && environmentPath.top()->name != "document")
+    if(l > _foldableLineBegin
+            && (   l > _foldableLineEnd
+                || this->firstVisibleBlock < _foldableLineBegin)
+            && !widgetTextEdit->isFolded(_foldableLineBegin)
+            && _foldableLineBegin != 0
+            && _foldableEnvironmentName != "document")
     {
         if(_isMouseOverFolding)
         {
-            QColor c = QColor(ConfigManager::Instance.getTextCharFormats("current-line-number").foreground().color());
+            QColor c = _currentLineNumberColor;
             c.setAlpha(50);
             painter.setBrush(QBrush(c));
             //painter.drawLine(foldingLine);
@@ -231,11 +323,6 @@ void WidgetLineNumber::paintEvent(QPaintEvent * /*event*/)
                               foldingLine.y2() - foldingLine.y1() + 2*_zeroWidth + 6
                               );
         }
-        /*else
-        {
-            painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("line-number").foreground().color())));
-        }
-        // */
         _foldingHover.setRect(foldingLine.x1() - ceil(_zeroWidth/2) + 1,
                               foldingLine.y1() - _zeroWidth,
                               2*ceil(_zeroWidth/2) + 2,
@@ -246,17 +333,19 @@ void WidgetLineNumber::paintEvent(QPaintEvent * /*event*/)
     {
         _foldingHover.setRect(-1, -1, 0, 0);
     }
-
+#ifdef DEBUG_PAINT
+    qDebug()<<"WidgetLineNumber::paintEvent"<<(paintTimer.nsecsElapsed() / 1000000.0)<<"ms"<<paintedLines<<"lines of"<<document->blockCount();
+#endif
 }
 void WidgetLineNumber::drawFoldingBegin(QPainter* painter, int right, int top, int width)
 {
     if(_isMouseOverFolding)
     {
-        painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("current-line-number").foreground().color())));
+        painter->setBrush(QBrush(_currentLineNumberColor));
     }
     else
     {
-        painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("line-number").foreground().color())));
+        painter->setBrush(QBrush(_lineNumberColor));
     }
     painter->drawEllipse(right, top + 3 , width, width);
     QPoint p[3];
@@ -267,7 +356,7 @@ void WidgetLineNumber::drawFoldingBegin(QPainter* painter, int right, int top, i
     p[1].setY(top + 3 + width/4);
     p[2].setX(right + floor(width/2.0 + sqrt(3)*width/4.0));
     p[2].setY(p[1].y());
-    painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("line-number").background().color())));
+    painter->setBrush(QBrush(_backgroundColor));
     painter->drawConvexPolygon(p, 3);
 }
 
@@ -275,11 +364,11 @@ void WidgetLineNumber::drawFoldingEnd(QPainter* painter, int right, int top, int
 {
     if(_isMouseOverFolding)
     {
-        painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("current-line-number").foreground().color())));
+        painter->setBrush(QBrush(_currentLineNumberColor));
     }
     else
     {
-        painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("line-number").foreground().color())));
+        painter->setBrush(QBrush(_lineNumberColor));
     }
     painter->drawEllipse(right, top + 3 , width, width);
     QPoint p[3];
@@ -290,7 +379,7 @@ void WidgetLineNumber::drawFoldingEnd(QPainter* painter, int right, int top, int
     p[1].setY(top + 3 + width -  width/4);
     p[2].setX(right + floor(width/2.0 + sqrt(3)*width/4.0));
     p[2].setY(p[1].y());
-    painter->setBrush(QBrush(QColor(ConfigManager::Instance.getTextCharFormats("line-number").background().color())));
+    painter->setBrush(QBrush(_backgroundColor));
     painter->drawConvexPolygon(p, 3);
 }
 
@@ -23,6 +23,9 @@
 #define WIDGETLINENUMBER_H
 
 #include <QWidget>
+#include <QFont>
+#include <QPen>
+#include <QPixmap>
 class WidgetTextEdit;
 class WidgetFile;
 class WidgetLineNumber : public QWidget
@@ -37,6 +40,10 @@ public:
 signals:
     
 public slots:
+    /**
+     * @brief initTheme forget the fonts, pens and glyphs of the previous theme, they are built again at the next repaint
+     */
+    void initTheme();
     void updateFirstVisibleBlock(int, int);
     void setBlockRange(int,int);
     void updateWidth(int lineCount);
@@ -46,8 +53,24 @@ protected:
     void leaveEvent(QEvent *);
     void mousePressEvent(QMouseEvent *event);
 private:
+    /**
+     * @brief The DigitStyle enum is the row of the digits in the glyph atlas
+     */
+    enum DigitStyle { DefaultDigits = 0, CurrentLineDigits = 1, HighlightedDigits = 2 };
     void drawFoldingBegin(QPainter* painter, int right, int top, int width);
     void drawFoldingEnd(QPainter* painter, int right, int top, int width);
+    /**
+     * @brief updateStyle read the formats of the theme and render the digits in the glyph atlas, if it is needed
+     */
+    void updateStyle();
+    /**
+     * @brief updateEnvironment read the environment of the cursor if the cursor or the text has changed
+     */
+    void updateEnvironment();
+    /**
+     * @brief drawLineNumber draw the number right-aligned on rightEdge with the glyphs of the atlas
+     */
+    void drawLineNumber(QPainter & painter, int rightEdge, int top, int number, DigitStyle style);
     
     WidgetFile * _widgetFile;
     WidgetTextEdit * widgetTextEdit;
@@ -75,6 +98,29 @@ private:
         bool isMouseOver;
     };
     QList<UnfoldableLine>_unfoldableLines;
+
+    bool _styleValid;
+    bool _blockChangeMarkerEnable;
+    QFont _defaultFont;
+    QColor _lineNumberColor;
+    QColor _currentLineNumberColor;
+    QColor _backgroundColor;
+    QPen _defaultPen;
+    QPen _currentLinePen;
+    /**
+     * @brief _digits is the glyph atlas: the ten digits in each DigitStyle, in cells of _digitWidth x _digitHeight
+     */
+    QPixmap _digits;
+    qreal _digitsPixelRatio;
+    int _digitWidth;
+    int _digitHeight;
+    /**
+     * @brief _environmentCursorPosition and _environmentRevision are the cursor position and the document revision
+     * of the last environment read (_foldableLineBegin, _foldableLineEnd and _foldableEnvironmentName)
+     */
+    int _environmentCursorPosition;
+    int _environmentRevision;
+    QString _foldableEnvironmentName;
 };
 
 #endif // WIDGETLINENUMBER_H
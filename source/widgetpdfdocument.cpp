@@ -23,6 +23,8 @@
 #include "widgettextedit.h"
 #include "widgetfile.h"
 #include "pdfsynchronizer.h"
+#include "pdfrenderer.h"
+#include "synctexloader.h"
 #include "mainwindow.h"
 #include <QMouseEvent>
 #include <QDebug>
@@ -40,6 +42,7 @@
 #include "widgettextedit.h"
 
 #include <QApplication>
+#include <algorithm>
 
 #define ZOOM_UPDATE 500
 #define SYNCTEX_GZ_EXT ".synctex.gz"
@@ -52,7 +55,6 @@
 
 
 
-QImage * WidgetPdfDocument::EmptyImage = new QImage();
 int WidgetPdfDocument::PageMargin = 20;
 
 WidgetPdfDocument::WidgetPdfDocument(QWidget *parent) :
@@ -60,10 +62,13 @@ WidgetPdfDocument::WidgetPdfDocument(QWidget *parent) :
     _document(0),
     _documentHeight(0),
     _file(0),
-    _loadedPages(0),
     _mousePressed(false),
-    _pages(0),
+    _renderer(new PdfRenderer(this)),
+    _firstVisiblePage(-1),
+    _lastVisiblePage(-1),
     scanner(NULL),
+    _synctexIndex(0),
+    _synctexLoader(new SynctexLoader(this)),
     _scroll(new QScrollBar(Qt::Vertical, this)),
     _widgetFile(0),
     _zoom(1),
@@ -81,26 +86,21 @@ WidgetPdfDocument::WidgetPdfDocument(QWidget *parent) :
     connect(_scroll, SIGNAL(valueChanged(int)), this, SLOT(onScroll(int)));
     connect(this, SIGNAL(translated(int)), _scroll, SLOT(setValue(int)));
     connect(&_requestNewResolutionTimer, SIGNAL(timeout()), this, SLOT(refreshPages()));
+    connect(_renderer, SIGNAL(tileRendered(int,PdfTile,QImage)), this, SLOT(onTileRendered(int,PdfTile,QImage)), Qt::QueuedConnection);
+    connect(_renderer, SIGNAL(pageFingerprinted(int,int,uint)), this, SLOT(onPageFingerprinted(int,int,uint)), Qt::QueuedConnection);
+    connect(_renderer, SIGNAL(pageLinksCollected(int,int,PdfLinkList)), this, SLOT(onPageLinksCollected(int,int,PdfLinkList)), Qt::QueuedConnection);
+    connect(_synctexLoader, SIGNAL(loaded()), this, SLOT(onSynctexLoaded()), Qt::QueuedConnection);
 }
 WidgetPdfDocument::~WidgetPdfDocument()
 {
-    foreach(Link link, _links)
-    {
-        delete link.destination;
-    }
-    if(_pages)
-    {
-        this->refreshPages();
-        delete _pages;
-    }
+    // the renderer must not use the document anymore
+    delete _renderer;
+    delete _synctexLoader;
+    delete _synctexIndex;
     if(_document)
     {
         delete _document;
     }
-    if(_loadedPages)
-    {
-        delete _loadedPages;
-    }
     if(scanner != NULL)
     {
         PdfSynchronizer::lockBeforeSync();
@@ -142,7 +142,7 @@ bool WidgetPdfDocument::gestureEvent(QNativeGestureEvent* event)
 #endif
 void WidgetPdfDocument::paintEvent(QPaintEvent *)
 {
-    if(!this->_document)
+    if(!this->_document || _pageSizes.isEmpty())
     {
         return;
     }
@@ -150,18 +150,37 @@ void WidgetPdfDocument::paintEvent(QPaintEvent *)
     painter.translate(this->_painterTranslate);
     painter.setBrush(QBrush(QColor(0,0,0,50)));
     painter.setPen(QPen(QColor(0,0,0,0)));
-    QImage * image;
-    int cumulatedTop=0;
-    for(int i = 0; i < this->_document->numPages(); ++i)
+    QRectF viewport = this->viewportRect();
+    int level = PdfTile::level(_zoom);
+    int firstVisiblePage = this->pageAt(viewport.top());
+    int lastVisiblePage = this->pageAt(viewport.bottom());
+    _firstVisiblePage = firstVisiblePage;
+    _lastVisiblePage = lastVisiblePage;
+    _pageCache.setViewport(firstVisiblePage, lastVisiblePage, ConfigManager::Instance.pdfPrefetchPages(), level);
+    // the links are collected by the renderer the first time the page is visible
+    QList<int> linkPages;
+    for(int i = qMax(0, firstVisiblePage); i <= lastVisiblePage && i < _links.count(); ++i)
     {
-        if(cumulatedTop + _document->page(i)->pageSize().height()*_zoom < -this->_painterTranslate.y())
+        if(!_links.at(i).requested)
         {
-            cumulatedTop += (_document->page(i)->pageSize().height()+WidgetPdfDocument::PageMargin)*_zoom;
+            _links[i].requested = true;
+            linkPages << i;
+        }
+    }
+    if(!linkPages.isEmpty())
+    {
+        _renderer->requestLinks(linkPages);
+    }
+    for(int i = firstVisiblePage; i <= lastVisiblePage; ++i)
+    {
+        int cumulatedTop = this->pageTop(i);
+        if(cumulatedTop + _pageSizes.at(i).height()*_zoom < viewport.top())
+        {
+            // the top of the viewport is in the margin below this page
             continue;
         }
-        image = this->page(i);
-        QRect target(0, cumulatedTop, _document->page(i)->pageSize().width() * _zoom, _document->page(i)->pageSize().height() * _zoom);
-        painter.drawImage(target,*image);
+        QRect target(0, cumulatedTop, _pageSizes.at(i).width() * _zoom, _pageSizes.at(i).height() * _zoom);
+        this->paintTiles(painter, i, target & viewport.toAlignedRect(), level);
         if(i == _syncPage+1)
         {
             if(_lastUpdate.elapsed()<1200)
@@ -171,7 +190,7 @@ void WidgetPdfDocument::paintEvent(QPaintEvent *)
                 painter.drawRect(-_painterTranslate.x(), cumulatedTop, this->width()+1, this->height());
             }
         }
-        int pageHeight = _document->page(i)->pageSize().height()*_zoom;
+        int pageHeight = _pageSizes.at(i).height()*_zoom;
         if(i == _syncPage)
         {
             if(this->_timer.isActive())
@@ -229,61 +248,90 @@ void WidgetPdfDocument::paintEvent(QPaintEvent *)
         painter.drawText(pageNumberDisp.translated(4,4), pageNumString);
 
 
-        cumulatedTop += pageHeight+WidgetPdfDocument::PageMargin*_zoom;
-        if(cumulatedTop > this->height() - this->_painterTranslate.y())
-        {
-            break;
-        }
     }
-
+    if(!_requestNewResolutionTimer.isActive())
+    {
+        // while zooming the scaled tiles are enough, the new level is rendered when the zoom settles
+        this->requestTiles(firstVisiblePage, lastVisiblePage);
+    }
+#ifdef DEBUG_PDF_CACHE
+    painter.resetTransform();
+    QString cacheStatus = _pageCache.status();
+    QRect cacheStatusRect(0, 0, painter.fontMetrics().width(cacheStatus) + 8, 22);
+    cacheStatusRect.moveRight(this->width() - 25);
+    painter.setBrush(QBrush(QColor(0,0,0,150)));
+    painter.setPen(Qt::NoPen);
+    painter.drawRect(cacheStatusRect);
+    painter.setPen(QPen(Qt::white));
+    painter.drawText(cacheStatusRect, Qt::AlignCenter, cacheStatus);
+#endif
 
 }
 
-void WidgetPdfDocument::initDocument()
+bool WidgetPdfDocument::loadDocument(QString pdfFilename, bool keepUnchangedPages)
 {
-    if(!_file)
+    // the renderer must release the old document before it is deleted
+    _renderer->setDocument(0);
+    keepUnchangedPages = keepUnchangedPages && _document && pdfFilename == _pdfFilename;
+    if(keepUnchangedPages)
     {
-        return;
+        // the pages that have not been fingerprinted cannot be compared
+        _previousFingerprints = _pageFingerprints;
+        for(int page = 0; page < _previousFingerprints.count(); ++page)
+        {
+            if(!_previousFingerprints.at(page))
+            {
+                _pageCache.removePage(page);
+            }
+        }
     }
-
-    if(_pages)
+    else
     {
-        this->refreshPages();
-        delete _pages;
+        _previousFingerprints.clear();
+        _pageCache.clear();
     }
+    _pageFingerprints.clear();
+    _stalePages.clear();
+    _pdfFilename = pdfFilename;
+    _pageCache.setBudget(ConfigManager::Instance.pdfCacheSize() * 1024 * 1024);
+    _pageCache.setDownscaleFarPages(ConfigManager::Instance.isPdfCacheDownscaling());
+    _pageSizes.clear();
+    _pageTops.clear();
+    _firstVisiblePage = -1;
+    _lastVisiblePage = -1;
 
     if(_document)
     {
         delete _document;
         _document = 0;
     }
-    if(!QFile::exists(_file->getPdfFilename()))
+    if(!QFile::exists(pdfFilename))
     {
-        return;
+        return false;
     }
-    QFile f(_file->getPdfFilename());
+    QFile f(pdfFilename);
     if (!f.open(QFile::ReadOnly)) {
-        Tools::Log("WidgetPdfDocument::initDocument: "+_file->getPdfFilename()+" not readable");
-        return;
+        Tools::Log("WidgetPdfDocument::loadDocument: "+pdfFilename+" not readable");
+        return false;
     }
 
     // create document
     try {
-        Tools::Log("WidgetPdfDocument::initDocument: Poppler::Document::load( "+_file->getPdfFilename()+" )");
+        Tools::Log("WidgetPdfDocument::loadDocument: Poppler::Document::load( "+pdfFilename+" )");
 
-        QFile pdfFile(_file->getPdfFilename());
+        QFile pdfFile(pdfFilename);
         pdfFile.open(QFile::ReadOnly);
         //calling loadFromData ensures that the file is on readOnly (load lock the file on windows)
         _document = Poppler::Document::loadFromData(pdfFile.readAll());
     } catch (std::bad_alloc) {
-        Tools::Log("WidgetPdfDocument::initDocument: std::bad_alloc");
-        return;
+        Tools::Log("WidgetPdfDocument::loadDocument: std::bad_alloc");
+        return false;
     } catch (...) {
-        Tools::Log("WidgetPdfDocument::initDocument: error");
-        return;
+        Tools::Log("WidgetPdfDocument::loadDocument: error");
+        return false;
     }
 
-    Tools::Log("WidgetPdfDocument::initDocument: _document "+QString(_document?"loaded":"not loaded"));
+    Tools::Log("WidgetPdfDocument::loadDocument: _document "+QString(_document?"loaded":"not loaded"));
     if(!_document || _document->isLocked())
     {
         if(_document)
@@ -291,50 +339,123 @@ void WidgetPdfDocument::initDocument()
             delete _document;
         }
         _document = 0;
-        return;
+        _pageCache.clear();
+        return false;
     }
 
     _document->setRenderHint(Poppler::Document::Antialiasing);
     _document->setRenderHint(Poppler::Document::TextAntialiasing);
 
+    _renderer->setDocument(_document);
 
-    _pages = new QImage*[_document->numPages()];
-
-    if(_loadedPages)
-    {
-        delete _loadedPages;
-    }
-    _loadedPages = new bool[_document->numPages()];
-    for(int idx = 0; idx < _document->numPages(); ++idx)
+    int pageCount = _document->numPages();
+    _pageFingerprints.fill(0, pageCount);
+    _pageCache.removePagesFrom(pageCount);
+    for(int page = 0; page < qMin(pageCount, _previousFingerprints.count()); ++page)
     {
-        _loadedPages[idx] = false;
+        if(_previousFingerprints.at(page))
+        {
+            _stalePages.insert(page);
+        }
     }
 
-    this->initLinks();
-    this->initScroll();
-
-    QFileInfo fileInfo(this->_file->rootFilename());
-    QString syncFile = fileInfo.absoluteDir().path() + "/" + fileInfo.baseName();
-    if(QFile::exists(syncFile+".synctex.gz"))
+    this->initPageGeometry();
+    if(keepUnchangedPages)
     {
-        if(scanner != NULL )
+        // the links of the stale pages are kept until they are found changed
+        for(int page = pageCount; page < _links.count(); ++page)
         {
-            PdfSynchronizer::lockBeforeSync();
-            synctex_scanner_free(scanner);
-            PdfSynchronizer::unlockBeforeSync();
+            this->clearLinks(page);
         }
-        scanner = synctex_scanner_new_with_output_file(syncFile.toUtf8().data(), NULL, 1);
-        if( scanner == NULL )
+        _links.resize(pageCount);
+        for(int page = 0; page < pageCount; ++page)
         {
-            scanner = synctex_scanner_new_with_output_file(syncFile.toLatin1().data(), NULL, 1);
+            if(!_stalePages.contains(page))
+            {
+                this->clearLinks(page);
+            }
         }
-        if( scanner == NULL )
+    }
+    else
+    {
+        this->initLinks();
+    }
+    this->initScroll();
+    this->requestFingerprints();
+    return true;
+}
+
+void WidgetPdfDocument::requestFingerprints()
+{
+    // the stale pages closest to the viewport first
+    int center = qMax(0, this->pageAt(this->viewportRect().center().y()));
+    QList<int> stalePages;
+    QList<int> otherPages;
+    for(int distance = 0; distance < _pageSizes.count(); ++distance)
+    {
+        for(int page = center - distance; page <= center + distance; page += qMax(1, 2 * distance))
         {
-            qDebug()<<"scanner is NULL, cannot open "<<syncFile+".synctex.gz"<<" -> Maybe some special character that make it fails?";
+            if(page < 0 || page >= _pageSizes.count())
+            {
+                continue;
+            }
+            if(_stalePages.contains(page))
+            {
+                stalePages << page;
+            }
+            else
+            {
+                otherPages << page;
+            }
         }
-        jumpToPdfFromSource();
+    }
+    _renderer->requestFingerprints(stalePages, true);
+    _renderer->requestFingerprints(otherPages, false);
+}
+
+void WidgetPdfDocument::onPageFingerprinted(int generation, int page, uint fingerprint)
+{
+    if(generation != _renderer->generation() || page < 0 || page >= _pageFingerprints.count())
+    {
+        return;
+    }
+    _pageFingerprints[page] = fingerprint;
+    if(!_stalePages.remove(page))
+    {
+        return;
+    }
+    if(_previousFingerprints.at(page) == fingerprint)
+    {
+        // unchanged, the tiles and the links of the previous version are kept
+        return;
+    }
+    _pageCache.removePage(page);
+    this->clearLinks(page);
+    if(page >= _firstVisiblePage && page <= _lastVisiblePage)
+    {
         update();
     }
+}
+
+void WidgetPdfDocument::initDocument(bool reload)
+{
+    if(!_file)
+    {
+        return;
+    }
+
+    if(!this->loadDocument(_file->getPdfFilename(), reload))
+    {
+        return;
+    }
+
+    QFileInfo fileInfo(this->_file->rootFilename());
+    QString syncFile = fileInfo.absoluteDir().path() + "/" + fileInfo.baseName();
+    if(QFile::exists(syncFile+".synctex.gz"))
+    {
+        // the current scanner is used until the new one is parsed, see onSynctexLoaded
+        _synctexLoader->load(syncFile, _document->numPages());
+    }
     else
     {
         qDebug()<<"Sync file does not exists : "<<syncFile+".synctex.gz";
@@ -342,17 +463,69 @@ void WidgetPdfDocument::initDocument()
     updateScrollBar();
 }
 
+void WidgetPdfDocument::onSynctexLoaded()
+{
+    synctex_scanner_t newScanner;
+    SynctexIndex * newIndex;
+    _synctexLoader->takeResult(&newScanner, &newIndex);
+    if(newScanner == NULL)
+    {
+        return;
+    }
+    if(scanner != NULL )
+    {
+        PdfSynchronizer::lockBeforeSync();
+        synctex_scanner_free(scanner);
+        PdfSynchronizer::unlockBeforeSync();
+    }
+    scanner = newScanner;
+    delete _synctexIndex;
+    _synctexIndex = newIndex;
+    jumpToPdfFromSource();
+    update();
+}
+
+void WidgetPdfDocument::initPageGeometry()
+{
+    int pageCount = _document->numPages();
+    _pageSizes.resize(pageCount);
+    _pageTops.resize(pageCount + 1);
+    qreal top = 0;
+    QMutexLocker locker(&_renderer->documentMutex());
+    for(int page_idx = 0; page_idx < pageCount; ++page_idx)
+    {
+        Poppler::Page * page = _document->page(page_idx);
+        _pageSizes[page_idx] = page ? page->pageSizeF() : QSizeF();
+        delete page;
+        _pageTops[page_idx] = top;
+        top += _pageSizes.at(page_idx).height() + WidgetPdfDocument::PageMargin;
+    }
+    _pageTops[pageCount] = top;
+}
+
+int WidgetPdfDocument::pageAt(qreal y) const
+{
+    if(_pageSizes.isEmpty())
+    {
+        return -1;
+    }
+    // the last page whose top is above y
+    QVector<qreal>::const_iterator next = std::upper_bound(_pageTops.constBegin(), _pageTops.constEnd() - 1, y / _zoom);
+    int page = next - _pageTops.constBegin() - 1;
+    return qBound(0, page, _pageSizes.count() - 1);
+}
+
 void WidgetPdfDocument::initScroll()
 {
-    if(!_document->numPages())
+    if(_pageSizes.isEmpty())
     {
         return;
     }
 
-    int height = -WidgetPdfDocument::PageMargin;
-    for(int page_idx = 0; page_idx < _document->numPages(); ++page_idx)
+    qreal height = -WidgetPdfDocument::PageMargin;
+    foreach(const QSizeF & size, _pageSizes)
     {
-        height += _document->page(page_idx)->pageSize().height();
+        height += size.height();
     }
     _documentHeight = height;
     this->_scroll->setRange(0,this->documentHeight() - this->height()+30);
@@ -362,47 +535,93 @@ void WidgetPdfDocument::initScroll()
 
 void WidgetPdfDocument::initLinks()
 {
-    foreach(Link link, _links)
+    for(int page = 0; page < _links.count(); ++page)
     {
-        delete link.destination;
+        this->clearLinks(page);
     }
+    _links.resize(_document->numPages());
 
-    _links.clear();
+    /*if(linkAreaAbsolute.contains(this->cursor().pos()))
+    {
+        this->setCursor(QCursor(Qt::PointingHandCursor));
+    }*/
+}
 
-    QRectF linkArea;
-    qreal height;
-    qreal width;
-    qreal top;
-    qreal left;
-    int cumulatedTop = 0;
-    for(int page_idx = 0; page_idx < _document->numPages(); ++page_idx)
+void WidgetPdfDocument::clearLinks(int page_idx)
+{
+    _links[page_idx] = PageLinks();
+}
+
+void WidgetPdfDocument::onPageLinksCollected(int generation, int page_idx, PdfLinkList links)
+{
+    if(generation != _renderer->generation() || page_idx < 0 || page_idx >= _links.count())
+    {
+        return;
+    }
+    PageLinks & pageLinks = _links[page_idx];
+    if(!pageLinks.requested)
+    {
+        // cleared since the request, the page will be requested again
+        return;
+    }
+    pageLinks.loaded = true;
+    pageLinks.links = links;
+    pageLinks.cells.clear();
+    if(pageLinks.links.isEmpty())
+    {
+        return;
+    }
+
+    const QSizeF & pageSize = _pageSizes.at(page_idx);
+    pageLinks.columns = qMax(1, qCeil(pageSize.width() / LINK_CELL_SIZE));
+    int rows = qMax(1, qCeil(pageSize.height() / LINK_CELL_SIZE));
+    pageLinks.cells.resize(pageLinks.columns * rows);
+    for(int idx = 0; idx < pageLinks.links.count(); ++idx)
     {
-        QList<Poppler::Link*> links = _document->page(page_idx)->links();
-        if(links.count())
+        const QRectF & rectangle = pageLinks.links.at(idx).rectangle;
+        int firstColumn = qBound(0, qFloor(rectangle.left() / LINK_CELL_SIZE), pageLinks.columns - 1);
+        int lastColumn = qBound(0, qFloor(rectangle.right() / LINK_CELL_SIZE), pageLinks.columns - 1);
+        int firstRow = qBound(0, qFloor(rectangle.top() / LINK_CELL_SIZE), rows - 1);
+        int lastRow = qBound(0, qFloor(rectangle.bottom() / LINK_CELL_SIZE), rows - 1);
+        for(int row = firstRow; row <= lastRow; ++row)
         {
-            foreach(Poppler::Link * popLink, links)
+            for(int column = firstColumn; column <= lastColumn; ++column)
             {
-                if(popLink->linkType() == Poppler::Link::Goto)
-                {
-                    Link link;
-                    linkArea = popLink->linkArea();
-                    height = _document->page(page_idx)->pageSize().height()*linkArea.height()*_zoom;
-                    width = _document->page(page_idx)->pageSize().width()*linkArea.width()*_zoom;
-                    top = _document->page(page_idx)->pageSize().height()*linkArea.top()*_zoom+cumulatedTop;
-                    left = _document->page(page_idx)->pageSize().width()*linkArea.left()*_zoom;
-                    link.rectangle = QRectF(left,top,width,height);
-                    link.destination = static_cast< Poppler::LinkGoto*>(popLink);
-                    _links.append(link);
-                }
+                pageLinks.cells[row * pageLinks.columns + column].append(idx);
             }
         }
-        cumulatedTop += (_document->page(page_idx)->pageSize().height()+WidgetPdfDocument::PageMargin)*_zoom;
     }
+}
 
-    /*if(linkAreaAbsolute.contains(this->cursor().pos()))
+const PdfLink * WidgetPdfDocument::linkAt(const QPointF &pos)
+{
+    QPointF absolutePos = pos - this->_painterTranslate;
+    int page = this->pageAt(absolutePos.y());
+    // only the visible pages can be under the mouse
+    if(page < _firstVisiblePage || page > _lastVisiblePage || page < 0 || page >= _links.count())
     {
-        this->setCursor(QCursor(Qt::PointingHandCursor));
-    }*/
+        return 0;
+    }
+    const PageLinks & pageLinks = _links.at(page);
+    if(pageLinks.cells.isEmpty())
+    {
+        return 0;
+    }
+    QPointF pagePos(absolutePos.x() / _zoom, (absolutePos.y() - this->pageTop(page)) / _zoom);
+    int column = qFloor(pagePos.x() / LINK_CELL_SIZE);
+    int row = qFloor(pagePos.y() / LINK_CELL_SIZE);
+    if(column < 0 || column >= pageLinks.columns || row < 0 || row >= pageLinks.cells.count() / pageLinks.columns)
+    {
+        return 0;
+    }
+    foreach(int idx, pageLinks.cells.at(row * pageLinks.columns + column))
+    {
+        if(pageLinks.links.at(idx).rectangle.contains(pagePos))
+        {
+            return &pageLinks.links.at(idx);
+        }
+    }
+    return 0;
 }
 
 void WidgetPdfDocument::resizeEvent(QResizeEvent *)
@@ -418,41 +637,189 @@ void WidgetPdfDocument::onScroll(int value)
     update();
 }
 
-QImage * WidgetPdfDocument::page(int page)
+qreal WidgetPdfDocument::pixelRatio() const
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    if(this->window())
+    {
+        return this->window()->devicePixelRatio(); // 2 if retina, 1 otherwise
+    }
+#endif
+    return 1;
+}
+
+QRectF WidgetPdfDocument::viewportRect() const
+{
+    return QRectF(-_painterTranslate.x(), -_painterTranslate.y(), this->width(), this->height());
+}
+
+QRectF WidgetPdfDocument::tileRect(const PdfTile &tile) const
 {
-    if(!_pages || page < 0 || page >= _document->numPages())
+    // pixels of the level per point of the page
+    qreal pixels = this->pixelRatio() * PdfTile::scale(tile.level);
+    const QSizeF & pageSize = _pageSizes.at(tile.page);
+    QRectF rect(tile.column * PDF_TILE_SIZE, tile.row * PDF_TILE_SIZE, PDF_TILE_SIZE, PDF_TILE_SIZE);
+    rect &= QRectF(0, 0, qCeil(pageSize.width() * pixels), qCeil(pageSize.height() * pixels));
+    qreal factor = _zoom / pixels;
+    return QRectF(rect.left() * factor, this->pageTop(tile.page) + rect.top() * factor, rect.width() * factor, rect.height() * factor);
+}
+
+QList<PdfTile> WidgetPdfDocument::tilesIn(int page, const QRectF &rect, int level) const
+{
+    QList<PdfTile> tiles;
+    qreal pixels = this->pixelRatio() * PdfTile::scale(level);
+    const QSizeF & pageSize = _pageSizes.at(page);
+    // rect in the pixels of the level, relative to the page
+    qreal factor = pixels / _zoom;
+    QRectF area(rect.left() * factor, (rect.top() - this->pageTop(page)) * factor, rect.width() * factor, rect.height() * factor);
+    area &= QRectF(0, 0, qCeil(pageSize.width() * pixels), qCeil(pageSize.height() * pixels));
+    if(area.isEmpty())
     {
-        return WidgetPdfDocument::EmptyImage;
+        return tiles;
     }
-    if(_loadedPages[page])
+    int lastColumn = qCeil(area.right() / PDF_TILE_SIZE) - 1;
+    int lastRow = qCeil(area.bottom() / PDF_TILE_SIZE) - 1;
+    for(int row = qFloor(area.top() / PDF_TILE_SIZE); row <= lastRow; ++row)
     {
-        return _pages[page];
+        for(int column = qFloor(area.left() / PDF_TILE_SIZE); column <= lastColumn; ++column)
+        {
+            tiles << PdfTile(page, level, column, row);
+        }
     }
-    _loadedPages[page] = true;
+    return tiles;
+}
 
-    qreal ratio = 72.0;
+void WidgetPdfDocument::paintTiles(QPainter &painter, int page, const QRect &target, int level)
+{
+    // placeholder until the renderer sends the tiles
+    painter.fillRect(target, Qt::white);
+    foreach(const PdfTile & tile, this->tilesIn(page, target, level))
+    {
+        QRectF tileTarget = this->tileRect(tile);
+        QImage image = _pageCache.image(tile);
+        if(!image.isNull())
+        {
+            painter.drawImage(tileTarget, image);
+            continue;
+        }
+        // scale the tiles of the other levels until the tile arrives, the coarser ones first
+        painter.save();
+        painter.setClipRect(tileTarget);
+        for(int fallbackLevel = level - 4; fallbackLevel <= level + 2; ++fallbackLevel)
+        {
+            if(fallbackLevel == level)
+            {
+                continue;
+            }
+            foreach(const PdfTile & fallbackTile, this->tilesIn(page, tileTarget, fallbackLevel))
+            {
+                QImage fallbackImage = _pageCache.fallback(fallbackTile);
+                if(!fallbackImage.isNull())
+                {
+                    painter.drawImage(this->tileRect(fallbackTile), fallbackImage);
+                }
+            }
+        }
+        painter.restore();
+    }
+}
 
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
-    if(this->window())
+void WidgetPdfDocument::requestTiles(int firstVisiblePage, int lastVisiblePage)
+{
+    if(!_document || firstVisiblePage < 0)
     {
-        ratio *= this->window()->devicePixelRatio(); // 2 if retina, 1 otherwise
+        return;
     }
-#endif
+    int level = PdfTile::level(_zoom);
+    QRectF viewport = this->viewportRect();
+    QList<PdfTile> tiles;
+    for(int idx = firstVisiblePage; idx <= lastVisiblePage; ++idx)
+    {
+        if(_stalePages.contains(idx))
+        {
+            // rendered again only if the fingerprint shows a change
+            continue;
+        }
+        foreach(const PdfTile & tile, this->tilesIn(idx, viewport, level))
+        {
+            if(!_pageCache.isRendered(tile))
+            {
+                tiles << tile;
+            }
+        }
+    }
+    // then one viewport of the neighbours, the closest first and the next ones before the previous ones
+    int prefetch = ConfigManager::Instance.pdfPrefetchPages();
+    for(int distance = 1; distance <= prefetch; ++distance)
+    {
+        int next = lastVisiblePage + distance;
+        int previous = firstVisiblePage - distance;
+        QList<PdfTile> neighbourTiles;
+        if(next < _pageSizes.count())
+        {
+            viewport.moveTop(this->pageTop(next));
+            neighbourTiles << this->tilesIn(next, viewport, level);
+        }
+        if(previous >= 0)
+        {
+            viewport.moveBottom(this->pageTop(previous) + _pageSizes.at(previous).height() * _zoom);
+            neighbourTiles << this->tilesIn(previous, viewport, level);
+        }
+        foreach(const PdfTile & tile, neighbourTiles)
+        {
+            if(!_pageCache.isRendered(tile) && !_stalePages.contains(tile.page))
+            {
+                tiles << tile;
+            }
+        }
+    }
+    _renderer->request(tiles, 72.0 * this->pixelRatio());
+}
+
+bool WidgetPdfDocument::isViewportRendered() const
+{
+    if(!_document || _firstVisiblePage < 0)
+    {
+        return true;
+    }
+    int level = PdfTile::level(_zoom);
+    for(int idx = _firstVisiblePage; idx <= _lastVisiblePage; ++idx)
+    {
+        foreach(const PdfTile & tile, this->tilesIn(idx, this->viewportRect(), level))
+        {
+            if(!_pageCache.isRendered(tile))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-    return  _pages[page] = new QImage(this->_document->page(page)->renderToImage(this->_zoom*ratio,this->_zoom*ratio));
+void WidgetPdfDocument::onTileRendered(int generation, PdfTile tile, QImage image)
+{
+    if(generation != _renderer->generation() || tile.page < 0 || tile.page >= _pageSizes.count())
+    {
+        // the tile of a previous document
+        return;
+    }
+    _pageCache.insert(tile, image);
+    if(tile.page >= _firstVisiblePage && tile.page <= _lastVisiblePage && tile.level == PdfTile::level(_zoom))
+    {
+        // the prefetched tiles are painted when they are scrolled to
+        update();
+    }
 }
+
 void WidgetPdfDocument::goToPage(int page, int top, int height)
 {
     if(!_file) return;
 
-    page = min(page,this->_document->numPages()-1);
+    if(!_document || _pageSizes.isEmpty()) return;
 
-    int cumulatedTop = 0;
-    int i = 0;
-    for(i = 0; i < page; ++i)
-    {
-        cumulatedTop += (_document->page(i)->pageSize().height()+WidgetPdfDocument::PageMargin)*_zoom;
-    }
+    page = qBound(0, page, _pageSizes.count()-1);
+
+    qreal cumulatedTop = this->pageTop(page);
     if(-this->_painterTranslate.y() + this->height() < cumulatedTop + top*_zoom + height * _zoom || -this->_painterTranslate.y() > cumulatedTop + top*_zoom )
     {
         this->_painterTranslate.setY(-cumulatedTop-top*_zoom-height*_zoom/2+this->height()/2);
@@ -469,53 +836,39 @@ void WidgetPdfDocument::refreshPages()
     {
         return;
     }
-    for(int idx = 0; idx < this->_document->numPages(); ++idx)
-    {
-        if(_loadedPages[idx])
-        {
-            delete _pages[idx];
-            _loadedPages[idx] = false;
-        }
-    }
+    // the current tiles stay as placeholders, paintEvent requests the new level
     update();
 
 }
 void WidgetPdfDocument::checkLinksOver(const QPointF &pos)
 {
-    QPointF absolutePos = pos - this->_painterTranslate;
-    this->setCursor(Qt::ArrowCursor);
-    foreach(const Link &link, _links)
-    {
-        if(link.rectangle.contains(absolutePos))
-        {
-            this->setCursor(Qt::PointingHandCursor);
-            break;
-        }
-    }
+    this->setCursor(this->linkAt(pos) ? Qt::PointingHandCursor : Qt::ArrowCursor);
 }
 bool WidgetPdfDocument::checkLinksPress(const QPointF &pos)
 {
-    QPointF absolutePos = pos - this->_painterTranslate;
-    foreach(const Link &link, _links)
+    const PdfLink * link = this->linkAt(pos);
+    if(!link)
     {
-        if(link.rectangle.contains(absolutePos))
-        {
-            int pageNumber = link.destination->destination().pageNumber() - 1;
-            int top = link.destination->destination().top()*_document->page(pageNumber)->pageSize().height();
-            int left = link.destination->destination().left()*_document->page(pageNumber)->pageSize().width();
-            int bottom = link.destination->destination().bottom()*_document->page(pageNumber)->pageSize().height();
-            int right = link.destination->destination().right()*_document->page(pageNumber)->pageSize().width();
-            this->goToPage(pageNumber, top);
-
-            _syncPage = pageNumber;
-            _syncRect = QRectF(left, top, right-left, bottom-top);
-            _lastUpdate.start();
-            _timer.start(1);
-
-            return true;
-        }
+        return false;
+    }
+    int pageNumber = link->destinationPage;
+    if(pageNumber < 0 || pageNumber >= _pageSizes.count())
+    {
+        return true;
     }
-    return false;
+    const QSizeF & pageSize = _pageSizes.at(pageNumber);
+    int top = link->destination.top()*pageSize.height();
+    int left = link->destination.left()*pageSize.width();
+    int bottom = link->destination.bottom()*pageSize.height();
+    int right = link->destination.right()*pageSize.width();
+    this->goToPage(pageNumber, top);
+
+    _syncPage = pageNumber;
+    _syncRect = QRectF(left, top, right-left, bottom-top);
+    _lastUpdate.start();
+    _timer.start(1);
+
+    return true;
 }
 
 void WidgetPdfDocument::mousePressEvent(QMouseEvent * event)
@@ -616,15 +969,16 @@ void WidgetPdfDocument::mouseMoveEvent(QMouseEvent * event)
 }
 void WidgetPdfDocument::boundPainterTranslation()
 {
-    if(!this->_document || !this->_document->numPages())
+    if(!this->_document || _pageSizes.isEmpty())
     {
         return;
     }
-    this->_painterTranslate.setX(max(this->_painterTranslate.x(), this->width() - this->_document->page(0)->pageSize().width()*_zoom - 30));
+    qreal pageWidth = _pageSizes.first().width();
+    this->_painterTranslate.setX(max(this->_painterTranslate.x(), this->width() - pageWidth*_zoom - 30));
     this->_painterTranslate.setX(min(this->_painterTranslate.x(), 10));
-    if(this->_document->page(0)->pageSize().width()*_zoom + 40 < this->width())
+    if(pageWidth*_zoom + 40 < this->width())
     {
-        this->_painterTranslate.setX(-this->_document->page(0)->pageSize().width()*_zoom/2+this->width()/2-20);
+        this->_painterTranslate.setX(-pageWidth*_zoom/2+this->width()/2-20);
     }
 
     this->_painterTranslate.setY(max(this->_painterTranslate.y(), this->height() - this->documentHeight() - 30));
@@ -637,22 +991,21 @@ void WidgetPdfDocument::boundPainterTranslation()
 
 void WidgetPdfDocument::updatePdf()
 {
-    this->initDocument();
+    this->initDocument(true);
     update();
 }
 
 void WidgetPdfDocument::jumpToEditorFromAbsolutePos(const QPoint &pos)
 {
-    if(!this->_document->numPages())
+    if(_pageSizes.isEmpty())
     {
         return;
 
     }
     QPoint absolute(pos - this->_painterTranslate);
-    qreal pageHeightWithMargin = (_document->page(0)->pageSize().height()+WidgetPdfDocument::PageMargin)*_zoom;
 
-    int page = absolute.y() / pageHeightWithMargin;
-    QPoint relative(absolute.x(), absolute.y() - page * pageHeightWithMargin);
+    int page = this->pageAt(absolute.y());
+    QPoint relative(absolute.x(), absolute.y() - this->pageTop(page));
     relative /= _zoom;
 
     if(relative.x() < 0 || relative.y() < 0)
@@ -664,27 +1017,41 @@ void WidgetPdfDocument::jumpToEditorFromAbsolutePos(const QPoint &pos)
 
 void WidgetPdfDocument::jumpToEditor(int page, const QPoint& pos)
 {
-    if (scanner == NULL) return;
-    if (synctex_edit_query(scanner, page+1, pos.x(), pos.y()) > 0)
+    QString filename;
+    int line;
+    if (_synctexIndex && !_synctexIndex->isEmpty())
     {
-        synctex_node_t node;
-        while ((node = synctex_next_result(scanner)) != NULL)
+        if (!_synctexIndex->findSource(page, pos, &filename, &line))
         {
-            QString filename = QString::fromUtf8(synctex_scanner_get_name(scanner, synctex_node_tag(node)));
-            filename = QFileInfo(filename).canonicalFilePath();
-            this->_widgetFile->widgetTextEdit()->widgetFile()->window()->open(filename);
-            WidgetFile * w = FileManager::Instance.widgetFile(filename);
-            if(w)
-            {
-                w->widgetTextEdit()->goToLine(synctex_node_line(node));
-            }
-            else
-            {
-                this->_widgetFile->widgetTextEdit()->goToLine(synctex_node_line(node));
-            }
-            break;
+            return;
         }
     }
+    else
+    {
+        if (scanner == NULL) return;
+        if (synctex_edit_query(scanner, page+1, pos.x(), pos.y()) <= 0)
+        {
+            return;
+        }
+        synctex_node_t node = synctex_next_result(scanner);
+        if (node == NULL)
+        {
+            return;
+        }
+        filename = QString::fromUtf8(synctex_scanner_get_name(scanner, synctex_node_tag(node)));
+        line = synctex_node_line(node);
+    }
+    filename = QFileInfo(filename).canonicalFilePath();
+    this->_widgetFile->widgetTextEdit()->widgetFile()->window()->open(filename);
+    WidgetFile * w = FileManager::Instance.widgetFile(filename);
+    if(w)
+    {
+        w->widgetTextEdit()->goToLine(line);
+    }
+    else
+    {
+        this->_widgetFile->widgetTextEdit()->goToLine(line);
+    }
 }
 
 void WidgetPdfDocument::jumpToPdfFromSourceView(int /*top*/)
@@ -726,6 +1093,15 @@ void WidgetPdfDocument::jumpToPdfFromSource(int source_line)
     {
         return;
     }
+    SynctexIndex::Box box;
+    if(_synctexIndex && !_synctexIndex->isEmpty())
+    {
+        if(_synctexIndex->find(sourceFile, source_line, &box))
+        {
+            this->onSyncReady(box.page, box.rect);
+        }
+        return;
+    }
     //synchronize may take some times so we call this non-blocking function with onSyncReady callback when the rectangle and the page are found
     PdfSynchronizer::sync(this, "onSyncReady", scanner, sourceFile, source_line);
 }
@@ -35,12 +35,19 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QDebug>
+#include <QVector>
+#include <QImage>
+#include <QSizeF>
+#include <QSet>
 
 #if QT_VERSION > QT_VERSION_CHECK(5,2,0)
 #    include <QNativeGestureEvent>
 #endif
 
 #include "synctex_parser.h"
+#include "pdfpagecache.h"
+#include "pdfrenderer.h"
+#include "synctexindex.h"
 #include <QPoint>
 
 #ifdef OS_MAC
@@ -54,18 +61,28 @@
 #endif
 
 class File;
-class QImage;
 class WidgetFile;
+class PdfRenderer;
+class SynctexLoader;
+class QPainter;
 
-struct Link
-{
-    QRectF rectangle;
-    Poppler::LinkGoto * destination;
+/**
+ * @brief LINK_CELL_SIZE is the side (in points) of the cells of the grid indexing the links of a page
+ */
+#define LINK_CELL_SIZE 64
 
-    ~Link()
-    {
-        //delete destination;
-    }
+/**
+ * @brief The PageLinks struct holds the goto links of a page, collected by the renderer the first time the page is visible,
+ * and a grid giving for each cell of the page the indices of the links crossing it.
+ */
+struct PageLinks
+{
+    PageLinks() : requested(false), loaded(false), columns(0) { }
+    bool requested;
+    bool loaded;
+    PdfLinkList links;
+    int columns;
+    QVector<QVector<int> > cells;
 };
 
 
@@ -78,6 +95,18 @@ public:
     ~WidgetPdfDocument();
     void setFile(File * file) { this->_file = file; this->initDocument(); }
     void setWidgetFile(WidgetFile * widgetFile) { this->_widgetFile = widgetFile; }
+    /**
+     * @brief loadDocument load the pdf, without its synctex file.
+     * @param keepUnchangedPages if the pdf is the one already displayed, keep the tiles of the pages
+     * until their fingerprints show they have changed.
+     * @return true if the document is loaded
+     */
+    bool loadDocument(QString pdfFilename, bool keepUnchangedPages = false);
+    /**
+     * @brief isViewportRendered return true if the tiles painted last time are all rendered at the current level
+     */
+    bool isViewportRendered() const;
+    const PdfPageCache & pageCache() const { return _pageCache; }
 
 
     /**
@@ -95,7 +124,7 @@ public:
     int documentHeight()
     {
         if(!_document) return 0;
-        return (_documentHeight + WidgetPdfDocument::PageMargin * (_document->numPages() - 1))*_zoom ;
+        return (_documentHeight + WidgetPdfDocument::PageMargin * (_pageSizes.count() - 1))*_zoom ;
     }
     void updateScrollBar();
     qreal zoom() { return _zoom; }
@@ -115,6 +144,16 @@ public slots:
     void onScroll(int value);
 private slots:
     void onSyncReady(int page, QRectF rect);
+    void onTileRendered(int generation, PdfTile tile, QImage image);
+    void onPageFingerprinted(int generation, int page, uint fingerprint);
+    /**
+     * @brief onPageLinksCollected index the goto links of a page in its grid
+     */
+    void onPageLinksCollected(int generation, int page, PdfLinkList links);
+    /**
+     * @brief onSynctexLoaded swap the scanner and its index with the ones parsed by _synctexLoader
+     */
+    void onSynctexLoaded();
 protected:
 #if QT_VERSION > QT_VERSION_CHECK(5,2,0)
     bool gestureEvent(QNativeGestureEvent* event);
@@ -133,30 +172,124 @@ private slots:
     void refreshPages();
 private:
 
-    void initDocument();
+    /**
+     * @brief initDocument load the pdf and the synctex file of _file
+     * @param reload true if the pdf has been rebuilt, the unchanged pages are not rendered again
+     */
+    void initDocument(bool reload = false);
+    /**
+     * @brief initPageGeometry read the size of each page once per document and sum the tops of the pages
+     */
+    void initPageGeometry();
+    /**
+     * @brief initLinks forget the links of all the pages, they are collected again when the pages are visible
+     */
     void initLinks();
+    /**
+     * @brief clearLinks forget the links of one page
+     */
+    void clearLinks(int page);
+    /**
+     * @brief linkAt return the link under pos (coordinates of the widget) if it is on a visible page
+     * whose links have been collected, 0 otherwise
+     */
+    const PdfLink * linkAt(const QPointF & pos);
+    /**
+     * @brief requestFingerprints ask the fingerprints of all the pages, those of the stale pages
+     * (closest to the viewport first) before any tile.
+     */
+    void requestFingerprints();
+    /**
+     * @brief pageTop return the top of the page at the current zoom
+     */
+    qreal pageTop(int page) const { return _pageTops.at(page) * _zoom; }
+    /**
+     * @brief pageAt return the page displayed at the ordinate y (at the current zoom),
+     * or the page above if y is in a margin.
+     */
+    int pageAt(qreal y) const;
     void boundPainterTranslation();
-    QImage * page(int page);
+    /**
+     * @brief pixelRatio return the number of device pixels per pixel (2 on retina screens)
+     */
+    qreal pixelRatio() const;
+    /**
+     * @brief viewportRect return the visible area, in the coordinates of the document at the current zoom
+     */
+    QRectF viewportRect() const;
+    /**
+     * @brief tileRect return the area covered by the tile, in the coordinates of the document at the current zoom
+     */
+    QRectF tileRect(const PdfTile & tile) const;
+    /**
+     * @brief tilesIn return the tiles of the level covering rect (coordinates of the document at the current zoom)
+     */
+    QList<PdfTile> tilesIn(int page, const QRectF & rect, int level) const;
+    /**
+     * @brief paintTiles paint the part target of the page with the tiles of the level,
+     * or the tiles of the neighbouring levels while they are rendered.
+     */
+    void paintTiles(QPainter & painter, int page, const QRect & target, int level);
+    /**
+     * @brief requestTiles ask the renderer for the visible tiles that are not rendered at the current level,
+     * then for the tiles of the prefetch window around them.
+     */
+    void requestTiles(int firstVisiblePage, int lastVisiblePage);
     void checkLinksOver(const QPointF &pos);
     bool checkLinksPress(const QPointF &pos);
 
 
     Poppler::Document* _document;
     int _documentHeight;
-    static QImage * EmptyImage;
     File* _file;
     QElapsedTimer _lastUpdate;
-    QList<Link> _links;
-    bool * _loadedPages;
+    /**
+     * @brief _links are the goto links of each page
+     */
+    QVector<PageLinks> _links;
     bool _mousePressed;
     static int PageMargin;
-    QImage ** _pages;
+    /**
+     * @brief _pageCache holds the tiles received from the renderer
+     */
+    PdfPageCache _pageCache;
+    /**
+     * @brief _pageSizes are the sizes of the pages (in points)
+     */
+    QVector<QSizeF> _pageSizes;
+    /**
+     * @brief _pageTops are the tops of the pages at zoom 1, margins included.
+     * The last item is the bottom of the document.
+     */
+    QVector<qreal> _pageTops;
+    QString _pdfFilename;
+    /**
+     * @brief _pageFingerprints are the fingerprints of the pages of the document (0 until they are computed)
+     */
+    QVector<uint> _pageFingerprints;
+    /**
+     * @brief _previousFingerprints are the fingerprints of the pages of the previous version of the document
+     */
+    QVector<uint> _previousFingerprints;
+    /**
+     * @brief _stalePages are the pages whose tiles come from the previous version of the document
+     * and have not been compared yet. They are painted but not rendered until their fingerprint is known.
+     */
+    QSet<int> _stalePages;
+    PdfRenderer * _renderer;
+    int _firstVisiblePage;
+    int _lastVisiblePage;
     QPainterPath path;
     QPoint _mousePosition;
     QPoint _pressAt;
     QPoint _painterTranslate;
     QPoint _painterTranslateWhenMousePressed;
     synctex_scanner_t scanner;
+    /**
+     * @brief _synctexIndex answers the searches of scanner (0 until a synctex file is loaded)
+     */
+    SynctexIndex * _synctexIndex;
+    SynctexLoader * _synctexLoader;
     QScrollBar * _scroll;
     int _syncPage;
     QRectF _syncRect;
@@ -21,61 +21,221 @@
 
 #include "widgetscroller.h"
 #include "widgettextedit.h"
+#include "configmanager.h"
 #include <QPainter>
 #include <QScrollBar>
 #include <QFont>
 #include <QBrush>
 #include <QColor>
 #include <QDebug>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QVector>
 
 WidgetScroller::WidgetScroller(QWidget *parent) :
     QWidget(parent),
     parent(parent),
-    widgetTextEdit(0)
+    widgetTextEdit(0),
+    imageFirstBlock(-1),
+    imageBlockCount(0)
 {
-    this->scrollOffset = 0;
     this->setGeometry(QRect(0,0,100,height()));
     this->setMouseTracking(true);
     mousePressed = false;
-    this->boudingRect = QRect(0,0,100,100);
+    mousePressedAt = 0;
+}
+
+void WidgetScroller::setWidgetTextEdit(WidgetTextEdit *widgetTextEdit)
+{
+    this->widgetTextEdit = widgetTextEdit;
+    connect(widgetTextEdit->document(), SIGNAL(contentsChange(int,int,int)), this, SLOT(onContentsChange(int,int,int)));
+    this->updateText();
 }
 
 void WidgetScroller::updateText(void)
 {
-    QFontMetrics fm(QFont("Consolas",2));
-    this->boudingRect = fm.boundingRect(0,0,this->widgetTextEdit->width()/4,99999999,Qt::AlignLeft,this->widgetTextEdit->document()->toPlainText());
+    this->imageFirstBlock = -1;
+    this->update();
 }
 
-void WidgetScroller::paintEvent(QPaintEvent * /*event*/)
+void WidgetScroller::onContentsChange(int position, int /*charsRemoved*/, int charsAdded)
 {
-    if(!widgetTextEdit) return;
+    // the highlighter also reports its new formats through contentsChange
+    QTextDocument * document = this->widgetTextEdit->document();
+    if(document->blockCount() != this->imageBlockCount)
+    {
+        // the following blocks have moved
+        this->imageFirstBlock = -1;
+    }
+    else
+    {
+        int first = document->findBlock(position).blockNumber();
+        int last = document->findBlock(position + charsAdded).blockNumber();
+        if(last < 0)
+        {
+            last = document->blockCount() - 1;
+        }
+        for(int blockNumber = first; blockNumber <= last; ++blockNumber)
+        {
+            this->dirtyBlocks.insert(blockNumber);
+        }
+    }
+    this->update();
+}
 
-    //update info about the scroll position
-    this->scrollOffset = -this->widgetTextEdit->verticalScrollBar()->value();
-    QFontMetrics fm(QFont("Consolas",2));
+void WidgetScroller::updateImage(int firstBlock, int rows, int width)
+{
+    QTextDocument * document = this->widgetTextEdit->document();
+    if(this->image.width() != width || this->image.height() != rows * MINIMAP_LINE_HEIGHT)
+    {
+        this->image = QImage(width, rows * MINIMAP_LINE_HEIGHT, QImage::Format_ARGB32_Premultiplied);
+        this->imageFirstBlock = -1;
+    }
+    int shift = firstBlock - this->imageFirstBlock;
+    if(this->imageFirstBlock < 0 || qAbs(shift) >= rows)
+    {
+        this->dirtyBlocks.clear();
+        for(int row = 0; row < rows; ++row)
+        {
+            this->dirtyBlocks.insert(firstBlock + row);
+        }
+    }
+    else
+    if(shift)
+    {
+        // keep the strips still visible, only the blocks that appear are drawn
+        this->image = this->image.copy(0, shift * MINIMAP_LINE_HEIGHT, width, rows * MINIMAP_LINE_HEIGHT);
+        int firstExposed = shift > 0 ? rows - shift : 0;
+        int lastExposed = shift > 0 ? rows - 1 : -shift - 1;
+        for(int row = firstExposed; row <= lastExposed; ++row)
+        {
+            this->dirtyBlocks.insert(firstBlock + row);
+        }
+    }
+    this->imageFirstBlock = firstBlock;
+    this->imageBlockCount = document->blockCount();
+    if(this->dirtyBlocks.isEmpty())
+    {
+        return;
+    }
 
-    this->overlayRect = QRectF(0,-this->scrollOffset/2.0,this->widgetTextEdit->width()/4,height()*this->widgetTextEdit->height()/(this->widgetTextEdit->textHeight()+1));
+    QPainter painter(&this->image);
+    QColor background = ConfigManager::Instance.textCharFormat(ConfigManager::NormalFormat).background().color();
+    QTextBlock block = document->findBlockByNumber(firstBlock);
+    for(int row = 0; row < rows; ++row)
+    {
+        if(this->dirtyBlocks.contains(firstBlock + row))
+        {
+            int top = row * MINIMAP_LINE_HEIGHT;
+            painter.fillRect(0, top, width, MINIMAP_LINE_HEIGHT, background);
+            if(block.isValid())
+            {
+                this->paintStrip(painter, block, top);
+            }
+        }
+        if(block.isValid())
+        {
+            block = block.next();
+        }
+    }
+    // the blocks outside the image are drawn when they appear
+    this->dirtyBlocks.clear();
+}
 
-    QPainter painter(this);
+void WidgetScroller::paintStrip(QPainter &painter, const QTextBlock &block, int top)
+{
+    QString text = block.text();
+    int length = qMin(text.length(), this->image.width());
+    if(!length)
+    {
+        return;
+    }
+    // the colour of each character, the last format applied to a character wins
+    QVector<QRgb> colors(length, ConfigManager::Instance.foregroundPen(ConfigManager::NormalFormat).color().rgb());
+#if QT_VERSION >= 0x050600
+    QList<QTextLayout::FormatRange> formats = block.layout()->formats().toList();
+#else
+    QList<QTextLayout::FormatRange> formats = block.layout()->additionalFormats();
+#endif
+    foreach(const QTextLayout::FormatRange & range, formats)
+    {
+        if(range.format.foreground().style() == Qt::NoBrush)
+        {
+            continue;
+        }
+        QRgb rgb = range.format.foreground().color().rgb();
+        int end = qMin(length, range.start + range.length);
+        for(int position = qMax(0, range.start); position < end; ++position)
+        {
+            colors[position] = rgb;
+        }
+    }
+    // one pixel per character, the runs of characters of the same colour are drawn at once
+    int start = 0;
+    while(start < length)
+    {
+        if(text.at(start).isSpace())
+        {
+            ++start;
+            continue;
+        }
+        int end = start + 1;
+        while(end < length && colors.at(end) == colors.at(start) && !text.at(end).isSpace())
+        {
+            ++end;
+        }
+        painter.fillRect(start, top, end - start, MINIMAP_LINE_HEIGHT - 1, QColor(colors.at(start)));
+        start = end;
+    }
+}
+
+int WidgetScroller::scrollValue(int blockNumber)
+{
+    QTextBlock block = this->widgetTextEdit->document()->findBlockByNumber(qMax(0, blockNumber));
+    if(!block.isValid())
+    {
+        block = this->widgetTextEdit->document()->lastBlock();
+    }
+    return block.firstLineNumber();
+}
+
+void WidgetScroller::paintEvent(QPaintEvent * /*event*/)
+{
+    if(!widgetTextEdit) return;
 
     this->setGeometry(QRect(this->geometry().left(),this->geometry().top(),this->widgetTextEdit->width()/4,height()));
-    painter.setFont(QFont("Consolas",2));
+    int width = this->widgetTextEdit->width()/4;
+    int rows = height() / MINIMAP_LINE_HEIGHT + 1;
+    int blockCount = this->widgetTextEdit->document()->blockCount();
 
-    painter.drawText(QRect(0, this->scrollOffset * (boudingRect.height()-height())/(height()-this->overlayRect.height()),this->widgetTextEdit->width()/4,99999999),Qt::TextWordWrap,this->widgetTextEdit->document()->toPlainText());
+    // the minimap follows the editor proportionally when the document is taller than the widget
+    QScrollBar * scrollBar = this->widgetTextEdit->verticalScrollBar();
+    int firstBlock = 0;
+    if(blockCount > rows && scrollBar->maximum() > 0)
+    {
+        firstBlock = static_cast<qint64>(blockCount - rows) * scrollBar->value() / scrollBar->maximum();
+    }
+    this->updateImage(firstBlock, rows, width);
 
-    painter.setBrush(QBrush(QColor(0,0,0,100)));
+    int firstVisibleBlock = this->widgetTextEdit->firstVisibleBlockNumber();
+    int lastVisibleBlock = this->widgetTextEdit->cursorForPosition(QPoint(0, this->widgetTextEdit->viewport()->height())).blockNumber();
+    this->overlayRect = QRectF(0, (firstVisibleBlock - firstBlock) * MINIMAP_LINE_HEIGHT,
+                               width, (lastVisibleBlock - firstVisibleBlock + 1) * MINIMAP_LINE_HEIGHT);
 
+    QPainter painter(this);
+    painter.drawImage(0, 0, this->image);
+    painter.setBrush(QBrush(QColor(0,0,0,100)));
     painter.drawRect(this->overlayRect);
 }
 void WidgetScroller::mousePressEvent(QMouseEvent *event)
 {
     mousePressed = true;
-    mousePressedAt = this->scrollOffset+event->pos().y()*2;
+    mousePressedAt = (event->pos().y() - this->overlayRect.y()) / MINIMAP_LINE_HEIGHT;
     if(event->pos().y() < this->overlayRect.y() || event->pos().y() > this->overlayRect.y() + this->overlayRect.height())
     {
-        mousePressedAt=0;
-        qDebug()<<"outside "<<event->pos().y();
-        emit changed(event->pos().y()*2);
+        // center the block under the mouse
+        mousePressedAt = this->overlayRect.height() / MINIMAP_LINE_HEIGHT / 2;
+        emit changed(this->scrollValue(this->imageFirstBlock + event->pos().y() / MINIMAP_LINE_HEIGHT - mousePressedAt));
     }
 }
 void WidgetScroller::mouseReleaseEvent(QMouseEvent */*event*/)
@@ -87,6 +247,6 @@ void WidgetScroller::mouseMoveEvent(QMouseEvent *event)
 {
     if(mousePressed)
     {
-        emit changed(event->pos().y()*2-mousePressedAt);
+        emit changed(this->scrollValue(this->imageFirstBlock + event->pos().y() / MINIMAP_LINE_HEIGHT - mousePressedAt));
     }
 }
@@ -24,8 +24,23 @@
 
 #include <QWidget>
 #include <QRectF>
+#include <QImage>
+#include <QSet>
+
+/**
+ * @brief MINIMAP_LINE_HEIGHT is the height (in pixels) of the strip of a block in the minimap
+ */
+#define MINIMAP_LINE_HEIGHT 3
 
 class WidgetTextEdit;
+class QTextBlock;
+
+/**
+ * @brief The WidgetScroller class is a minimap of the document. Each block is drawn as a strip of the colours
+ * given by the highlighter, in an image of the visible part of the minimap which is kept between the repaints:
+ * when the editor scrolls the image is shifted and only the strips of the blocks that appear are drawn,
+ * when the document changes only the strips of the modified blocks are drawn again.
+ */
 class WidgetScroller : public QWidget
 {
     Q_OBJECT
@@ -33,22 +48,50 @@ public:
     explicit WidgetScroller(QWidget *parent = 0);
     void setParent(QWidget *parent) {QWidget::setParent(parent); this->parent = parent; }
 
-    void setWidgetTextEdit(WidgetTextEdit * widgetTextEdit) { this->widgetTextEdit = widgetTextEdit; }
+    void setWidgetTextEdit(WidgetTextEdit * widgetTextEdit);
     
 signals:
+    /**
+     * @brief changed is emitted with the value of the scroll bar of the editor requested by the mouse
+     */
     void changed(int);
 public slots:
+    /**
+     * @brief updateText draw the whole minimap again at the next repaint
+     */
     void updateText(void);
 
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
 private:
-    QRect boudingRect;
     bool mousePressed;
+    /**
+     * @brief mousePressedAt is the offset (in blocks) of the mouse in the overlay when it has been pressed
+     */
     int mousePressedAt;
     QRectF overlayRect;
     QWidget *parent;
-    int scrollOffset;
     WidgetTextEdit * widgetTextEdit;
 
+    /**
+     * @brief image holds the strips of the blocks from imageFirstBlock
+     */
+    QImage image;
+    /**
+     * @brief imageFirstBlock is the block drawn at the top of the image, -1 if the image must be drawn again
+     */
+    int imageFirstBlock;
+    int imageBlockCount;
+    /**
+     * @brief dirtyBlocks are the blocks modified since their strip has been drawn
+     */
+    QSet<int> dirtyBlocks;
+
+    void updateImage(int firstBlock, int rows, int width);
+    void paintStrip(QPainter & painter, const QTextBlock & block, int top);
+    int scrollValue(int blockNumber);
+
     void paintEvent(QPaintEvent * event);
     void mousePressEvent(QMouseEvent * event);
     void mouseReleaseEvent(QMouseEvent *);
@@ -30,56 +30,55 @@ void WidgetSimpleOutput::setBuilder(Builder *builder)
     {
         return;
     }
-    connect(_builder, SIGNAL(error()),this, SLOT(onError()));
-    connect(_builder, SIGNAL(success()),this, SLOT(onError()));
+    // the entries are parsed once by the builder while the output is produced
+    connect(_builder, SIGNAL(logEntryAdded(LatexLogEntry)),this, SLOT(onLogEntryAdded(LatexLogEntry)));
     //connect(_builder, SIGNAL(success()),this, SLOT(onSuccess()));
-    connect(_builder, SIGNAL(started()), this, SLOT(clear()));
+    connect(_builder, SIGNAL(started()), this, SLOT(onStarted()));
 }
 
 
-void WidgetSimpleOutput::onError()
+void WidgetSimpleOutput::onStarted()
 {
-    LatexOutputFilter f;
-    f.run(_builder->output());
-    //foreach(const LatexLogEntry &l, f.m_infoList)
-    //    qDebug()<<l.type<<" "<<l.file<<" "<<l.logline<<" "<<l.message;
-
-    this->setRowCount(f.m_infoList.count());
-
-    QStringList headers;
-    headers << tr("") << tr("Fichier") << tr("Ligne") << tr("Message");
-    this->setHorizontalHeaderLabels(headers);
-    this->setColumnWidth(0, 30);
-    this->setColumnWidth(2, 65);
+    this->clearContents();
+    this->setRowCount(0);
+}
 
-    int row = 0;
-    foreach(const LatexLogEntry &logEntry, f.m_infoList)
+void WidgetSimpleOutput::onLogEntryAdded(const LatexLogEntry &logEntry)
+{
+    int row = this->rowCount();
+    this->setRowCount(row + 1);
+    if(!row)
     {
-        QTableWidgetItem * item = new QTableWidgetItem();
-        switch(logEntry.type)
-        {
-        case LT_ERROR: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxCritical)); break;
-        case LT_WARNING: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxWarning)); break;
-        case LT_INFO: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxInformation)); break;
-        case LT_BADBOX: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxInformation)); break;
-        }
-        item->setTextAlignment(Qt::AlignCenter);
-        this->setItem(row,0, item);
+        QStringList headers;
+        headers << tr("") << tr("Fichier") << tr("Ligne") << tr("Message");
+        this->setHorizontalHeaderLabels(headers);
+        this->setColumnWidth(0, 30);
+        this->setColumnWidth(2, 65);
+    }
 
-        item = new QTableWidgetItem(QFileInfo(logEntry.file).fileName());
-        item->setTextAlignment(Qt::AlignCenter);
-        item->setData(Qt::StatusTipRole, logEntry.file);
-        this->setItem(row,1,item);
-        item = new QTableWidgetItem(QString::number(logEntry.oldline));
-        item->setTextAlignment(Qt::AlignCenter);
-        this->setItem(row,2,item);
-        this->setItem(row,3,new QTableWidgetItem(logEntry.message));
-        this->item(row,0)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
-        this->item(row,1)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
-        this->item(row,2)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
-        this->item(row,3)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
-        ++row;
+    QTableWidgetItem * item = new QTableWidgetItem();
+    switch(logEntry.type)
+    {
+    case LT_ERROR: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxCritical)); break;
+    case LT_WARNING: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxWarning)); break;
+    case LT_INFO: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxInformation)); break;
+    case LT_BADBOX: item->setIcon(this->style()->standardIcon(QStyle::SP_MessageBoxInformation)); break;
     }
+    item->setTextAlignment(Qt::AlignCenter);
+    this->setItem(row,0, item);
+
+    item = new QTableWidgetItem(QFileInfo(logEntry.file).fileName());
+    item->setTextAlignment(Qt::AlignCenter);
+    item->setData(Qt::StatusTipRole, logEntry.file);
+    this->setItem(row,1,item);
+    item = new QTableWidgetItem(QString::number(logEntry.oldline));
+    item->setTextAlignment(Qt::AlignCenter);
+    this->setItem(row,2,item);
+    this->setItem(row,3,new QTableWidgetItem(logEntry.message));
+    this->item(row,0)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    this->item(row,1)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    this->item(row,2)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+    this->item(row,3)->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
 }
 void WidgetSimpleOutput::onSuccess()
 {
@@ -6,6 +6,7 @@
 
 class Builder;
 class WidgetTextEdit;
+struct LatexLogEntry;
 
 class WidgetSimpleOutput : public QTableWidget
 {
@@ -18,7 +19,14 @@ public:
 signals:
     
 public slots:
-    void onError(void);
+    /**
+     * @brief onStarted remove the entries of the previous build
+     */
+    void onStarted(void);
+    /**
+     * @brief onLogEntryAdded append an entry of the log while the build runs
+     */
+    void onLogEntryAdded(const LatexLogEntry & logEntry);
     void onSuccess(void);
     void onCellSelected(int,int);
     
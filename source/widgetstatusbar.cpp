@@ -687,10 +687,10 @@ void OutputPaneToggleButton::paintEvent(QPaintEvent*)
     }
 
     p.setFont(font());
-    p.setPen(QPen(ConfigManager::Instance.getTextCharFormats("normal").foreground().color()));
+    p.setPen(ConfigManager::Instance.foregroundPen(ConfigManager::NormalFormat));
     //p.drawText((numberAreaWidth - numberWidth) / 2, baseLine, m_number);
     if (!isChecked())
-        p.setPen(QPen(ConfigManager::Instance.getTextCharFormats("normal").foreground().color()));
+        p.setPen(ConfigManager::Instance.foregroundPen(ConfigManager::NormalFormat));
     int leftPart = buttonBorderWidth; //numberAreaWidth + buttonBorderWidth;
     int labelWidth = 0;
     /*if (!m_badgeNumberLabel.text().isEmpty()) {
@@ -20,7 +20,7 @@
  ***************************************************************************/
 
 
-#include "hunspell/hunspell.hxx"
+#include "spellchecker.h"
 #include "widgettextedit.h"
 #include "textaction.h"
 #include "widgetinsertcommand.h"
@@ -30,6 +30,7 @@
 #include <QScrollBar>
 #include <QDebug>
 #include <QPainter>
+#include <QElapsedTimer>
 #include "filestructure.h"
 #include "blockdata.h"
 #include <QListIterator>
@@ -74,7 +75,14 @@ WidgetTextEdit::WidgetTextEdit(WidgetFile * parent) :
     _widgetLineNumber(0),
     _macrosMenu(0),
     _scriptIsRunning(false),
-    _lastBlockCount(0)
+    _lastBlockCount(0),
+    _formatArgument(ConfigManager::Instance.formatId("argument")),
+    _formatArgumentSelected(ConfigManager::Instance.formatId("argument:selected")),
+    _formatArgumentBorder(ConfigManager::Instance.formatId("argument-border")),
+    _formatArgumentBorderSelected(ConfigManager::Instance.formatId("argument-border:selected")),
+    _formatMatched(ConfigManager::Instance.formatId("matched")),
+    _formatSelectedLine(ConfigManager::Instance.formatId("selected-line")),
+    _formatSyncedLine(ConfigManager::Instance.formatId("synced-line"))
 
 {
     _widgetFile = parent;
@@ -107,6 +115,22 @@ void WidgetTextEdit::updateLineWrapMode()
     setLineWrapMode(ConfigManager::Instance.isLineWrapped() ? QPlainTextEdit::WidgetWidth : QPlainTextEdit::NoWrap);
 }
 
+void WidgetTextEdit::setSyntaxHighlighter(SyntaxHighlighter *syntaxHighlighter)
+{
+    this->_syntaxHighlighter = syntaxHighlighter;
+    // the structure is only rebuilt when the highlighter finds an environment or a section added or removed,
+    // other modifications just move or rename the existing items
+    connect(syntaxHighlighter, SIGNAL(structureChanged()), _textStruct, SLOT(invalidate()));
+    connect(syntaxHighlighter, SIGNAL(structureRenamed()), _textStruct, SLOT(invalidateNames()));
+    connect(document(), SIGNAL(contentsChange(int,int,int)), _textStruct, SLOT(onContentsChange(int,int,int)));
+    connect(syntaxHighlighter, SIGNAL(structureChanged()), fileStructure, SLOT(invalidate()));
+    connect(syntaxHighlighter, SIGNAL(structureRenamed()), fileStructure, SLOT(invalidateNames()));
+    connect(document(), SIGNAL(contentsChange(int,int,int)), fileStructure, SLOT(onContentsChange(int,int,int)));
+    // the blocks highlighted in background may be read before their final state
+    connect(syntaxHighlighter, SIGNAL(highlightedBlockCountChanged(int)), _textStruct, SLOT(onHighlightedBlockCountChanged(int)));
+    connect(syntaxHighlighter, SIGNAL(highlightedBlockCountChanged(int)), fileStructure, SLOT(onHighlightedBlockCountChanged(int)));
+}
+
 void WidgetTextEdit::adjustScrollbar(QSizeF documentSize)
 {
     QScrollBar * hbar = this->horizontalScrollBar();
@@ -138,12 +162,16 @@ typedef QPair<QString,QPair<int,int> > Argument;
 
 void WidgetTextEdit::paintEvent(QPaintEvent *event)
 {
+#ifdef DEBUG_PAINT
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+#endif
 
     WIDGET_TEXT_EDIT_PARENT_CLASS::paintEvent(event);
     QPainter painter(viewport());
-    painter.setFont(ConfigManager::Instance.getTextCharFormats("normal").font());
+    painter.setFont(ConfigManager::Instance.textCharFormat(ConfigManager::NormalFormat).font());
 
-    painter.setPen(ConfigManager::Instance.getTextCharFormats("normal").foreground().color());
+    painter.setPen(ConfigManager::Instance.foregroundPen(ConfigManager::NormalFormat));
     foreach(QTextCursor cursor, _multipleEdit)
     {
         QTextLine line = cursor.block().layout()->lineForTextPosition(cursor.positionInBlock());
@@ -161,19 +189,21 @@ void WidgetTextEdit::paintEvent(QPaintEvent *event)
     QBrush selectedBrush(ConfigManager::Instance.getTextCharFormats("normal").background().color().lighter());
     QPen borderSelectedPen = ConfigManager::Instance.getTextCharFormats("normal").foreground().color().darker();
     QPen borderPen = ConfigManager::Instance.getTextCharFormats("normal").foreground().color();*/
-    QBrush defaultBrush(ConfigManager::Instance.getTextCharFormats("argument").background().color());
-    QBrush selectedBrush(ConfigManager::Instance.getTextCharFormats("argument:selected").background().color());
+    const QBrush & defaultBrush = ConfigManager::Instance.backgroundBrush(_formatArgument);
+    const QBrush & selectedBrush = ConfigManager::Instance.backgroundBrush(_formatArgumentSelected);
 
 
-    QPen textSelectedPen = ConfigManager::Instance.getTextCharFormats("argument:selected").foreground().color();
-    QPen textPen = ConfigManager::Instance.getTextCharFormats("argument").foreground().color();
+    const QPen & textSelectedPen = ConfigManager::Instance.foregroundPen(_formatArgumentSelected);
+    const QPen & textPen = ConfigManager::Instance.foregroundPen(_formatArgument);
 
-    QPen borderSelectedPen = ConfigManager::Instance.getTextCharFormats("argument-border:selected").foreground().color();
-    QPen borderPen = ConfigManager::Instance.getTextCharFormats("argument-border").foreground().color();
+    const QPen & borderSelectedPen = ConfigManager::Instance.foregroundPen(_formatArgumentBorderSelected);
+    const QPen & borderPen = ConfigManager::Instance.foregroundPen(_formatArgumentBorder);
 
-    QTextBlock block = this->document()->firstBlock();
+    // only the blocks inside the viewport can have a visible argument
+    QTextBlock block = this->firstVisibleBlock();
+    qreal viewportBottom = viewport()->rect().bottom();
 
-    while(block.isValid())
+    while(block.isValid() && blockTop(block) + contentOffset().y() <= viewportBottom)
     {
         BlockData *data = static_cast<BlockData *>(block.userData());
         if(data && data->arguments.count())
@@ -255,7 +285,9 @@ void WidgetTextEdit::paintEvent(QPaintEvent *event)
         block = block.next();
     }
 
-    return;
+#ifdef DEBUG_PAINT
+    qDebug()<<"paintEvent"<<(paintTimer.nsecsElapsed() / 1000000.0)<<"ms";
+#endif
 }
 void WidgetTextEdit::contextMenuEvent(QContextMenuEvent *event)
 {
@@ -267,7 +299,6 @@ void WidgetTextEdit::contextMenuEvent(QContextMenuEvent *event)
 
     if(widgetFile()->spellChecker())
     {
-        QTextCodec *codec = QTextCodec::codecForName(widgetFile()->spellCheckerEncoding().toLatin1());
         int blockPos = cursor.block().position();
         int colstart, colend;
         colend = colstart = cursor.positionInBlock();
@@ -285,20 +316,12 @@ void WidgetTextEdit::contextMenuEvent(QContextMenuEvent *event)
             cursor.setPosition(blockPos+colstart,QTextCursor::MoveAnchor);
             cursor.setPosition(blockPos+colend,QTextCursor::KeepAnchor);
             QString    word          = cursor.selectedText();
-            QByteArray encodedString = codec->fromUnicode(word);
-            bool check = widgetFile()->spellChecker()->spell(encodedString.data());
+            bool check = widgetFile()->spellChecker()->spell(word);
             if (!check)
             {
-                char ** wlst;
-                int ns = widgetFile()->spellChecker()->suggest(&wlst, encodedString.data());
-                if (ns > 0)
+                QStringList suggWords = widgetFile()->spellChecker()->suggest(word);
+                if (!suggWords.isEmpty())
                 {
-                    QStringList suggWords;
-                    for (int i=0; i < ns; i++)
-                    {
-                        suggWords.append(codec->toUnicode(wlst[i]));
-                    }
-                    widgetFile()->spellChecker()->free_list(&wlst, ns);
                     if(!suggWords.contains(word))
                     {
                         this->setTextCursor(cursor);
@@ -339,8 +362,7 @@ void WidgetTextEdit::addToDictionnary()
 {
     QString newword = textCursor().selectedText();
     ConfigManager::Instance.addToDictionnary(this->widgetFile()->dictionary(), newword);
-    QTextCodec *codec = QTextCodec::codecForName(widgetFile()->spellCheckerEncoding().toLatin1());
-    this->widgetFile()->spellChecker()->add(codec->fromUnicode(newword).data());
+    this->widgetFile()->spellChecker()->add(newword);
     _syntaxHighlighter->rehighlight();
 }
 
@@ -1025,7 +1047,6 @@ void WidgetTextEdit::initIndentation(void)
 
 void WidgetTextEdit::updateIndentation(void)
 {
-    _textStruct->reload();
     //_textStruct->debug();
 
 
@@ -1174,11 +1195,11 @@ void WidgetTextEdit::matchPar()
     QTextBlock textBlock = textCursor().block();
     BlockData *data = static_cast<BlockData *>( textBlock.userData() );
     if ( data ) {
-        QVector<ParenthesisInfo *> infos = data->parentheses();
+        const QVector<ParenthesisInfo> & infos = data->parentheses();
         int pos = textCursor().block().position();
 
         for (int i=0; i < infos.size(); ++i) {
-            ParenthesisInfo *info = infos.at(i);
+            const ParenthesisInfo *info = &infos.at(i);
             int curPos = textCursor().position() - textBlock.position();
             // Clicked on a left parenthesis?
             if ( info->position <= curPos-1 && info->position + info->length > curPos-1 && !(info->type & ParenthesisInfo::RIGHT) ) {
@@ -1199,12 +1220,12 @@ int WidgetTextEdit::matchLeftPar(	QTextBlock currentBlock, int type, int index,
     BlockData *data = static_cast<BlockData *>( currentBlock.userData() );
     if(data)
     {
-        QVector<ParenthesisInfo *> infos = data->parentheses();
+        const QVector<ParenthesisInfo> & infos = data->parentheses();
         int docPos = currentBlock.position();
 
         // Match in same line?
         for ( ; index<infos.size(); ++index ) {
-            ParenthesisInfo *info = infos.at(index);
+            const ParenthesisInfo *info = &infos.at(index);
 
             if ( info->type == type ) {
                 ++numLeftPar;
@@ -1240,12 +1261,12 @@ int WidgetTextEdit::matchRightPar(QTextBlock currentBlock, int type, int index,
     BlockData *data = static_cast<BlockData *>( currentBlock.userData() );
     if(data)
     {
-        QVector<ParenthesisInfo *> infos = data->parentheses();
+        const QVector<ParenthesisInfo> & infos = data->parentheses();
         int docPos = currentBlock.position();
 
         // Match in same line?
         for (int j=index; j>=0 && j < infos.size(); --j ) {
-            ParenthesisInfo *info = infos.at(j);
+            const ParenthesisInfo *info = &infos.at(j);
 
             if ( info->type == type ) {
                 ++numRightPar;
@@ -1274,7 +1295,7 @@ int WidgetTextEdit::matchRightPar(QTextBlock currentBlock, int type, int index,
         BlockData *data = static_cast<BlockData *>( currentBlock.userData() );
         if(data)
         {
-            QVector<ParenthesisInfo *> infos = data->parentheses();
+            const QVector<ParenthesisInfo> & infos = data->parentheses();
             return matchRightPar( currentBlock, type, infos.size()-1, numRightPar );
         }
     }
@@ -1287,7 +1308,7 @@ void WidgetTextEdit::createParSelection( int pos, int length )
 {
     QList<QTextEdit::ExtraSelection> selections = extraSelections(WidgetTextEdit::ParenthesesMatchingSelection);
     QTextEdit::ExtraSelection selection;
-    QTextCharFormat format = ConfigManager::Instance.getTextCharFormats("matched");
+    const QTextCharFormat & format = ConfigManager::Instance.textCharFormat(_formatMatched);
     selection.format = format;
 
     QTextCursor cursor = textCursor();
@@ -1307,10 +1328,10 @@ void WidgetTextEdit::matchLat()
     {
         return;
     }
-    foreach(const LatexBlockInfo* latexBlockInfo, data->latexblocks())
+    foreach(const LatexBlockInfo &latexBlockInfo, data->latexblocks())
     {
-        int position = latexBlockInfo->position + cursor.block().position();
-        if(cursor.selectedText() == latexBlockInfo->name)
+        int position = latexBlockInfo.position + cursor.block().position();
+        if(cursor.selectedText() == latexBlockInfo.name)
         {
             if(position == cursor.selectionStart() - 7)
             {
@@ -1367,11 +1388,11 @@ void WidgetTextEdit::matchLat()
 int WidgetTextEdit::matchLeftLat(	QTextBlock currentBlock, int index, int numLeftLat, int bpos )
 {
     BlockData *data = static_cast<BlockData *>( currentBlock.userData() );
-    QVector<LatexBlockInfo *> infos = data->latexblocks();
+    const QVector<LatexBlockInfo> & infos = data->latexblocks();
 
     // Match in same line?
     for ( ; index<infos.size(); ++index ) {
-        LatexBlockInfo *info = infos.at(index);
+        const LatexBlockInfo *info = &infos.at(index);
 
         if ( info->type == LatexBlockInfo::ENVIRONEMENT_BEGIN ) {
             ++numLeftLat;
@@ -1398,11 +1419,11 @@ int WidgetTextEdit::matchRightLat(QTextBlock currentBlock, int index, int numRig
 {
 
     BlockData *data = static_cast<BlockData *>( currentBlock.userData() );
-    QVector<LatexBlockInfo *> infos = data->latexblocks();
+    const QVector<LatexBlockInfo> & infos = data->latexblocks();
 
     // Match in same line?
     for (int j=index; j>=0; --j ) {
-        LatexBlockInfo *info = infos.at(j);
+        const LatexBlockInfo *info = &infos.at(j);
 
         if ( info->type == LatexBlockInfo::ENVIRONEMENT_END ) {
             ++numRightLat;
@@ -1422,7 +1443,7 @@ int WidgetTextEdit::matchRightLat(QTextBlock currentBlock, int index, int numRig
 
         // Recalculate correct index first
         BlockData *data = static_cast<BlockData *>( currentBlock.userData() );
-        QVector<LatexBlockInfo *> infos = data->latexblocks();
+        const QVector<LatexBlockInfo> & infos = data->latexblocks();
 
         return matchRightLat( currentBlock, infos.size()-1, numRightLat, epos );
     }
@@ -1484,7 +1505,7 @@ void WidgetTextEdit::highlightCurrentLine()
     while(cursor.blockNumber() == blockNumber)
     {
         QTextEdit::ExtraSelection selection;
-        selection.format.setBackground(ConfigManager::Instance.getTextCharFormats("selected-line").background());
+        selection.format.setBackground(ConfigManager::Instance.textCharFormat(_formatSelectedLine).background());
         selection.format.setProperty(QTextFormat::FullWidthSelection, true);
         selection.cursor = QTextCursor(cursor);
         selection.cursor.clearSelection();
@@ -1510,7 +1531,7 @@ void WidgetTextEdit::highlightSyncedLine(int line)
     while(cursor.blockNumber() == line)
     {
         QTextEdit::ExtraSelection selection;
-        selection.format.setBackground(ConfigManager::Instance.getTextCharFormats("synced-line").background());
+        selection.format.setBackground(ConfigManager::Instance.textCharFormat(_formatSyncedLine).background());
         selection.format.setProperty(QTextFormat::FullWidthSelection, true);
         selection.cursor = QTextCursor(cursor);
         selection.cursor.clearSelection();
@@ -87,7 +87,7 @@ public:
     int firstVisibleBlockNumber() { return this->firstVisibleBlock().blockNumber(); } // return this->firstVisibleBlock; }
 
     bool isCursorVisible();
-    void setSyntaxHighlighter(SyntaxHighlighter * syntaxHighlighter) { this->_syntaxHighlighter = syntaxHighlighter; }
+    void setSyntaxHighlighter(SyntaxHighlighter * syntaxHighlighter);
     void setWidgetLineNumber(WidgetLineNumber * widgetLineNumber)
     {
         this->_widgetLineNumber = widgetLineNumber;
@@ -138,6 +138,7 @@ public:
 
     int hitTest(const QPoint & pos) const;
     const CompletionEngine * completionEngine() const { return _completionEngine; }
+    CompletionEngine * completionEngine() { return _completionEngine; }
     void updateCompletionCustomWords();
 
     void addExtraSelections(const QList<QTextEdit::ExtraSelection> &selections, int kind = WidgetTextEdit::OtherSelection);
@@ -259,6 +260,16 @@ private:
     QMap<int,int> _foldedLines;
     int _lastBlockCount;
     QMap<int, QList<QTextEdit::ExtraSelection> > _extraSelections;
+    /**
+     * @brief theme format ids used while painting, resolved once in the constructor
+     */
+    int _formatArgument;
+    int _formatArgumentSelected;
+    int _formatArgumentBorder;
+    int _formatArgumentBorderSelected;
+    int _formatMatched;
+    int _formatSelectedLine;
+    int _formatSyncedLine;
 
 };
 